@@ -0,0 +1,815 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+// 日志性能基准
+// 每个用例输出一行 JSON 到标准输出, 便于脚本对比升级前后的结果:
+//   {"name":..., "threads":..., "events":..., "ns_per_event":..., "events_per_sec":...,
+//    "p50_ns":..., "p90_ns":..., "p99_ns":..., "p999_ns":..., "max_ns":..., "allocs_per_event":...}
+// 用法: sylar_bench [--filter <子串>] [--events <每线程事件数>] [--quick]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "bytearray.h"
+#include "coroutine.h"
+#include "fd_manager.h"
+#include "fiber.h"
+#include "hook.h"
+#include "http.h"
+#include "iomanager.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "log.h"
+#include "log_static_formatter.h"
+#include "log_structured.h"
+#include "log_uring.h"
+
+// 统计堆分配次数
+static std::atomic<uint64_t> s_alloc_count{0};
+
+void *operator new(size_t size) {
+    s_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+// 不内联: 否则 GCC 在 new 和 delete 都展开的调用点上把 malloc 出来的指针看成 operator new 的返回值,
+// 对这里的 free 报 -Wmismatched-new-delete
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// 数组和带大小的形式都转到 operator delete(void *), 与上面的 operator new[] 对应
+void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+namespace {
+
+    struct Options {
+        std::string filter;
+        uint64_t events = 200000;
+        std::vector<int> thread_counts = {1, 2, 4, 8, 16, 32, 64};
+    };
+
+    Options s_options;
+    FILE *s_result_out = stdout;
+
+    uint64_t nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    // 两次取时间本身的开销, 从单次延迟中扣除
+    uint64_t clockOverheadNs() {
+        static uint64_t overhead = []() {
+            std::vector<uint64_t> samples(10000);
+            for (auto &s: samples) {
+                uint64_t a = nowNs();
+                uint64_t b = nowNs();
+                s = b - a;
+            }
+            std::sort(samples.begin(), samples.end());
+            return samples[samples.size() / 2];
+        }();
+        return overhead;
+    }
+
+    struct Result {
+        std::string name;
+        int threads = 1;
+        uint64_t events = 0;
+        double ns_per_event = 0;
+        double events_per_sec = 0;
+        uint64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+        double allocs_per_event = 0;
+    };
+
+    void report(const Result &r) {
+        fprintf(s_result_out,
+                "{\"name\":\"%s\",\"threads\":%d,\"events\":%lu,\"ns_per_event\":%.2f,\"events_per_sec\":%.0f,"
+                "\"p50_ns\":%lu,\"p90_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu,"
+                "\"allocs_per_event\":%.3f}\n",
+                r.name.c_str(), r.threads, r.events, r.ns_per_event, r.events_per_sec, r.p50, r.p90, r.p99, r.p999,
+                r.max, r.allocs_per_event);
+        fflush(s_result_out);
+    }
+
+    bool selected(const std::string &name) {
+        return s_options.filter.empty() || name.find(s_options.filter) != std::string::npos;
+    }
+
+    // 每个线程先跑一轮不计时的吞吐循环, 再跑一轮逐次计时的延迟循环
+    // op(thread_index) 执行一次被测操作
+    void run(const std::string &name, int threads, const std::function<void(int)> &op,
+             const std::function<void()> &after = nullptr) {
+        if (!selected(name)) {
+            return;
+        }
+        uint64_t events = std::max<uint64_t>(s_options.events / threads, 1000);
+        uint64_t overhead = clockOverheadNs();
+        std::vector<std::vector<uint32_t>> latencies(threads);
+        for (auto &v: latencies) {
+            v.resize(events);
+        }
+
+        // 预热
+        for (int i = 0; i < 1000; i++) {
+            op(0);
+        }
+        if (after) {
+            after();
+        }
+
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        auto worker = [&](int idx, bool timed) {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            if (!timed) {
+                for (uint64_t i = 0; i < events; i++) {
+                    op(idx);
+                }
+                return;
+            }
+            auto &lat = latencies[idx];
+            for (uint64_t i = 0; i < events; i++) {
+                uint64_t begin = nowNs();
+                op(idx);
+                uint64_t cost = nowNs() - begin;
+                lat[i] = (uint32_t) std::min<uint64_t>(cost > overhead ? cost - overhead : 0, UINT32_MAX);
+            }
+        };
+
+        auto phase = [&](bool timed) {
+            std::vector<std::thread> pool;
+            ready = 0;
+            go = false;
+            for (int t = 0; t < threads; t++) {
+                pool.emplace_back(worker, t, timed);
+            }
+            while (ready.load() != threads) {
+                std::this_thread::yield();
+            }
+            uint64_t allocs = s_alloc_count.load();
+            uint64_t begin = nowNs();
+            go.store(true, std::memory_order_release);
+            for (auto &t: pool) {
+                t.join();
+            }
+            if (after) {
+                after();
+            }
+            return std::make_pair(nowNs() - begin, s_alloc_count.load() - allocs);
+        };
+
+        auto [elapsed, allocs] = phase(false);
+        phase(true);
+
+        std::vector<uint32_t> all;
+        all.reserve(events * threads);
+        for (auto &v: latencies) {
+            all.insert(all.end(), v.begin(), v.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto pct = [&all](double p) { return (uint64_t) all[std::min(all.size() - 1, (size_t) (all.size() * p))]; };
+
+        Result r;
+        r.name = name;
+        r.threads = threads;
+        r.events = events * threads;
+        r.ns_per_event = (double) elapsed / (double) r.events;
+        r.events_per_sec = r.events * 1e9 / (double) elapsed;
+        r.p50 = pct(0.5);
+        r.p90 = pct(0.9);
+        r.p99 = pct(0.99);
+        r.p999 = pct(0.999);
+        r.max = all.back();
+        r.allocs_per_event = (double) allocs / (double) r.events;
+        report(r);
+    }
+
+    sylar::LogEvent::ptr makeEvent() {
+        auto event = sylar::LogEvent::capture(std::source_location::current());
+        event->format("benchmark message {} {}", 42, "payload");
+        return event;
+    }
+
+    // 什么都不写的 appender, 用来单独测量前端开销
+    class NullLogAppender : public sylar::LogAppender {
+    public:
+        void log(const std::shared_ptr<sylar::Logger> &, sylar::LogLevel::Level, sylar::LogEvent::ptr) override {}
+    };
+
+    std::string tmpfsPath(const char *name) {
+        std::string dir = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+        return dir + "/" + name + "." + std::to_string(getpid());
+    }
+
+    void benchFormatItems() {
+        auto logger = std::make_shared<sylar::Logger>("bench");
+        auto event = makeEvent();
+        const char *items[][2] = {
+                {"m",       "%m"},
+                {"p",       "%p"},
+                {"r",       "%r"},
+                {"c",       "%c"},
+                {"t",       "%t"},
+                {"n",       "%n"},
+                {"d",       "%d"},
+                {"f",       "%f"},
+                {"l",       "%l"},
+                {"T",       "%T"},
+                {"F",       "%F"},
+                {"N",       "%N"},
+                {"literal", "literal text"},
+        };
+        for (auto &item: items) {
+            sylar::LogFormatter formatter(item[1]);
+            run(std::string("format_item/") + item[0], 1, [&](int) {
+                fmt::memory_buffer buf;
+                formatter.format(buf, logger, sylar::LogLevel::Level::INFO, event);
+            });
+        }
+    }
+
+    void benchFormatter() {
+        auto logger = std::make_shared<sylar::Logger>("bench");
+        auto event = makeEvent();
+        sylar::LogFormatter formatter;
+        run("formatter/default_runtime", 1, [&](int) {
+            fmt::memory_buffer buf;
+            formatter.format(buf, logger, sylar::LogLevel::Level::INFO, event);
+        });
+        run("formatter/default_runtime_string", 1, [&](int) {
+            std::string str = formatter.format(logger, sylar::LogLevel::Level::INFO, event);
+        });
+        // 追加到块链, 攒满 64K 后整条释放, 块回到线程池
+        sylar::ByteArray chain;
+        run("formatter/default_runtime_bytearray", 1, [&](int) {
+            formatter.format(chain, logger, sylar::LogLevel::Level::INFO, event);
+            if (chain.size() >= 64 * 1024) {
+                chain.clear();
+            }
+        });
+        typedef sylar::StaticLogFormatter<"%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"> Static;
+        run("formatter/default_static", 1, [&](int) {
+            fmt::memory_buffer buf;
+            Static::formatTo(buf, logger, sylar::LogLevel::Level::INFO, *event);
+        });
+        run("event/create_and_format", 1, [&](int) {
+            makeEvent();
+        });
+    }
+
+    void benchStructured() {
+        auto logger = std::make_shared<sylar::Logger>("bench");
+        auto event = makeEvent();
+        event->addFields({{"path", "/api/v1/users"}, {"status", 200}, {"latency_ms", 1.25}, {"cached", false}});
+        sylar::JsonLogFormatter json;
+        run("formatter/json_fields", 1, [&](int) {
+            fmt::memory_buffer buf;
+            json.format(buf, logger, sylar::LogLevel::Level::INFO, event);
+        });
+        sylar::LogfmtLogFormatter logfmt;
+        run("formatter/logfmt_fields", 1, [&](int) {
+            fmt::memory_buffer buf;
+            logfmt.format(buf, logger, sylar::LogLevel::Level::INFO, event);
+        });
+
+        // 1KB 没有需要转义的字符的消息, 查找转义字符的向量化实现和逐字节实现对比
+        std::string text;
+        while (text.size() < 1024) {
+            text += "GET /static/app.js?v=3 upstream 10.0.0.12:8080 took 12ms; ";
+        }
+        text.resize(1024);
+        run("escape/json_scan_1k", 1, [&](int) {
+            sylar::detail::findJsonEscape(text.data(), text.size());
+        });
+        run("escape/json_scan_1k_scalar", 1, [&](int) {
+            sylar::detail::findJsonEscapeScalar(text.data(), text.size());
+        });
+    }
+
+    void benchFrontend() {
+        auto logger = std::make_shared<sylar::Logger>("bench", sylar::LogLevel::Level::INFO);
+        logger->addAppender(std::make_shared<NullLogAppender>());
+        run("frontend/debug_disabled", 1, [&](int) {
+            SYLAR_LOG_DEBUG(logger, "benchmark message {} {}", 42, "payload");
+        });
+        for (int threads: s_options.thread_counts) {
+            run("frontend/info_null_appender", threads, [&](int) {
+                SYLAR_LOG_INFO(logger, "benchmark message {} {}", 42, "payload");
+            });
+        }
+
+        // 按 appender 的格式采集事件字段: 默认格式全部采集, 只有级别和消息的格式不读时钟和线程身份,
+        // 默认格式加粗粒度时钟
+        struct Capture {
+            const char *name;
+            const char *pattern;
+            bool coarse;
+        };
+        for (auto &capture: {Capture{"frontend/capture_default_pattern", nullptr, false},
+                             Capture{"frontend/capture_level_message", "%p%T%m%n", false},
+                             Capture{"frontend/capture_coarse_clock", nullptr, true}}) {
+            auto capture_logger = std::make_shared<sylar::Logger>("bench", sylar::LogLevel::Level::INFO);
+            sylar::LogAppender::ptr appender = std::make_shared<NullLogAppender>();
+            appender->setFormatter(capture.pattern ? std::make_shared<sylar::LogFormatter>(capture.pattern)
+                                                   : std::make_shared<sylar::LogFormatter>());
+            capture_logger->addAppender(appender);
+            capture_logger->setCoarseClock(capture.coarse);
+            run(capture.name, 1, [&](int) {
+                SYLAR_LOG_INFO(capture_logger, "benchmark message {} {}", 42, "payload");
+            });
+        }
+
+        // 子 logger 继承 bench.frontend 的 WARN 级别, 按名字每次查表和调用点缓存的句柄对比
+        auto &manager = sylar::LoggerManager::getInstance();
+        manager.getLogger("bench.frontend")->setLevel(sylar::LogLevel::Level::WARN);
+        run("frontend/named_lookup_disabled", 1, [&](int) {
+            SYLAR_LOG_DEBUG(manager.getLogger("bench.frontend.conn"), "benchmark message {} {}", 42, "payload");
+        });
+        run("frontend/named_handle_disabled", 1, [&](int) {
+            SYLAR_LOG_DEBUG(SYLAR_LOG_NAME("bench.frontend.conn"), "benchmark message {} {}", 42, "payload");
+        });
+
+        // 开启飞行记录后, 被级别过滤掉的 DEBUG 日志格式化到线程的环里
+        sylar::FlightRecorder::enable("/dev/null", 1024);
+        run("frontend/debug_flight_recorder", 1, [&](int) {
+            SYLAR_LOG_DEBUG(logger, "benchmark message {} {}", 42, "payload");
+        });
+        sylar::FlightRecorder::disable();
+
+        // 合并所有分片并导出 Prometheus 文本, 抓取一次的开销
+        run("metrics/export_text", 1, [&](int) {
+            manager.getMetricsText();
+        });
+
+        // 同一调用点的错误日志洪泛, 令牌桶每秒只放行 100 条, 绝大多数在格式化之前被丢弃
+        auto limited = std::make_shared<sylar::Logger>("bench_limited", sylar::LogLevel::Level::INFO);
+        limited->addAppender(std::make_shared<NullLogAppender>());
+        sylar::LogRateLimit limit;
+        limit.rate_per_sec = 100;
+        limited->setRateLimit(limit);
+        for (int threads: s_options.thread_counts) {
+            run("frontend/error_flood_rate_limited", threads, [&](int) {
+                SYLAR_LOG_ERROR(limited, "upstream failed {} {}", 42, "payload");
+            });
+        }
+    }
+
+    // 多线程写日志的同时不断修改配置, 在 -DSYLAR_SANITIZE=thread 的构建下用来检查数据竞争
+    void benchReconfigure() {
+        std::string name = "stress/reconfigure";
+        if (!selected(name)) {
+            return;
+        }
+        auto &manager = sylar::LoggerManager::getInstance();
+        manager.addLogger("bench.stress");
+        auto logger = manager.getLogger("bench.stress");
+        logger->setAdditive(false);
+        sylar::LogAppender::ptr file(new sylar::FileLogAppender("/dev/null"));
+        logger->addAppender(file);
+        std::atomic<bool> stop{false};
+        std::thread reconfig([&]() {
+            auto formatters = {std::make_shared<sylar::LogFormatter>(),
+                               std::make_shared<sylar::LogFormatter>("%d%T%p%T%m%n")};
+            uint64_t i = 0;
+            while (!stop.load()) {
+                sylar::LogAppender::ptr extra(new NullLogAppender);
+                logger->addAppender(extra);
+                file->setFormatter(*(formatters.begin() + i % 2));
+                logger->setLevel(i % 3 ? sylar::LogLevel::Level::DEBUG : sylar::LogLevel::Level::WARN);
+                manager.getLogger("bench.stress." + std::to_string(i % 64))->setLevel(
+                        i % 2 ? sylar::LogLevel::Level::INFO : sylar::LogLevel::Level::ERROR);
+                logger->delAppender(extra);
+                i++;
+            }
+        });
+        for (int threads: s_options.thread_counts) {
+            run(name, threads, [&](int idx) {
+                SYLAR_LOG_WARN(sylar::LoggerManager::getInstance().getLogger("bench.stress"), "stress {}", idx);
+            }, [&]() { file->flush(); });
+        }
+        stop = true;
+        reconfig.join();
+    }
+
+    void benchAppenders() {
+        auto logger = std::make_shared<sylar::Logger>("bench");
+        auto event = makeEvent();
+
+        // 基准期间把标准输出重定向到 /dev/null, 结果写到原来的标准输出
+        fflush(stdout);
+        int saved = dup(STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+        FILE *saved_out = s_result_out;
+        s_result_out = fdopen(dup(saved), "w");
+        {
+            sylar::StdoutLogAppender::ptr appender(new sylar::StdoutLogAppender);
+            appender->setFormatter(std::make_shared<sylar::LogFormatter>());
+            run("appender/stdout_devnull", 1, [&](int) {
+                appender->log(logger, sylar::LogLevel::Level::INFO, event);
+            }, [&]() { appender->flush(); });
+        }
+        fflush(s_result_out);
+        fclose(s_result_out);
+        s_result_out = saved_out;
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+
+        std::string files[][2] = {{"appender/file_devnull", "/dev/null"},
+                                  {"appender/file_tmpfs",   tmpfsPath("sylar_bench_file")}};
+        for (auto &file: files) {
+            sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(file[1]));
+            appender->setFormatter(std::make_shared<sylar::LogFormatter>());
+            run(file[0], 1, [&](int) {
+                appender->log(logger, sylar::LogLevel::Level::INFO, event);
+            }, [&]() { appender->flush(); });
+            if (file[1] != "/dev/null") {
+                unlink(file[1].c_str());
+            }
+        }
+    }
+
+    void benchLogger() {
+        std::string path = tmpfsPath("sylar_bench_logger");
+        for (bool async: {false, true}) {
+            for (int threads: s_options.thread_counts) {
+                auto logger = std::make_shared<sylar::Logger>("bench");
+                sylar::LogAppender::ptr file(new sylar::FileLogAppender(path));
+                sylar::AsyncLogAppender::ptr async_appender;
+                if (async) {
+                    async_appender.reset(new sylar::AsyncLogAppender(file, 1 << 16));
+                    logger->addAppender(async_appender);
+                } else {
+                    logger->addAppender(file);
+                }
+                std::string name = std::string(async ? "logger/async_file_tmpfs" : "logger/file_tmpfs");
+                run(name, threads, [&](int) {
+                    logger->info(makeEvent());
+                }, [&]() {
+                    if (async_appender) {
+                        async_appender->flush();
+                    } else {
+                        file->flush();
+                    }
+                });
+            }
+        }
+        unlink(path.c_str());
+
+        // 本地磁盘文件: FileLogAppender(调用线程 writev) 与 UringFileLogAppender(io_uring 和退回的 pwritev 后台线程)
+        std::string disk_path = "/tmp/sylar_bench_disk." + std::to_string(getpid());
+        for (int kind = 0; kind < 3; kind++) {
+            static const char *s_names[] = {"logger/file_disk", "logger/uring_file_disk", "logger/uring_writev_disk"};
+            for (int threads: s_options.thread_counts) {
+                auto logger = std::make_shared<sylar::Logger>("bench");
+                sylar::LogAppender::ptr file;
+                if (kind == 0) {
+                    file.reset(new sylar::FileLogAppender(disk_path));
+                } else {
+                    sylar::UringFileLogAppender::Options options;
+                    options.use_uring = kind == 1;
+                    file.reset(new sylar::UringFileLogAppender(disk_path, options));
+                }
+                logger->addAppender(file);
+                run(s_names[kind], threads, [&](int) {
+                    logger->info(makeEvent());
+                }, [&]() { file->flush(); });
+            }
+            unlink(disk_path.c_str());
+        }
+
+        // 两个文件 appender: 各自的格式对象每条事件格式化两次, 共用一个格式对象时只格式化一次
+        for (bool shared: {false, true}) {
+            auto logger = std::make_shared<sylar::Logger>("bench");
+            auto formatter = std::make_shared<sylar::LogFormatter>();
+            sylar::LogAppender::ptr first(new sylar::FileLogAppender("/dev/null"));
+            sylar::LogAppender::ptr second(new sylar::FileLogAppender("/dev/null"));
+            first->setFormatter(formatter);
+            second->setFormatter(shared ? formatter : std::make_shared<sylar::LogFormatter>());
+            logger->addAppender(first);
+            logger->addAppender(second);
+            run(shared ? "logger/two_files_shared_formatter" : "logger/two_files_own_formatter", 1, [&](int) {
+                logger->info(makeEvent());
+            }, [&]() {
+                first->flush();
+                second->flush();
+            });
+        }
+    }
+
+
+    void benchFlightRecorderDump() {
+        // 在启用 hook 的协程里转储到发送缓冲已满的 socket, 与崩溃时在 IOManager 线程上转储的情形相同
+        // 转储必须直接发起系统调用, 写不动时放弃剩余部分; 如果经过 hook 挂起协程, 没有人读对端, 这里会一直卡住
+        const char *name = "flight_recorder/dump_hooked_fiber";
+        if (!selected(name)) {
+            return;
+        }
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return;
+        }
+        // 登记为 hook 管理的 socket, 系统层面变为非阻塞
+        sylar::FdManager::getInstance().get(fds[0], true);
+        char fill[4096] = {};
+        while (write_f(fds[0], fill, sizeof(fill)) > 0) {
+        }
+
+        sylar::FlightRecorder::enable("/dev/null", 1024);
+        auto logger = std::make_shared<sylar::Logger>("bench", sylar::LogLevel::Level::WARN);
+        for (int i = 0; i < 1024; i++) {
+            SYLAR_LOG_DEBUG(logger, "benchmark message {} {}", i, "payload");
+        }
+
+        uint64_t rounds = std::max<uint64_t>(s_options.events / 1000, 100);
+        std::vector<uint32_t> latencies(rounds);
+        uint64_t elapsed = 0;
+        {
+            sylar::IOManager iom(1, "bench");
+            iom.schedule([&]() {
+                uint64_t begin = nowNs();
+                for (auto &lat: latencies) {
+                    uint64_t t = nowNs();
+                    sylar::FlightRecorder::dumpTo(fds[0], "bench");
+                    lat = (uint32_t) std::min<uint64_t>(nowNs() - t, UINT32_MAX);
+                }
+                elapsed = nowNs() - begin;
+            });
+        }
+        sylar::FlightRecorder::disable();
+        close(fds[0]);
+        close(fds[1]);
+
+        std::sort(latencies.begin(), latencies.end());
+        auto pct = [&latencies](double p) {
+            return (uint64_t) latencies[std::min(latencies.size() - 1, (size_t) (latencies.size() * p))];
+        };
+        Result r;
+        r.name = name;
+        r.events = rounds;
+        r.ns_per_event = (double) elapsed / (double) rounds;
+        r.events_per_sec = rounds * 1e9 / (double) elapsed;
+        r.p50 = pct(0.5);
+        r.p90 = pct(0.9);
+        r.p99 = pct(0.99);
+        r.p999 = pct(0.999);
+        r.max = latencies.back();
+        report(r);
+    }
+
+    void benchFiber() {
+        // 一次 resume 加一次 yield, 即两次上下文切换
+        sylar::Fiber fiber([]() {
+            for (;;) {
+                sylar::Fiber::yield();
+            }
+        });
+        run("fiber/switch", 1, [&](int) {
+            fiber.resume();
+        });
+
+        // 创建, 执行完毕, 销毁; 栈来自缓存
+        run("fiber/create_run_destroy", 1, [&](int) {
+            sylar::Fiber f([]() {});
+            f.resume();
+        });
+
+        sylar::Fiber reused([]() {});
+        reused.resume();
+        run("fiber/reset_run", 1, [&](int) {
+            reused.reset([]() {});
+            reused.resume();
+        });
+    }
+
+    sylar::Task<int> childTask(int v) {
+        co_return v + 1;
+    }
+
+    sylar::Task<void> parentTask(int &out) {
+        out = co_await childTask(out);
+    }
+
+    void benchTask() {
+        // 创建两个无栈协程(帧来自帧池), 父协程 co_await 子协程, 全部执行完毕后释放; 与 fiber/create_run_destroy 对比
+        int value = 0;
+        run("task/spawn_await", 1, [&](int) {
+            sylar::spawn(parentTask(value));
+        });
+    }
+
+    void benchByteArray() {
+        // 一组定长和变长整数的编码再解码
+        sylar::ByteArray ba;
+        uint32_t n = 0;
+        run("bytearray/varint_roundtrip", 1, [&](int) {
+            n++;
+            ba.writeVarUint64((uint64_t) n * 2654435761u);
+            ba.writeVarInt32(-(int32_t) n);
+            ba.writeFixed<uint32_t>(n);
+            ba.readVarUint64();
+            ba.readVarInt32();
+            ba.readFixed<uint32_t>();
+        });
+
+        // 共享块的切片, 不拷贝数据
+        sylar::ByteArray payload;
+        for (int i = 0; i < 4; i++) {
+            payload.write(std::string(3000, 'x'));
+        }
+        run("bytearray/slice", 1, [&](int) {
+            n++;
+            sylar::ByteArray part = payload.slice(n % 1000, 8000);
+        });
+    }
+
+    void benchHttp() {
+        // 浏览器风格的 GET 请求, 解析结果全部是指向缓冲的视图
+        std::string_view text = "GET /static/app.js?v=3 HTTP/1.1\r\n"
+                                "Host: localhost:8080\r\n"
+                                "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101 Firefox/118.0\r\n"
+                                "Accept: */*\r\n"
+                                "Accept-Language: en-US,en;q=0.5\r\n"
+                                "Accept-Encoding: gzip, deflate, br\r\n"
+                                "Connection: keep-alive\r\n"
+                                "Referer: http://localhost:8080/index.html\r\n\r\n";
+        sylar::http::HttpRequestParser parser;
+        sylar::http::HttpRequest request;
+        run("http/parse_request", 1, [&](int) {
+            parser.parse(text, request);
+        });
+
+        sylar::http::HttpResponse response;
+        sylar::ByteArray out;
+        run("http/response_head", 1, [&](int) {
+            response.reset();
+            response.addHeader("Content-Type", "text/plain");
+            response.setBody("hello world\n");
+            response.appendHead(out, 1);
+            if (out.size() >= 64 * 1024) {
+                out.clear();
+            }
+        });
+    }
+
+
+    // 只有总吞吐的用例, 延迟分位数为 0
+    void reportThroughput(const std::string &name, int threads, uint64_t events, uint64_t elapsed, uint64_t allocs) {
+        Result r;
+        r.name = name;
+        r.threads = threads;
+        r.events = events;
+        r.ns_per_event = (double) elapsed / (double) events;
+        r.events_per_sec = events * 1e9 / (double) elapsed;
+        r.allocs_per_event = (double) allocs / (double) events;
+        report(r);
+    }
+
+    // 二叉树式派生任务, 只有一个根任务, 其他线程只能靠窃取拿到工作
+    void spawnTree(sylar::Scheduler *scheduler, int depth, std::atomic<uint64_t> &done) {
+        done.fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) {
+            return;
+        }
+        for (int i = 0; i < 2; i++) {
+            scheduler->schedule([scheduler, depth, &done]() { spawnTree(scheduler, depth - 1, done); });
+        }
+    }
+
+    // 调度器扩展性曲线, threads 为工作线程数
+    void benchScheduler() {
+        int depth = 1;
+        while ((2ull << depth) - 1 < s_options.events) {
+            depth++;
+        }
+        for (int threads: s_options.thread_counts) {
+            if (selected("scheduler/spawn_tree")) {
+                sylar::Scheduler scheduler(threads, "bench");
+                scheduler.start();
+                std::atomic<uint64_t> done{0};
+                uint64_t allocs = s_alloc_count.load();
+                uint64_t begin = nowNs();
+                scheduler.schedule([&scheduler, depth, &done]() { spawnTree(&scheduler, depth, done); });
+                scheduler.stop();
+                reportThroughput("scheduler/spawn_tree", threads, done.load(), nowNs() - begin,
+                                 s_alloc_count.load() - allocs);
+            }
+
+            if (selected("scheduler/yield")) {
+                // 每个线程 64 个协程, 反复让出
+                sylar::Scheduler scheduler(threads, "bench");
+                scheduler.start();
+                uint64_t fibers = 64 * (uint64_t) threads;
+                uint64_t rounds = std::max<uint64_t>(s_options.events / fibers, 16);
+                uint64_t allocs = s_alloc_count.load();
+                uint64_t begin = nowNs();
+                for (uint64_t i = 0; i < fibers; i++) {
+                    scheduler.schedule([rounds]() {
+                        for (uint64_t k = 0; k < rounds; k++) {
+                            sylar::Scheduler::yield();
+                        }
+                    });
+                }
+                scheduler.stop();
+                reportThroughput("scheduler/yield", threads, fibers * rounds, nowNs() - begin,
+                                 s_alloc_count.load() - allocs);
+            }
+        }
+    }
+
+
+    // 模拟大量空闲连接的读超时: 时间轮中常驻 100 万个定时器, 测量增删和续期的开销
+    void benchTimer() {
+        if (!selected("timer/")) {
+            return;
+        }
+        sylar::TimerManager manager;
+        std::vector<sylar::Timer::ptr> idle(1000000);
+        for (size_t i = 0; i < idle.size(); i++) {
+            idle[i] = manager.addTimer(60000 + i % 60000, []() {});
+        }
+
+        run("timer/add_cancel", 1, [&](int) {
+            manager.addTimer(30000, []() {})->cancel();
+        });
+
+        size_t next = 0;
+        run("timer/refresh", 1, [&](int) {
+            idle[next]->refresh();
+            next = (next + 1) % idle.size();
+        });
+
+        for (auto &timer: idle) {
+            timer->cancel();
+        }
+    }
+
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            s_options.filter = argv[++i];
+        } else if (arg == "--events" && i + 1 < argc) {
+            s_options.events = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--quick") {
+            s_options.events = 20000;
+            s_options.thread_counts = {1, 4, 16};
+        } else {
+            fprintf(stderr, "usage: %s [--filter <substring>] [--events <n>] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    benchFormatItems();
+    benchFormatter();
+    benchStructured();
+    benchFrontend();
+    benchAppenders();
+    benchLogger();
+    benchReconfigure();
+    benchFlightRecorderDump();
+    benchFiber();
+    benchTask();
+    benchByteArray();
+    benchHttp();
+    benchScheduler();
+    benchTimer();
+    return 0;
+}
@@ -0,0 +1,436 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "bytearray.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include "pool_allocator.h"
+
+namespace sylar {
+
+    struct ByteArray::Block {
+        std::atomic<uint32_t> refs{1};
+    };
+
+    namespace {
+        constexpr size_t kIovecBatch = 64;         //writeTo/readFrom 一次系统调用最多的 iovec 数
+        constexpr size_t kMaxVarintSize = 10;
+        // 块头只有引用计数, 之后都是数据
+        constexpr size_t kBlockHeaderSize = sizeof(std::atomic<uint32_t>);
+        constexpr uint32_t kBlockCapacity = (uint32_t) (ByteArray::kBlockSize - kBlockHeaderSize);
+    }
+
+    ByteArray::Block *ByteArray::newBlock() {
+        return new(ThreadLocalPool<kBlockSize>::allocate()) Block;
+    }
+
+    void ByteArray::ref(Block *block) {
+        block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ByteArray::unref(Block *block) {
+        if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            block->~Block();
+            ThreadLocalPool<kBlockSize>::deallocate(block);
+        }
+    }
+
+    char *ByteArray::dataOf(Block *block) {
+        return reinterpret_cast<char *>(block) + kBlockHeaderSize;
+    }
+
+    ByteArray::ByteArray(const ByteArray &other) {
+        append(other);
+    }
+
+    ByteArray &ByteArray::operator=(const ByteArray &other) {
+        if (this != &other) {
+            clear();
+            append(other);
+        }
+        return *this;
+    }
+
+    ByteArray::ByteArray(ByteArray &&other) noexcept
+            : m_segments(std::move(other.m_segments)), m_head(other.m_head), m_size(other.m_size) {
+        other.m_segments.clear();
+        other.m_head = 0;
+        other.m_size = 0;
+        other.m_reserve_from = SIZE_MAX;
+    }
+
+    ByteArray &ByteArray::operator=(ByteArray &&other) noexcept {
+        if (this != &other) {
+            release();
+            m_segments.swap(other.m_segments);
+            m_head = other.m_head;
+            m_size = other.m_size;
+            m_reserve_from = SIZE_MAX;
+            other.m_head = 0;
+            other.m_size = 0;
+            other.m_reserve_from = SIZE_MAX;
+        }
+        return *this;
+    }
+
+    ByteArray::~ByteArray() {
+        release();
+    }
+
+    void ByteArray::release() {
+        for (size_t i = m_head; i < m_segments.size(); i++) {
+            unref(m_segments[i].block);
+        }
+        m_segments.clear();
+        m_head = 0;
+        m_size = 0;
+        m_reserve_from = SIZE_MAX;
+    }
+
+    void ByteArray::clear() {
+        release();
+    }
+
+    void ByteArray::compact() {
+        if (m_reserve_from != SIZE_MAX) {
+            return;
+        }
+        if (m_head == m_segments.size()) {
+            m_segments.clear();
+            m_head = 0;
+        } else if ((m_head >= 16 && m_head * 2 >= m_segments.size()) || (m_size == 0 && m_head > 0)) {
+            m_segments.erase(m_segments.begin(), m_segments.begin() + (ptrdiff_t) m_head);
+            m_head = 0;
+        }
+    }
+
+    ByteArray::Segment &ByteArray::writableTail() {
+        if (m_head < m_segments.size()) {
+            Segment &tail = m_segments.back();
+            // 只有本段引用这个块时, 块中 end 之后的空间才没有别人的数据
+            if (tail.end < kBlockCapacity && tail.block->refs.load(std::memory_order_acquire) == 1) {
+                return tail;
+            }
+        }
+        m_segments.push_back(Segment{newBlock(), 0, 0});
+        return m_segments.back();
+    }
+
+    void ByteArray::write(const void *data, size_t len) {
+        const char *src = static_cast<const char *>(data);
+        while (len > 0) {
+            Segment &tail = writableTail();
+            size_t n = std::min(len, (size_t) (kBlockCapacity - tail.end));
+            memcpy(dataOf(tail.block) + tail.end, src, n);
+            tail.end += (uint32_t) n;
+            m_size += n;
+            src += n;
+            len -= n;
+        }
+    }
+
+    void ByteArray::writeVarUint64(uint64_t value) {
+        uint8_t buf[kMaxVarintSize];
+        size_t n = 0;
+        while (value >= 0x80) {
+            buf[n++] = (uint8_t) (value | 0x80);
+            value >>= 7;
+        }
+        buf[n++] = (uint8_t) value;
+        write(buf, n);
+    }
+
+    void ByteArray::writeString(std::string_view str) {
+        writeVarUint64(str.size());
+        write(str.data(), str.size());
+    }
+
+    void ByteArray::append(const ByteArray &other) {
+        // other 可能就是自己, 先记下段数
+        size_t begin = other.m_head, end = other.m_segments.size();
+        m_segments.reserve(m_segments.size() + end - begin);
+        for (size_t i = begin; i < end; i++) {
+            const Segment &segment = other.m_segments[i];
+            if (segment.begin == segment.end) {
+                continue;
+            }
+            ref(segment.block);
+            m_segments.push_back(segment);
+            m_size += segment.end - segment.begin;
+        }
+    }
+
+    void ByteArray::append(ByteArray &&other) {
+        if (this == &other) {
+            return;
+        }
+        if (empty()) {
+            *this = std::move(other);
+            return;
+        }
+        // 引用直接转移过来
+        m_segments.insert(m_segments.end(), other.m_segments.begin() + (ptrdiff_t) other.m_head,
+                          other.m_segments.end());
+        m_size += other.m_size;
+        other.m_segments.clear();
+        other.m_head = 0;
+        other.m_size = 0;
+        other.m_reserve_from = SIZE_MAX;
+    }
+
+    void ByteArray::peek(void *buf, size_t len) const {
+        if (len > m_size) {
+            throw std::out_of_range("ByteArray: not enough data");
+        }
+        char *dst = static_cast<char *>(buf);
+        for (size_t i = m_head; len > 0; i++) {
+            const Segment &segment = m_segments[i];
+            size_t n = std::min(len, (size_t) (segment.end - segment.begin));
+            memcpy(dst, dataOf(segment.block) + segment.begin, n);
+            dst += n;
+            len -= n;
+        }
+    }
+
+    void ByteArray::consume(size_t len) {
+        if (len > m_size) {
+            throw std::out_of_range("ByteArray: not enough data");
+        }
+        m_size -= len;
+        while (len > 0) {
+            Segment &segment = m_segments[m_head];
+            size_t n = segment.end - segment.begin;
+            if (len < n) {
+                segment.begin += (uint32_t) len;
+                break;
+            }
+            len -= n;
+            if (m_head + 1 == m_segments.size() && segment.block->refs.load(std::memory_order_acquire) == 1) {
+                // 读空了独占的尾块, 留着从头接着写, 免得马上又要分配
+                segment.begin = segment.end = 0;
+                break;
+            }
+            unref(segment.block);
+            m_head++;
+        }
+        compact();
+    }
+
+    void ByteArray::read(void *buf, size_t len) {
+        peek(buf, len);
+        consume(len);
+    }
+
+    namespace {
+        // 返回 varint 占用的字节数
+        size_t decodeVarint(const uint8_t *buf, size_t len, uint64_t &value) {
+            value = 0;
+            for (size_t i = 0; i < len; i++) {
+                value |= (uint64_t) (buf[i] & 0x7f) << (7 * i);
+                if (!(buf[i] & 0x80)) {
+                    return i + 1;
+                }
+            }
+            throw std::out_of_range(len < kMaxVarintSize ? "ByteArray: incomplete varint" : "ByteArray: varint too long");
+        }
+    }
+
+    uint64_t ByteArray::readVarUint64() {
+        uint8_t buf[kMaxVarintSize];
+        size_t len = std::min(m_size, kMaxVarintSize);
+        peek(buf, len);
+        uint64_t value;
+        consume(decodeVarint(buf, len, value));
+        return value;
+    }
+
+    uint32_t ByteArray::readVarUint32() {
+        uint8_t buf[kMaxVarintSize];
+        size_t len = std::min(m_size, kMaxVarintSize);
+        peek(buf, len);
+        uint64_t value;
+        size_t n = decodeVarint(buf, len, value);
+        if (value > std::numeric_limits<uint32_t>::max()) {
+            throw std::out_of_range("ByteArray: varint exceeds 32 bits");
+        }
+        consume(n);
+        return (uint32_t) value;
+    }
+
+    int32_t ByteArray::readVarInt32() {
+        uint8_t buf[kMaxVarintSize];
+        size_t len = std::min(m_size, kMaxVarintSize);
+        peek(buf, len);
+        uint64_t value;
+        size_t n = decodeVarint(buf, len, value);
+        int64_t decoded = decodeZigzag(value);
+        if (decoded < std::numeric_limits<int32_t>::min() || decoded > std::numeric_limits<int32_t>::max()) {
+            throw std::out_of_range("ByteArray: varint exceeds 32 bits");
+        }
+        consume(n);
+        return (int32_t) decoded;
+    }
+
+    std::string ByteArray::readString() {
+        uint8_t buf[kMaxVarintSize];
+        size_t len = std::min(m_size, kMaxVarintSize);
+        peek(buf, len);
+        uint64_t size;
+        size_t n = decodeVarint(buf, len, size);
+        if (size > m_size - n) {
+            throw std::out_of_range("ByteArray: not enough data");
+        }
+        consume(n);
+        std::string str(size, '\0');
+        read(str.data(), size);
+        return str;
+    }
+
+    ByteArray ByteArray::slice(size_t offset, size_t len) const {
+        if (offset > m_size || len > m_size - offset) {
+            throw std::out_of_range("ByteArray: slice out of range");
+        }
+        ByteArray result;
+        // 最多跨越的块数, 一次分配好段数组
+        result.m_segments.reserve(std::min(m_segments.size() - m_head, len / kBlockCapacity + 2));
+        for (size_t i = m_head; len > 0; i++) {
+            const Segment &segment = m_segments[i];
+            size_t n = segment.end - segment.begin;
+            if (offset >= n) {
+                offset -= n;
+                continue;
+            }
+            size_t take = std::min(len, n - offset);
+            ref(segment.block);
+            result.m_segments.push_back(
+                    Segment{segment.block, (uint32_t) (segment.begin + offset), (uint32_t) (segment.begin + offset + take)});
+            result.m_size += take;
+            offset = 0;
+            len -= take;
+        }
+        return result;
+    }
+
+    size_t ByteArray::getReadBuffers(std::vector<iovec> &buffers, size_t max_len) const {
+        size_t total = 0;
+        for (size_t i = m_head; i < m_segments.size() && total < max_len; i++) {
+            const Segment &segment = m_segments[i];
+            size_t n = std::min((size_t) (segment.end - segment.begin), max_len - total);
+            if (n == 0) {
+                continue;
+            }
+            buffers.push_back(iovec{dataOf(segment.block) + segment.begin, n});
+            total += n;
+        }
+        return total;
+    }
+
+    size_t ByteArray::reserve(iovec *iov, size_t max_count, size_t len) {
+        if (m_reserve_from != SIZE_MAX) {
+            commit(0);
+        }
+        size_t count = 0;
+        while (len > 0 && count < max_count) {
+            Segment &tail = writableTail();
+            if (m_reserve_from == SIZE_MAX) {
+                m_reserve_from = m_segments.size() - 1;
+            }
+            size_t n = std::min(len, (size_t) (kBlockCapacity - tail.end));
+            iov[count++] = iovec{dataOf(tail.block) + tail.end, n};
+            len -= n;
+            if (len > 0) {
+                // 后面的空间在新块里, 先占住一个空段
+                m_segments.push_back(Segment{newBlock(), 0, 0});
+                if (count == max_count) {
+                    unref(m_segments.back().block);
+                    m_segments.pop_back();
+                }
+            }
+        }
+        return count;
+    }
+
+    void ByteArray::getWriteBuffers(std::vector<iovec> &buffers, size_t len) {
+        size_t count = (len + kBlockCapacity - 1) / kBlockCapacity + 1;
+        size_t old = buffers.size();
+        buffers.resize(old + count);
+        buffers.resize(old + reserve(buffers.data() + old, count, len));
+    }
+
+    void ByteArray::commit(size_t len) {
+        if (m_reserve_from == SIZE_MAX) {
+            if (len > 0) {
+                throw std::logic_error("ByteArray: commit without reserved space");
+            }
+            return;
+        }
+        size_t last = m_reserve_from;
+        for (size_t i = m_reserve_from; i < m_segments.size() && len > 0; i++) {
+            Segment &segment = m_segments[i];
+            size_t n = std::min(len, (size_t) (kBlockCapacity - segment.end));
+            segment.end += (uint32_t) n;
+            m_size += n;
+            len -= n;
+            last = i;
+        }
+        // 没用上的新块还回去
+        while (m_segments.size() > last + 1 && m_segments.back().begin == m_segments.back().end) {
+            unref(m_segments.back().block);
+            m_segments.pop_back();
+        }
+        m_reserve_from = SIZE_MAX;
+        if (m_size == 0) {
+            release();
+        }
+    }
+
+    ssize_t ByteArray::writeTo(int fd, int flags) {
+        iovec iov[kIovecBatch];
+        size_t count = 0;
+        for (size_t i = m_head; i < m_segments.size() && count < kIovecBatch; i++) {
+            const Segment &segment = m_segments[i];
+            if (segment.begin != segment.end) {
+                iov[count++] = iovec{dataOf(segment.block) + segment.begin, (size_t) (segment.end - segment.begin)};
+            }
+        }
+        if (count == 0) {
+            return 0;
+        }
+        ssize_t n;
+        if (flags) {
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            n = ::sendmsg(fd, &msg, flags);
+        } else {
+            n = ::writev(fd, iov, (int) count);
+        }
+        if (n > 0) {
+            consume((size_t) n);
+        }
+        return n;
+    }
+
+    ssize_t ByteArray::readFrom(int fd, size_t max_len) {
+        iovec iov[kIovecBatch];
+        size_t count = reserve(iov, kIovecBatch, max_len);
+        ssize_t n = ::readv(fd, iov, (int) count);
+        commit(n > 0 ? (size_t) n : 0);
+        return n;
+    }
+
+    std::string ByteArray::toString() const {
+        std::string str;
+        str.reserve(m_size);
+        for (size_t i = m_head; i < m_segments.size(); i++) {
+            const Segment &segment = m_segments[i];
+            str.append(dataOf(segment.block) + segment.begin, segment.end - segment.begin);
+        }
+        return str;
+    }
+
+}
@@ -0,0 +1,199 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_BYTEARRAY_H
+#define SYLAR_WEB_SERVER_BYTEARRAY_H
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace sylar {
+
+// 由定长内存块串成的字节缓冲, 从尾部追加, 从头部读取
+// 块从 ThreadLocalPool 分配并带引用计数, slice() 和 append(const ByteArray &) 只共享块不拷贝数据;
+// 写过的字节不会被改写, 只有独占的尾块才继续往里追加, 所以共享的数据对所有持有者都不变.
+// 读写 fd 时直接用块链组成 iovec 做 readv/writev, 不需要先拼成连续内存.
+// 定长整数按小端编码; 变长整数用 7 位一组的 varint, 有符号数先做 zigzag.
+// 单个 ByteArray 不是线程安全的, 共享同一块的不同 ByteArray 可以在不同线程使用.
+    class ByteArray {
+    public:
+        typedef std::shared_ptr<ByteArray> ptr;
+
+        static constexpr size_t kBlockSize = 4096;      //每块占用的内存, 包括块头
+
+        ByteArray() = default;
+
+        // 与 other 共享数据块
+        ByteArray(const ByteArray &other);
+
+        ByteArray &operator=(const ByteArray &other);
+
+        ByteArray(ByteArray &&other) noexcept;
+
+        ByteArray &operator=(ByteArray &&other) noexcept;
+
+        ~ByteArray();
+
+        // 可读的字节数
+        size_t size() const { return m_size; }
+
+        bool empty() const { return m_size == 0; }
+
+        void clear();
+
+        void write(const void *data, size_t len);
+
+        void write(std::string_view str) { write(str.data(), str.size()); }
+
+        template<class T>
+        void writeFixed(T value) {
+            static_assert(std::is_integral_v<T>, "writeFixed needs an integral type");
+            value = toLittleEndian(value);
+            write(&value, sizeof(value));
+        }
+
+        void writeFloat(float value) { writeFixed(std::bit_cast<uint32_t>(value)); }
+
+        void writeDouble(double value) { writeFixed(std::bit_cast<uint64_t>(value)); }
+
+        void writeVarUint64(uint64_t value);
+
+        void writeVarInt64(int64_t value) { writeVarUint64(encodeZigzag(value)); }
+
+        void writeVarUint32(uint32_t value) { writeVarUint64(value); }
+
+        void writeVarInt32(int32_t value) { writeVarUint64(encodeZigzag(value)); }
+
+        // varint 长度 + 内容
+        void writeString(std::string_view str);
+
+        // 把 other 的数据接到末尾, 共享块不拷贝
+        void append(const ByteArray &other);
+
+        void append(ByteArray &&other);
+
+        // 以下从头部读取并消费, 数据不够时抛出 std::out_of_range, 不消费任何数据
+        void read(void *buf, size_t len);
+
+        template<class T>
+        T readFixed() {
+            static_assert(std::is_integral_v<T>, "readFixed needs an integral type");
+            T value;
+            read(&value, sizeof(value));
+            return toLittleEndian(value);
+        }
+
+        float readFloat() { return std::bit_cast<float>(readFixed<uint32_t>()); }
+
+        double readDouble() { return std::bit_cast<double>(readFixed<uint64_t>()); }
+
+        uint64_t readVarUint64();
+
+        int64_t readVarInt64() { return decodeZigzag(readVarUint64()); }
+
+        // 超出 32 位范围时抛出 std::out_of_range
+        uint32_t readVarUint32();
+
+        int32_t readVarInt32();
+
+        std::string readString();
+
+        // 读取但不消费
+        void peek(void *buf, size_t len) const;
+
+        // 丢弃头部 len 个字节
+        void consume(size_t len);
+
+        // [offset, offset + len) 的零拷贝切片, 越界时抛出 std::out_of_range
+        ByteArray slice(size_t offset, size_t len) const;
+
+        // 可读数据的 iovec 追加到 buffers, 最多 max_len 个字节, 返回其中的字节数
+        size_t getReadBuffers(std::vector<iovec> &buffers, size_t max_len = SIZE_MAX) const;
+
+        // 在尾部预留 len 个字节的空间, 对应的 iovec 追加到 buffers; 写入后用 commit() 确认实际写入的字节数,
+        // 两者之间不能调用其他读写操作
+        void getWriteBuffers(std::vector<iovec> &buffers, size_t len);
+
+        // 确认预留空间中前 len 个字节已写入, 其余的预留空间释放
+        void commit(size_t len);
+
+        // writev 写出尽量多的数据并消费写出的部分, 返回值同 writev
+        // flags 不为 0 时改用 sendmsg(例如 MSG_MORE), fd 必须是 socket
+        ssize_t writeTo(int fd, int flags = 0);
+
+        // readv 读入最多 max_len 个字节追加到尾部, 返回值同 readv
+        ssize_t readFrom(int fd, size_t max_len = 64 * 1024);
+
+        std::string toString() const;
+
+    private:
+        struct Block;
+
+        // 块中属于本对象的一段 [begin, end)
+        struct Segment {
+            Block *block;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        template<class T>
+        static T toLittleEndian(T value) {
+            if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1) {
+                using U = std::make_unsigned_t<T>;
+                U u = (U) value;
+                if constexpr (sizeof(T) == 2) {
+                    u = __builtin_bswap16(u);
+                } else if constexpr (sizeof(T) == 4) {
+                    u = __builtin_bswap32(u);
+                } else {
+                    u = __builtin_bswap64(u);
+                }
+                return (T) u;
+            }
+            return value;
+        }
+
+        static uint64_t encodeZigzag(int64_t value) { return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63); }
+
+        static int64_t decodeZigzag(uint64_t value) { return (int64_t) (value >> 1) ^ -(int64_t) (value & 1); }
+
+        static Block *newBlock();
+
+        static void ref(Block *block);
+
+        static void unref(Block *block);
+
+        static char *dataOf(Block *block);
+
+        // 尾块可追加时返回它, 否则接一个新块
+        Segment &writableTail();
+
+        // 预留空间并填写最多 max_count 个 iovec, 返回填写的个数
+        size_t reserve(iovec *iov, size_t max_count, size_t len);
+
+        void release();
+
+        // 丢掉 m_head 之前已经读完的段
+        void compact();
+
+    private:
+        std::vector<Segment> m_segments;
+        size_t m_head = 0;              //第一个还有数据的段, 读空后可能留下一个独占的空尾段
+        size_t m_size = 0;
+        size_t m_reserve_from = SIZE_MAX;       //预留空间从这个段开始, 没有预留时为 SIZE_MAX
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_BYTEARRAY_H
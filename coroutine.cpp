@@ -0,0 +1,227 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "coroutine.h"
+#include <array>
+#include <cerrno>
+#include <sys/socket.h>
+#include "hook.h"
+#include "pool_allocator.h"
+
+namespace sylar {
+
+    namespace {
+        constexpr size_t kFrameGrain = 64;
+        constexpr size_t kFrameClasses = CoroutineFramePool::kMaxPooledSize / kFrameGrain;
+
+        struct FrameClass {
+            void *(*allocate)();
+
+            void (*deallocate)(void *);
+        };
+
+        template<size_t... I>
+        constexpr std::array<FrameClass, sizeof...(I)> makeFrameClasses(std::index_sequence<I...>) {
+            return {FrameClass{&ThreadLocalPool<(I + 1) * kFrameGrain>::allocate,
+                               &ThreadLocalPool<(I + 1) * kFrameGrain>::deallocate}...};
+        }
+
+        constexpr auto s_frame_classes = makeFrameClasses(std::make_index_sequence<kFrameClasses>());
+
+        // 与 Fiber 相同, Task 可能在别的线程上恢复, 线程本地变量统一通过不内联的函数访问
+        thread_local uint64_t t_task_id = 0;
+
+        // spawn 启动的最外层协程, 结束时自动释放, 不对外暴露
+        struct Detached {
+            struct promise_type {
+                static void *operator new(size_t size) { return CoroutineFramePool::allocate(size); }
+
+                static void operator delete(void *ptr, size_t size) noexcept {
+                    CoroutineFramePool::deallocate(ptr, size);
+                }
+
+                Detached get_return_object() {
+                    return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+
+                std::suspend_never final_suspend() const noexcept { return {}; }
+
+                void return_void() {}
+
+                void unhandled_exception() { std::terminate(); }
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        Detached runDetached(Task<void> task) {
+            uint64_t id = task.getId();
+            try {
+                co_await std::move(task);
+            } catch (std::exception &e) {
+                SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "task {} exited with exception: {}", id,
+                                e.what());
+            } catch (...) {
+                SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "task {} exited with exception", id);
+            }
+        }
+    }
+
+    void *CoroutineFramePool::allocate(size_t size) {
+        if (size == 0 || size > kMaxPooledSize) {
+            return ::operator new(size);
+        }
+        return s_frame_classes[(size - 1) / kFrameGrain].allocate();
+    }
+
+    void CoroutineFramePool::deallocate(void *ptr, size_t size) noexcept {
+        if (size == 0 || size > kMaxPooledSize) {
+            ::operator delete(ptr);
+            return;
+        }
+        s_frame_classes[(size - 1) / kFrameGrain].deallocate(ptr);
+    }
+
+    namespace detail {
+        __attribute__((noinline)) uint64_t getCurrentTaskId() {
+            asm volatile("" ::: "memory");
+            return t_task_id;
+        }
+
+        __attribute__((noinline)) void setCurrentTaskId(uint64_t id) {
+            asm volatile("" ::: "memory");
+            t_task_id = id;
+        }
+
+        void resumeTask(std::coroutine_handle<> handle) {
+            uint64_t prev = getCurrentTaskId();
+            handle.resume();
+            setCurrentTaskId(prev);
+        }
+    }
+
+    void spawn(Task<void> task, Scheduler *scheduler) {
+        auto handle = runDetached(std::move(task)).handle;
+        if (scheduler) {
+            scheduler->schedule([handle]() { detail::resumeTask(handle); });
+        } else {
+            detail::resumeTask(handle);
+        }
+    }
+
+    bool FdEventAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        IOManager *iom = IOManager::getThis();
+        if (!iom) {
+            throw std::invalid_argument("waitEvent must run on an IOManager worker");
+        }
+        if (m_timeout_ms != UINT64_MAX) {
+            m_state = std::make_shared<State>();
+        }
+        // 在工作线程上注册, 回调固定回到本线程, 本函数返回之前不会被恢复
+        if (iom->addEvent(m_fd, m_event, [handle]() { detail::resumeTask(handle); }) != 0) {
+            m_state = nullptr;
+            m_result = -EINVAL;
+            return false;
+        }
+        if (m_state) {
+            std::weak_ptr<State> weak(m_state);
+            int fd = m_fd;
+            IOManager::Event event = m_event;
+            m_timer = iom->addConditionTimer(m_timeout_ms, [iom, weak, fd, event]() {
+                auto state = weak.lock();
+                if (!state) {
+                    return;
+                }
+                state->timed_out.store(true, std::memory_order_relaxed);
+                iom->cancelEvent(fd, event);
+            }, weak);
+        }
+        return true;
+    }
+
+    int FdEventAwaiter::await_resume() {
+        if (m_timer) {
+            m_timer->cancel();
+            m_timer = nullptr;
+        }
+        if (m_result) {
+            return m_result;
+        }
+        if (m_state && m_state->timed_out.load(std::memory_order_relaxed)) {
+            return -ETIMEDOUT;
+        }
+        return 0;
+    }
+
+    void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        IOManager *iom = IOManager::getThis();
+        if (!iom) {
+            throw std::invalid_argument("sleepFor must run on an IOManager worker");
+        }
+        int thread = Scheduler::getWorkerIndex();
+        iom->addTimer(m_ms, [iom, handle, thread]() {
+            iom->schedule([handle]() { detail::resumeTask(handle); }, thread);
+        });
+    }
+
+    bool LogFlushAwaiter::await_ready() {
+        if (dynamic_cast<AsyncLogAppender *>(m_appender.get()) && Scheduler::getThis()) {
+            return false;
+        }
+        m_appender->flush();
+        return true;
+    }
+
+    void LogFlushAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        Scheduler *scheduler = Scheduler::getThis();
+        int thread = Scheduler::getWorkerIndex();
+        static_cast<AsyncLogAppender *>(m_appender.get())->flush([scheduler, handle, thread]() {
+            scheduler->schedule([handle]() { detail::resumeTask(handle); }, thread);
+        });
+    }
+
+    Task<ssize_t> asyncRecv(int fd, void *buf, size_t len, uint64_t timeout_ms) {
+        for (;;) {
+            // 直接调用原始函数, hook 开启时 recv 会挂起整个 fiber
+            ssize_t n = recv_f(fd, buf, len, MSG_DONTWAIT);
+            if (n >= 0) {
+                co_return n;
+            }
+            int err = errno;
+            if (err == EINTR) {
+                continue;
+            }
+            if (err != EAGAIN && err != EWOULDBLOCK) {
+                co_return -err;
+            }
+            int rt = co_await waitEvent(fd, IOManager::READ, timeout_ms);
+            if (rt < 0) {
+                co_return rt;
+            }
+        }
+    }
+
+    Task<ssize_t> asyncSend(int fd, const void *buf, size_t len, uint64_t timeout_ms) {
+        for (;;) {
+            ssize_t n = send_f(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n >= 0) {
+                co_return n;
+            }
+            int err = errno;
+            if (err == EINTR) {
+                continue;
+            }
+            if (err != EAGAIN && err != EWOULDBLOCK) {
+                co_return -err;
+            }
+            int rt = co_await waitEvent(fd, IOManager::WRITE, timeout_ms);
+            if (rt < 0) {
+                co_return rt;
+            }
+        }
+    }
+
+}
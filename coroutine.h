@@ -0,0 +1,314 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_COROUTINE_H
+#define SYLAR_WEB_SERVER_COROUTINE_H
+
+#include <sys/types.h>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "fiber.h"
+#include "iomanager.h"
+#include "log.h"
+
+namespace sylar {
+
+// 无栈协程帧分配器
+// 按 64 字节分级, 每级一个 ThreadLocalPool(与 PoolAllocator 共用), 超过 kMaxPooledSize 的帧直接 operator new.
+// 协程可能在别的线程上结束, 帧由其他线程释放时通过 ThreadLocalPool 的远端栈还给分配它的线程.
+    class CoroutineFramePool {
+    public:
+        static constexpr size_t kMaxPooledSize = 2048;
+
+        static void *allocate(size_t size);
+
+        static void deallocate(void *ptr, size_t size) noexcept;
+    };
+
+    template<class T>
+    class Task;
+
+    namespace detail {
+        // 当前正在执行的 Task 的协程号, 不在 Task 中时为 0
+        uint64_t getCurrentTaskId();
+
+        void setCurrentTaskId(uint64_t id);
+
+        // 从外部(事件回调, 定时器, 调度器任务)恢复一个挂起的 Task, 返回后恢复原来的协程号
+        void resumeTask(std::coroutine_handle<> handle);
+
+        template<class A>
+        decltype(auto) getAwaiter(A &&awaitable) {
+            if constexpr (requires { std::forward<A>(awaitable).operator co_await(); }) {
+                return std::forward<A>(awaitable).operator co_await();
+            } else {
+                return std::forward<A>(awaitable);
+            }
+        }
+
+        // 包装 Task 中的每个 co_await, 恢复执行时把当前协程号设回这个 Task
+        template<class Awaiter>
+        struct TaskIdAwaiter {
+            Awaiter awaiter;
+            uint64_t id;
+
+            bool await_ready() { return awaiter.await_ready(); }
+
+            template<class P>
+            auto await_suspend(std::coroutine_handle<P> handle) { return awaiter.await_suspend(handle); }
+
+            decltype(auto) await_resume() {
+                setCurrentTaskId(id);
+                return awaiter.await_resume();
+            }
+        };
+
+        struct PromiseBase {
+            uint64_t id = Fiber::allocateId();
+            std::coroutine_handle<> continuation;       //co_await 本 Task 的协程, 结束后回到那里
+            std::exception_ptr exception;
+
+            static void *operator new(size_t size) { return CoroutineFramePool::allocate(size); }
+
+            static void operator delete(void *ptr, size_t size) noexcept { CoroutineFramePool::deallocate(ptr, size); }
+
+            // 惰性启动, 被 co_await 或 spawn 时才开始执行
+            struct InitialAwaiter {
+                uint64_t id;
+
+                bool await_ready() const noexcept { return false; }
+
+                void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+                void await_resume() const noexcept { setCurrentTaskId(id); }
+            };
+
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+
+                template<class P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) const noexcept {
+                    auto next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            InitialAwaiter initial_suspend() const noexcept { return {id}; }
+
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+
+            void unhandled_exception() { exception = std::current_exception(); }
+
+            template<class A>
+            auto await_transform(A &&awaitable) {
+                // 左值等待体按引用保存, 临时对象按值保存
+                typedef decltype(getAwaiter(std::forward<A>(awaitable))) R;
+                typedef std::conditional_t<std::is_lvalue_reference_v<R>, R, std::remove_cvref_t<R>> Awaiter;
+                return TaskIdAwaiter<Awaiter>{getAwaiter(std::forward<A>(awaitable)), id};
+            }
+        };
+
+        template<class T>
+        struct Promise : PromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object();
+
+            template<class U>
+            void return_value(U &&val) { value.emplace(std::forward<U>(val)); }
+
+            T take() {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct Promise<void> : PromiseBase {
+            Task<void> get_return_object();
+
+            void return_void() {}
+
+            void take() {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+        };
+    }
+
+// 无栈协程, 返回 T
+// 挂起时只占用一个协程帧(从 CoroutineFramePool 分配), 不占用栈, 适合大量不需要深调用栈的连接处理.
+// 惰性启动: 在另一个 Task 中 co_await 时开始执行, 结束后直接切回等待者(对称转移, 不会加深调用栈);
+// 最外层的 Task 用 spawn() 启动. 每个 Task 有自己的协程号, 执行期间 getFiberId() 返回它, 日志 %F 可以区分.
+// Task 中抛出的异常在 co_await 处重新抛出.
+    template<class T = void>
+    class [[nodiscard]] Task {
+    public:
+        typedef detail::Promise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> handle_type;
+
+        static_assert(!std::is_reference_v<T>, "Task<T&> is not supported");
+
+        Task() = default;
+
+        explicit Task(handle_type handle) : m_handle(handle) {}
+
+        Task(Task &&other) noexcept: m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+        Task &operator=(Task &&other) noexcept {
+            if (this != &other) {
+                if (m_handle) {
+                    m_handle.destroy();
+                }
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+
+        Task &operator=(const Task &) = delete;
+
+        ~Task() {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+        }
+
+        bool valid() const { return (bool) m_handle; }
+
+        bool done() const { return !m_handle || m_handle.done(); }
+
+        uint64_t getId() const { return m_handle ? m_handle.promise().id : 0; }
+
+        auto operator co_await() && noexcept {
+            struct Awaiter {
+                handle_type handle;
+
+                bool await_ready() const noexcept { return !handle || handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+                    handle.promise().continuation = caller;
+                    return handle;
+                }
+
+                T await_resume() {
+                    if (!handle) {
+                        throw std::invalid_argument("co_await on an empty task");
+                    }
+                    return handle.promise().take();
+                }
+            };
+            return Awaiter{m_handle};
+        }
+
+    private:
+        handle_type m_handle;
+    };
+
+    namespace detail {
+        template<class T>
+        Task<T> Promise<T>::get_return_object() {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> Promise<void>::get_return_object() {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+    }
+
+// 启动最外层的 Task, 不等待结果; Task 结束后释放, 异常写到 root 日志
+// scheduler 为空时在当前线程立即开始执行, 直到第一次挂起才返回
+    void spawn(Task<void> task, Scheduler *scheduler = nullptr);
+
+// 等待 fd 上的事件, 需要在 IOManager 的工作线程上执行
+// co_await 的结果: 0 表示就绪(或被 cancelEvent 唤醒, 调用者需要重新检查 fd), -ETIMEDOUT 表示超时, 注册失败时为 -EINVAL
+    class FdEventAwaiter {
+    public:
+        FdEventAwaiter(int fd, IOManager::Event event, uint64_t timeout_ms = UINT64_MAX)
+                : m_fd(fd), m_event(event), m_timeout_ms(timeout_ms) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        int await_resume();
+
+    private:
+        struct State {
+            std::atomic<bool> timed_out{false};
+        };
+
+        int m_fd;
+        IOManager::Event m_event;
+        uint64_t m_timeout_ms;
+        int m_result = 0;
+        std::shared_ptr<State> m_state;
+        Timer::ptr m_timer;
+    };
+
+// 挂起 ms 毫秒, 需要在 IOManager 的工作线程上执行; 醒来后回到原来的工作线程
+    class SleepAwaiter {
+    public:
+        explicit SleepAwaiter(uint64_t ms) : m_ms(ms) {}
+
+        bool await_ready() const noexcept { return m_ms == 0; }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept {}
+
+    private:
+        uint64_t m_ms;
+    };
+
+// 等待日志 appender 写出并 flush 调用前的所有日志
+// AsyncLogAppender 在后台线程完成后恢复 Task, 不阻塞工作线程; 其他 appender 或者不在调度器中时直接同步 flush
+    class LogFlushAwaiter {
+    public:
+        explicit LogFlushAwaiter(LogAppender::ptr appender) : m_appender(std::move(appender)) {}
+
+        bool await_ready();
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept {}
+
+    private:
+        LogAppender::ptr m_appender;
+    };
+
+    inline FdEventAwaiter waitEvent(int fd, IOManager::Event event, uint64_t timeout_ms = UINT64_MAX) {
+        return FdEventAwaiter(fd, event, timeout_ms);
+    }
+
+    inline SleepAwaiter sleepFor(uint64_t ms) {
+        return SleepAwaiter(ms);
+    }
+
+    inline LogFlushAwaiter asyncFlush(LogAppender::ptr appender) {
+        return LogFlushAwaiter(std::move(appender));
+    }
+
+// socket 读写, 数据没有就绪时挂起 Task 而不是线程, 不依赖 fd 的 O_NONBLOCK 和 hook 开关
+// 返回值与 recv/send 相同, 出错时返回 -errno 而不是设置 errno(Task 恢复时可能已经换了线程)
+    Task<ssize_t> asyncRecv(int fd, void *buf, size_t len, uint64_t timeout_ms = UINT64_MAX);
+
+    Task<ssize_t> asyncSend(int fd, const void *buf, size_t len, uint64_t timeout_ms = UINT64_MAX);
+
+}
+
+#endif //SYLAR_WEB_SERVER_COROUTINE_H
@@ -0,0 +1,84 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "fd_manager.h"
+#include <algorithm>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "hook.h"
+
+namespace sylar {
+
+    FdCtx::FdCtx(int fd) : m_fd(fd) {
+        struct stat st;
+        m_is_socket = fstat(m_fd, &st) == 0 && S_ISSOCK(st.st_mode);
+        if (m_is_socket) {
+            // 直接调用原始 fcntl, 避免被 hook 版本改写成用户视角的标志
+            int flags = fcntl_f(m_fd, F_GETFL, 0);
+            if (!(flags & O_NONBLOCK)) {
+                fcntl_f(m_fd, F_SETFL, flags | O_NONBLOCK);
+            }
+            m_sys_nonblock = true;
+        }
+    }
+
+    uint64_t FdCtx::getTimeout(int type) const {
+        return type == SO_RCVTIMEO ? m_recv_timeout : m_send_timeout;
+    }
+
+    void FdCtx::setTimeout(int type, uint64_t ms) {
+        if (type == SO_RCVTIMEO) {
+            m_recv_timeout = ms;
+        } else {
+            m_send_timeout = ms;
+        }
+    }
+
+    FdManager::FdManager() {
+        m_fds.resize(64);
+    }
+
+    FdCtx::ptr FdManager::get(int fd, bool auto_create) {
+        if (fd < 0) {
+            return nullptr;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            if ((size_t) fd < m_fds.size() && (m_fds[fd] || !auto_create)) {
+                return m_fds[fd];
+            }
+            if (!auto_create) {
+                return nullptr;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if ((size_t) fd >= m_fds.size()) {
+            m_fds.resize(std::max((size_t) fd + 1, m_fds.size() * 3 / 2));
+        }
+        if (!m_fds[fd]) {
+            m_fds[fd] = std::make_shared<FdCtx>(fd);
+        }
+        return m_fds[fd];
+    }
+
+    void FdManager::del(int fd) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (fd >= 0 && (size_t) fd < m_fds.size()) {
+            m_fds[fd].reset();
+        }
+    }
+
+    void FdManager::forgetIOManager(IOManager *iom) {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (auto &ctx: m_fds) {
+            IOManager *expected = iom;
+            if (ctx) {
+                ctx->m_iomanager.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,87 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_FD_MANAGER_H
+#define SYLAR_WEB_SERVER_FD_MANAGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+namespace sylar {
+
+    class IOManager;
+
+// hook 层记录的文件描述符状态
+// 只管理经过 hook 的 socket()/accept() 创建的 socket, 它们在系统层面总是非阻塞的,
+// 用户通过 fcntl/ioctl 设置的非阻塞标志单独记录, 用户自己要求非阻塞时 hook 不再挂起协程.
+    class FdCtx {
+    public:
+        typedef std::shared_ptr<FdCtx> ptr;
+
+        explicit FdCtx(int fd);
+
+        bool isSocket() const { return m_is_socket; }
+
+        bool isClosed() const { return m_is_closed.load(std::memory_order_acquire); }
+
+        void setClosed() { m_is_closed.store(true, std::memory_order_release); }
+
+        bool getUserNonblock() const { return m_user_nonblock; }
+
+        void setUserNonblock(bool v) { m_user_nonblock = v; }
+
+        bool getSysNonblock() const { return m_sys_nonblock; }
+
+        // type 为 SO_RCVTIMEO 或 SO_SNDTIMEO, 单位毫秒, UINT64_MAX 表示不超时
+        uint64_t getTimeout(int type) const;
+
+        void setTimeout(int type, uint64_t ms);
+
+        // 最近一次在这个 fd 上等待事件的 IOManager, close 时在它上面取消等待, 与调用 close 的线程无关
+        IOManager *getIOManager() const { return m_iomanager.load(std::memory_order_acquire); }
+
+        void setIOManager(IOManager *iom) { m_iomanager.store(iom, std::memory_order_release); }
+
+    private:
+        friend class FdManager;
+
+        bool m_is_socket = false;
+        bool m_sys_nonblock = false;
+        bool m_user_nonblock = false;
+        std::atomic<bool> m_is_closed{false};
+        int m_fd;
+        uint64_t m_recv_timeout = UINT64_MAX;
+        uint64_t m_send_timeout = UINT64_MAX;
+        std::atomic<IOManager *> m_iomanager{nullptr};
+    };
+
+    class FdManager {
+    public:
+        static FdManager &getInstance() {
+            // 不析构, 其他静态对象析构时(例如关闭日志文件)还会经过 hook 的 close
+            static FdManager *instance = new FdManager;
+            return *instance;
+        }
+
+        // auto_create 为 false 时只返回已经登记的 fd
+        FdCtx::ptr get(int fd, bool auto_create = false);
+
+        void del(int fd);
+
+        // IOManager 析构时调用, 清除所有记录着它的 FdCtx
+        void forgetIOManager(IOManager *iom);
+
+    private:
+        FdManager();
+
+        std::shared_mutex m_mutex;
+        std::vector<FdCtx::ptr> m_fds;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_FD_MANAGER_H
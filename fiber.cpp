@@ -0,0 +1,362 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "fiber.h"
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// void sylar_fiber_switch(void **from_sp, void *to_sp);
+// 把被调用者保存寄存器压到当前栈上, 栈指针存入 *from_sp, 再从 to_sp 恢复另一个上下文
+// 新协程的初始栈由 Fiber::initContext 构造, 第一次切入时 ret 到 sylar_fiber_entry
+extern "C" void sylar_fiber_switch(void **from_sp, void *to_sp);
+extern "C" void sylar_fiber_entry();
+
+#if defined(__x86_64__)
+asm(R"(
+    .text
+    .globl sylar_fiber_switch
+    .type sylar_fiber_switch, @function
+    .align 16
+sylar_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size sylar_fiber_switch, .-sylar_fiber_switch
+
+    .globl sylar_fiber_entry
+    .type sylar_fiber_entry, @function
+    .align 16
+sylar_fiber_entry:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size sylar_fiber_entry, .-sylar_fiber_entry
+)");
+#elif defined(__aarch64__)
+asm(R"(
+    .text
+    .globl sylar_fiber_switch
+    .type sylar_fiber_switch, %function
+    .align 4
+sylar_fiber_switch:
+    sub sp, sp, #160
+    stp x19, x20, [sp, #0]
+    stp x21, x22, [sp, #16]
+    stp x23, x24, [sp, #32]
+    stp x25, x26, [sp, #48]
+    stp x27, x28, [sp, #64]
+    stp x29, x30, [sp, #80]
+    stp d8, d9, [sp, #96]
+    stp d10, d11, [sp, #112]
+    stp d12, d13, [sp, #128]
+    stp d14, d15, [sp, #144]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp x19, x20, [sp, #0]
+    ldp x21, x22, [sp, #16]
+    ldp x23, x24, [sp, #32]
+    ldp x25, x26, [sp, #48]
+    ldp x27, x28, [sp, #64]
+    ldp x29, x30, [sp, #80]
+    ldp d8, d9, [sp, #96]
+    ldp d10, d11, [sp, #112]
+    ldp d12, d13, [sp, #128]
+    ldp d14, d15, [sp, #144]
+    add sp, sp, #160
+    ret
+    .size sylar_fiber_switch, .-sylar_fiber_switch
+
+    .globl sylar_fiber_entry
+    .type sylar_fiber_entry, %function
+    .align 4
+sylar_fiber_entry:
+    mov x0, x19
+    blr x20
+    brk #0
+    .size sylar_fiber_entry, .-sylar_fiber_entry
+)");
+#else
+#error "sylar fiber: unsupported architecture"
+#endif
+
+namespace sylar {
+
+    namespace {
+        constexpr size_t kMaxLocalStacks = 64;
+        constexpr size_t kMaxGlobalStacks = 4096;
+
+        std::atomic<size_t> s_default_stack_size{128 * 1024};
+        std::atomic<uint64_t> s_fiber_id{0};
+        std::atomic<uint64_t> s_fiber_count{0};
+
+        struct GlobalStacks {
+            std::mutex mutex;
+            std::vector<FiberStack> stacks;
+
+            static GlobalStacks &getInstance() {
+                static GlobalStacks *instance = new GlobalStacks;
+                return *instance;
+            }
+        };
+
+        // 线程退出时把缓存的栈交给全局缓存
+        struct LocalStacks {
+            std::vector<FiberStack> stacks;
+
+            ~LocalStacks() {
+                auto &global = GlobalStacks::getInstance();
+                std::lock_guard<std::mutex> lock(global.mutex);
+                for (auto &stack: stacks) {
+                    if (global.stacks.size() < kMaxGlobalStacks) {
+                        global.stacks.push_back(stack);
+                    } else {
+                        munmap(stack.base, stack.size + FiberStack::pageSize());
+                    }
+                }
+            }
+        };
+
+        thread_local LocalStacks t_stacks;
+
+        // 协程可能在 yield 之后被别的线程 resume, 线程本地变量的地址不能跨切换缓存, 所以统一通过不内联的函数访问
+        thread_local Fiber *t_current = nullptr;
+
+        __attribute__((noinline)) Fiber *getCurrent() {
+            asm volatile("" ::: "memory");
+            return t_current;
+        }
+
+        __attribute__((noinline)) void setCurrent(Fiber *fiber) {
+            asm volatile("" ::: "memory");
+            t_current = fiber;
+        }
+    }
+
+    size_t FiberStack::pageSize() {
+        static const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        return page;
+    }
+
+    FiberStack FiberStackPool::allocate(size_t size) {
+        size_t page = FiberStack::pageSize();
+        size = (size + page - 1) / page * page;
+        if (size == getDefaultSize()) {
+            auto &local = t_stacks.stacks;
+            if (local.empty()) {
+                auto &global = GlobalStacks::getInstance();
+                std::lock_guard<std::mutex> lock(global.mutex);
+                // 一次取一批, 减少抢锁
+                while (!global.stacks.empty() && local.size() < kMaxLocalStacks / 2) {
+                    local.push_back(global.stacks.back());
+                    global.stacks.pop_back();
+                }
+            }
+            while (!local.empty()) {
+                FiberStack stack = local.back();
+                local.pop_back();
+                if (stack.size == size) {
+                    return stack;
+                }
+                // 默认大小被修改过, 旧的栈直接归还
+                munmap(stack.base, stack.size + page);
+            }
+        }
+
+        void *base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (base == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (mprotect(base, page, PROT_NONE) != 0) {
+            munmap(base, size + page);
+            throw std::bad_alloc();
+        }
+        FiberStack stack;
+        stack.base = base;
+        stack.size = size;
+        return stack;
+    }
+
+    void FiberStackPool::deallocate(const FiberStack &stack) {
+        if (!stack.base) {
+            return;
+        }
+        if (stack.size == getDefaultSize()) {
+            auto &local = t_stacks.stacks;
+            if (local.size() < kMaxLocalStacks) {
+                local.push_back(stack);
+                return;
+            }
+            auto &global = GlobalStacks::getInstance();
+            std::lock_guard<std::mutex> lock(global.mutex);
+            if (global.stacks.size() < kMaxGlobalStacks) {
+                global.stacks.push_back(stack);
+                return;
+            }
+        }
+        munmap(stack.base, stack.size + FiberStack::pageSize());
+    }
+
+    size_t FiberStackPool::getDefaultSize() {
+        return s_default_stack_size.load(std::memory_order_relaxed);
+    }
+
+    void FiberStackPool::setDefaultSize(size_t size) {
+        if (size < 2 * FiberStack::pageSize()) {
+            throw std::invalid_argument("fiber stack size is too small");
+        }
+        size_t page = FiberStack::pageSize();
+        s_default_stack_size.store((size + page - 1) / page * page, std::memory_order_relaxed);
+    }
+
+    Fiber::Fiber(std::function<void()> cb, size_t stack_size)
+            : m_id(++s_fiber_id), m_cb(std::move(cb)) {
+        if (!m_cb) {
+            throw std::invalid_argument("fiber needs a callback");
+        }
+        m_stack = FiberStackPool::allocate(stack_size ? stack_size : FiberStackPool::getDefaultSize());
+        initContext();
+        ++s_fiber_count;
+    }
+
+    Fiber::~Fiber() {
+        // 还没执行完的协程栈上的对象不会被析构, 由使用者保证只销毁 READY(未开始) 或 TERM 状态的协程
+        FiberStackPool::deallocate(m_stack);
+        --s_fiber_count;
+    }
+
+    void Fiber::initContext() {
+        auto *top = reinterpret_cast<uintptr_t *>((reinterpret_cast<uintptr_t>(m_stack.top()) - 16) & ~uintptr_t(15));
+#if defined(__x86_64__)
+        // 与 sylar_fiber_switch 的压栈顺序相反: mxcsr/fpucw, r15, r14, r13, r12, rbx, rbp, 返回地址
+        // ret 之后 rsp 16 字节对齐, sylar_fiber_entry 中的 call 满足 ABI 要求
+        uintptr_t *sp = top - 8;
+        uint32_t csr[2] = {0x1F80, 0x037F};
+        memcpy(&sp[0], csr, sizeof(csr));
+        sp[1] = 0;                                          //r15
+        sp[2] = 0;                                          //r14
+        sp[3] = reinterpret_cast<uintptr_t>(&Fiber::mainFunc);     //r13
+        sp[4] = reinterpret_cast<uintptr_t>(this);          //r12
+        sp[5] = 0;                                          //rbx
+        sp[6] = 0;                                          //rbp
+        sp[7] = reinterpret_cast<uintptr_t>(&sylar_fiber_entry);   //返回地址
+#elif defined(__aarch64__)
+        // x19..x28, x29, x30, d8..d15, 共 20 个槽位
+        uintptr_t *sp = top - 20;
+        memset(sp, 0, 20 * sizeof(uintptr_t));
+        sp[0] = reinterpret_cast<uintptr_t>(this);          //x19
+        sp[1] = reinterpret_cast<uintptr_t>(&Fiber::mainFunc);     //x20
+        sp[11] = reinterpret_cast<uintptr_t>(&sylar_fiber_entry);  //x30
+#endif
+        m_sp = sp;
+    }
+
+    void Fiber::reset(std::function<void()> cb) {
+        if (m_state != State::TERM) {
+            throw std::invalid_argument("fiber can only be reset after it terminated");
+        }
+        if (!cb) {
+            throw std::invalid_argument("fiber needs a callback");
+        }
+        m_cb = std::move(cb);
+        m_exception = nullptr;
+        m_id = ++s_fiber_id;
+        m_state = State::READY;
+        initContext();
+    }
+
+    void Fiber::resume() {
+        // 调度器中常见的情况: 协程登记了等待的事件后 yield, 事件在别的线程上先到达并 resume 它
+        while (m_on_cpu.load(std::memory_order_acquire)) {
+#if defined(__x86_64__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+        if (m_state != State::READY) {
+            throw std::invalid_argument("fiber is not ready to resume");
+        }
+        m_caller = getCurrent();
+        m_state = State::RUNNING;
+        m_on_cpu.store(true, std::memory_order_relaxed);
+        setCurrent(this);
+        sylar_fiber_switch(&m_caller_sp, m_sp);
+        // 回到这里时协程已经 yield 或执行完毕, setCurrent 已由切出的一方完成
+        m_on_cpu.store(false, std::memory_order_release);
+        if (m_exception) {
+            std::exception_ptr e;
+            std::swap(e, m_exception);
+            std::rethrow_exception(e);
+        }
+    }
+
+    void Fiber::yield() {
+        Fiber *cur = getCurrent();
+        if (!cur) {
+            throw std::invalid_argument("yield outside of a fiber");
+        }
+        cur->m_state = State::READY;
+        setCurrent(cur->m_caller);
+        sylar_fiber_switch(&cur->m_sp, cur->m_caller_sp);
+    }
+
+    Fiber *Fiber::getThis() {
+        return getCurrent();
+    }
+
+    uint64_t Fiber::getCurrentId() {
+        Fiber *cur = getCurrent();
+        return cur ? cur->m_id : 0;
+    }
+
+    uint64_t Fiber::getTotalFibers() {
+        return s_fiber_count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Fiber::allocateId() {
+        return ++s_fiber_id;
+    }
+
+    void Fiber::mainFunc(void *arg) {
+        auto *fiber = static_cast<Fiber *>(arg);
+        try {
+            fiber->m_cb();
+        } catch (...) {
+            fiber->m_exception = std::current_exception();
+        }
+        // 回调持有的资源在协程栈上释放
+        fiber->m_cb = nullptr;
+        fiber->m_state = State::TERM;
+        setCurrent(fiber->m_caller);
+        void *dummy;
+        sylar_fiber_switch(&dummy, fiber->m_caller_sp);
+        __builtin_unreachable();
+    }
+
+}
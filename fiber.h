@@ -0,0 +1,109 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_FIBER_H
+#define SYLAR_WEB_SERVER_FIBER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace sylar {
+
+// 协程栈, 低地址处有一页不可访问的保护页, 栈溢出时直接触发 SIGSEGV 而不是踩坏其他内存
+    struct FiberStack {
+        void *base = nullptr;       //mmap 返回的起始地址(含保护页)
+        size_t size = 0;            //可用栈大小, 不含保护页
+        void *top() const { return static_cast<char *>(base) + size + pageSize(); }
+
+        static size_t pageSize();
+    };
+
+// 协程栈分配器
+// 默认大小的栈用完后放进本线程的缓存, 缓存满了放进全局缓存, 新建协程优先复用, 避免反复 mmap/munmap.
+// 栈用 MAP_NORESERVE 映射, 只有实际用到的页才占物理内存.
+    class FiberStackPool {
+    public:
+        static FiberStack allocate(size_t size);
+
+        static void deallocate(const FiberStack &stack);
+
+        // 默认栈大小, 只有这个大小的栈会被缓存
+        static size_t getDefaultSize();
+
+        static void setDefaultSize(size_t size);
+    };
+
+// 有栈协程
+// 上下文切换是手写汇编, 只保存被调用者保存寄存器, 不像 swapcontext 那样每次切换都要系统调用设置信号掩码.
+// 非对称模型: resume() 从当前上下文切进协程, 协程里 yield() 回到调用 resume() 的地方, 可以嵌套.
+// yield 之后可以在别的线程上 resume.
+    class Fiber : public std::enable_shared_from_this<Fiber> {
+    public:
+        typedef std::shared_ptr<Fiber> ptr;
+
+        enum class State {
+            READY,      //还没开始或者已经 yield, 可以 resume
+            RUNNING,    //正在执行
+            TERM        //执行完毕(包括抛出异常)
+        };
+
+        // stack_size 为 0 时使用 FiberStackPool 的默认大小
+        explicit Fiber(std::function<void()> cb, size_t stack_size = 0);
+
+        Fiber(const Fiber &) = delete;
+
+        Fiber &operator=(const Fiber &) = delete;
+
+        ~Fiber();
+
+        // 执行完毕后复用栈和对象执行新的函数, 会分配新的协程号
+        void reset(std::function<void()> cb);
+
+        // 切换到本协程, 直到它 yield 或执行完毕才返回; 协程中抛出的异常在这里重新抛出
+        // 协程如果刚在其他线程上 yield 还没切换完, 会等它切换完再切入
+        void resume();
+
+        // 当前协程让出执行权, 回到 resume() 的调用者
+        static void yield();
+
+        // 当前正在执行的协程, 不在协程中时为 nullptr
+        static Fiber *getThis();
+
+        // 当前协程号, 不在协程中时为 0
+        static uint64_t getCurrentId();
+
+        // 还没有析构的协程数量
+        static uint64_t getTotalFibers();
+
+        // 分配一个新的协程号, 无栈协程(Task)和有栈协程共用这个序列, 日志中的 %F 不会重复
+        static uint64_t allocateId();
+
+        uint64_t getId() const { return m_id; }
+
+        State getState() const { return m_state; }
+
+    private:
+        static void mainFunc(void *arg);
+
+        void initContext();
+
+    private:
+        uint64_t m_id = 0;
+        State m_state = State::READY;
+        FiberStack m_stack;
+        void *m_sp = nullptr;               //切出时保存的栈指针
+        void *m_caller_sp = nullptr;        //resume() 调用者的栈指针
+        Fiber *m_caller = nullptr;          //resume() 时正在执行的协程, 嵌套 resume 时不为空
+        std::atomic<bool> m_on_cpu{false};  //从 resume() 切入到切回 resume() 之间为 true
+        std::function<void()> m_cb;
+        std::exception_ptr m_exception;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_FIBER_H
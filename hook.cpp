@@ -0,0 +1,456 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "hook.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <memory>
+#include "fd_manager.h"
+#include "fiber.h"
+#include "iomanager.h"
+
+#define HOOK_FUN(XX) \
+    XX(sleep) \
+    XX(usleep) \
+    XX(nanosleep) \
+    XX(socket) \
+    XX(connect) \
+    XX(accept) \
+    XX(read) \
+    XX(readv) \
+    XX(recv) \
+    XX(recvfrom) \
+    XX(recvmsg) \
+    XX(write) \
+    XX(writev) \
+    XX(send) \
+    XX(sendto) \
+    XX(sendmsg) \
+    XX(sendfile) \
+    XX(close) \
+    XX(fcntl) \
+    XX(ioctl) \
+    XX(setsockopt)
+
+extern "C" {
+#define XX(name) name ## _fun name ## _f = nullptr;
+HOOK_FUN(XX)
+#undef XX
+}
+
+namespace sylar {
+
+    namespace {
+        thread_local bool t_hook_enable = false;
+        std::atomic<uint64_t> s_connect_timeout{UINT64_MAX};
+
+        void hookInit() {
+#define XX(name) name ## _f = (name ## _fun) dlsym(RTLD_NEXT, #name);
+            HOOK_FUN(XX)
+#undef XX
+        }
+
+        // 其他静态对象的构造函数里也可能调用这些函数, 所以每个 hook 函数都会检查一次
+        struct HookIniter {
+            HookIniter() {
+                hookInit();
+            }
+        };
+
+        HookIniter s_hook_initer;
+
+        inline void ensureInit() {
+            if (__builtin_expect(!close_f, 0)) {
+                hookInit();
+            }
+        }
+
+        // 当前调用是否应该挂起协程而不是线程
+        inline IOManager *hookedIOManager() {
+            if (!t_hook_enable || !Fiber::getThis()) {
+                return nullptr;
+            }
+            return IOManager::getThis();
+        }
+
+        struct TimerInfo {
+            int cancelled = 0;
+        };
+
+        // 在 fd 上执行一次可能阻塞的 IO, 返回 EAGAIN 时挂起当前协程等待 event, 超时后返回 ETIMEDOUT
+        template<class OriginFun, class... Args>
+        ssize_t doIO(int fd, OriginFun fun, IOManager::Event event, int timeout_type, Args &&... args) {
+            ensureInit();
+            IOManager *iom = hookedIOManager();
+            if (!iom) {
+                return fun(fd, std::forward<Args>(args)...);
+            }
+            FdCtx::ptr ctx = FdManager::getInstance().get(fd);
+            if (!ctx) {
+                return fun(fd, std::forward<Args>(args)...);
+            }
+            if (ctx->isClosed()) {
+                errno = EBADF;
+                return -1;
+            }
+            if (!ctx->isSocket() || ctx->getUserNonblock()) {
+                return fun(fd, std::forward<Args>(args)...);
+            }
+
+            uint64_t timeout = ctx->getTimeout(timeout_type);
+            auto info = std::make_shared<TimerInfo>();
+            for (;;) {
+                ssize_t n = fun(fd, std::forward<Args>(args)...);
+                while (n == -1 && errno == EINTR) {
+                    n = fun(fd, std::forward<Args>(args)...);
+                }
+                if (n != -1 || errno != EAGAIN) {
+                    return n;
+                }
+
+                Timer::ptr timer;
+                std::weak_ptr<TimerInfo> weak_info(info);
+                if (timeout != UINT64_MAX) {
+                    timer = iom->addConditionTimer(timeout, [weak_info, fd, iom, event]() {
+                        auto t = weak_info.lock();
+                        if (!t || t->cancelled) {
+                            return;
+                        }
+                        t->cancelled = ETIMEDOUT;
+                        iom->cancelEvent(fd, event);
+                    }, weak_info);
+                }
+                ctx->setIOManager(iom);
+                if (iom->addEvent(fd, event) != 0) {
+                    if (timer) {
+                        timer->cancel();
+                    }
+                    return -1;
+                }
+                Fiber::yield();
+                if (timer) {
+                    timer->cancel();
+                }
+                if (info->cancelled) {
+                    errno = info->cancelled;
+                    return -1;
+                }
+                // 被 close 唤醒, fd 可能还没真正关闭, 不能再次等待
+                if (ctx->isClosed()) {
+                    errno = EBADF;
+                    return -1;
+                }
+            }
+        }
+
+        // 用定时器代替线程睡眠, 醒来后回到原来的工作线程
+        void sleepFiber(IOManager *iom, uint64_t ms) {
+            Fiber::ptr fiber = Fiber::getThis()->shared_from_this();
+            int thread = Scheduler::getThis() == iom ? Scheduler::getWorkerIndex() : -1;
+            iom->addTimer(ms, [iom, fiber, thread]() {
+                iom->schedule(fiber, thread);
+            });
+            Fiber::yield();
+        }
+    }
+
+    bool isHookEnable() {
+        return t_hook_enable;
+    }
+
+    void setHookEnable(bool flag) {
+        ensureInit();
+        t_hook_enable = flag;
+    }
+
+    void setConnectTimeout(uint64_t ms) {
+        s_connect_timeout.store(ms, std::memory_order_relaxed);
+    }
+
+}
+
+using sylar::doIO;
+using sylar::IOManager;
+
+extern "C" {
+
+unsigned int sleep(unsigned int seconds) {
+    sylar::ensureInit();
+    IOManager *iom = sylar::hookedIOManager();
+    if (!iom) {
+        return sleep_f(seconds);
+    }
+    sylar::sleepFiber(iom, (uint64_t) seconds * 1000);
+    return 0;
+}
+
+int usleep(useconds_t usec) {
+    sylar::ensureInit();
+    IOManager *iom = sylar::hookedIOManager();
+    if (!iom) {
+        return usleep_f(usec);
+    }
+    sylar::sleepFiber(iom, usec / 1000);
+    return 0;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem) {
+    sylar::ensureInit();
+    IOManager *iom = sylar::hookedIOManager();
+    if (!iom || !req) {
+        return nanosleep_f(req, rem);
+    }
+    sylar::sleepFiber(iom, (uint64_t) req->tv_sec * 1000 + req->tv_nsec / 1000000);
+    if (rem) {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
+    }
+    return 0;
+}
+
+int socket(int domain, int type, int protocol) noexcept {
+    sylar::ensureInit();
+    int fd = socket_f(domain, type, protocol);
+    if (fd >= 0 && sylar::t_hook_enable) {
+        sylar::FdManager::getInstance().get(fd, true);
+    }
+    return fd;
+}
+
+int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen, uint64_t timeout_ms) {
+    sylar::ensureInit();
+    IOManager *iom = sylar::hookedIOManager();
+    if (!iom) {
+        return connect_f(fd, addr, addrlen);
+    }
+    // 与 doIO 相同, 没有经过 hook 创建的 fd 直接调用原始函数
+    sylar::FdCtx::ptr ctx = sylar::FdManager::getInstance().get(fd);
+    if (!ctx) {
+        return connect_f(fd, addr, addrlen);
+    }
+    if (ctx->isClosed()) {
+        errno = EBADF;
+        return -1;
+    }
+    if (!ctx->isSocket() || ctx->getUserNonblock()) {
+        return connect_f(fd, addr, addrlen);
+    }
+
+    int n = connect_f(fd, addr, addrlen);
+    if (n == 0) {
+        return 0;
+    } else if (n != -1 || errno != EINPROGRESS) {
+        return n;
+    }
+
+    auto info = std::make_shared<sylar::TimerInfo>();
+    std::weak_ptr<sylar::TimerInfo> weak_info(info);
+    sylar::Timer::ptr timer;
+    if (timeout_ms != UINT64_MAX) {
+        timer = iom->addConditionTimer(timeout_ms, [weak_info, fd, iom]() {
+            auto t = weak_info.lock();
+            if (!t || t->cancelled) {
+                return;
+            }
+            t->cancelled = ETIMEDOUT;
+            iom->cancelEvent(fd, IOManager::WRITE);
+        }, weak_info);
+    }
+    ctx->setIOManager(iom);
+    if (iom->addEvent(fd, IOManager::WRITE) == 0) {
+        sylar::Fiber::yield();
+        if (timer) {
+            timer->cancel();
+        }
+        if (info->cancelled) {
+            errno = info->cancelled;
+            return -1;
+        }
+    } else if (timer) {
+        timer->cancel();
+    }
+
+    int error = 0;
+    socklen_t len = sizeof(int);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+        return -1;
+    }
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
+    return connect_with_timeout(sockfd, addr, addrlen, sylar::s_connect_timeout.load(std::memory_order_relaxed));
+}
+
+int accept(int s, struct sockaddr *addr, socklen_t *addrlen) {
+    int fd = (int) doIO(s, accept_f, IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+    if (fd >= 0 && sylar::t_hook_enable) {
+        sylar::FdManager::getInstance().get(fd, true);
+    }
+    return fd;
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+    return doIO(fd, read_f, IOManager::READ, SO_RCVTIMEO, buf, count);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
+    return doIO(fd, readv_f, IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+}
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
+    return doIO(sockfd, recv_f, IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+}
+
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
+    return doIO(sockfd, recvfrom_f, IOManager::READ, SO_RCVTIMEO, buf, len, flags, src_addr, addrlen);
+}
+
+ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
+    return doIO(sockfd, recvmsg_f, IOManager::READ, SO_RCVTIMEO, msg, flags);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    return doIO(fd, write_f, IOManager::WRITE, SO_SNDTIMEO, buf, count);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+    return doIO(fd, writev_f, IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+}
+
+ssize_t send(int s, const void *msg, size_t len, int flags) {
+    return doIO(s, send_f, IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
+}
+
+ssize_t sendto(int s, const void *msg, size_t len, int flags, const struct sockaddr *to, socklen_t tolen) {
+    return doIO(s, sendto_f, IOManager::WRITE, SO_SNDTIMEO, msg, len, flags, to, tolen);
+}
+
+ssize_t sendmsg(int s, const struct msghdr *msg, int flags) {
+    return doIO(s, sendmsg_f, IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) noexcept {
+    return doIO(out_fd, sendfile_f, IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count);
+}
+
+int close(int fd) {
+    sylar::ensureInit();
+    // 不论当前线程是否启用 hook 都要清理, 否则复用这个 fd 号的新 socket 会拿到已关闭的 FdCtx,
+    // 等待在旧 fd 上的协程也不会被唤醒
+    sylar::FdCtx::ptr ctx = sylar::FdManager::getInstance().get(fd);
+    if (ctx) {
+        ctx->setClosed();
+        IOManager *iom = ctx->getIOManager();
+        if (!iom) {
+            iom = IOManager::getThis();
+        }
+        if (iom) {
+            iom->cancelAll(fd);
+        }
+        sylar::FdManager::getInstance().del(fd);
+    }
+    return close_f(fd);
+}
+
+int fcntl(int fd, int cmd, ...) {
+    sylar::ensureInit();
+    va_list va;
+    va_start(va, cmd);
+    switch (cmd) {
+        case F_SETFL: {
+            int arg = va_arg(va, int);
+            va_end(va);
+            sylar::FdCtx::ptr ctx = sylar::FdManager::getInstance().get(fd);
+            if (!ctx || ctx->isClosed() || !ctx->isSocket()) {
+                return fcntl_f(fd, cmd, arg);
+            }
+            // 系统层面保持非阻塞, 用户设置的值只记录下来
+            ctx->setUserNonblock(arg & O_NONBLOCK);
+            arg = ctx->getSysNonblock() ? (arg | O_NONBLOCK) : (arg & ~O_NONBLOCK);
+            return fcntl_f(fd, cmd, arg);
+        }
+        case F_GETFL: {
+            va_end(va);
+            int arg = fcntl_f(fd, cmd);
+            sylar::FdCtx::ptr ctx = sylar::FdManager::getInstance().get(fd);
+            if (arg == -1 || !ctx || ctx->isClosed() || !ctx->isSocket()) {
+                return arg;
+            }
+            return ctx->getUserNonblock() ? (arg | O_NONBLOCK) : (arg & ~O_NONBLOCK);
+        }
+        case F_DUPFD:
+        case F_DUPFD_CLOEXEC:
+        case F_SETFD:
+        case F_SETOWN:
+        case F_SETSIG:
+        case F_SETLEASE:
+        case F_NOTIFY:
+#ifdef F_SETPIPE_SZ
+        case F_SETPIPE_SZ:
+#endif
+        {
+            int arg = va_arg(va, int);
+            va_end(va);
+            return fcntl_f(fd, cmd, arg);
+        }
+        case F_GETFD:
+        case F_GETOWN:
+        case F_GETSIG:
+        case F_GETLEASE:
+#ifdef F_GETPIPE_SZ
+        case F_GETPIPE_SZ:
+#endif
+        {
+            va_end(va);
+            return fcntl_f(fd, cmd);
+        }
+        default: {
+            // 其余命令的参数都是指针(锁, F_GETOWN_EX 等)
+            void *arg = va_arg(va, void *);
+            va_end(va);
+            return fcntl_f(fd, cmd, arg);
+        }
+    }
+}
+
+int ioctl(int d, unsigned long int request, ...) noexcept {
+    sylar::ensureInit();
+    va_list va;
+    va_start(va, request);
+    void *arg = va_arg(va, void *);
+    va_end(va);
+
+    if (request == FIONBIO) {
+        bool user_nonblock = !!*(int *) arg;
+        sylar::FdCtx::ptr ctx = sylar::FdManager::getInstance().get(d);
+        if (ctx && !ctx->isClosed() && ctx->isSocket()) {
+            ctx->setUserNonblock(user_nonblock);
+            // 系统层面保持非阻塞
+            return 0;
+        }
+    }
+    return ioctl_f(d, request, arg);
+}
+
+int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen) noexcept {
+    sylar::ensureInit();
+    if (sylar::t_hook_enable && level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)) {
+        sylar::FdCtx::ptr ctx = sylar::FdManager::getInstance().get(sockfd);
+        if (ctx && optval && optlen >= sizeof(timeval)) {
+            auto *v = (const timeval *) optval;
+            uint64_t ms = (uint64_t) v->tv_sec * 1000 + v->tv_usec / 1000;
+            ctx->setTimeout(optname, ms == 0 ? UINT64_MAX : ms);
+        }
+    }
+    return setsockopt_f(sockfd, level, optname, optval, optlen);
+}
+
+}
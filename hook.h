@@ -0,0 +1,105 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_HOOK_H
+#define SYLAR_WEB_SERVER_HOOK_H
+
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// 系统调用 hook
+// 本模块定义了同名的 read/write/recv/send/sendfile/accept/connect/sleep 等函数, 链接后覆盖 libc 的版本.
+// 只有开启了 hook 的线程, 在 IOManager 调度的协程中调用时才会改变行为: 会阻塞的调用挂起当前协程,
+// 等 fd 就绪或超时(SO_RCVTIMEO/SO_SNDTIMEO)后再恢复, 线程继续执行其他协程; 其他情况直接调用原始函数.
+// IOManager 的工作线程默认开启 hook, 其他线程用 setHookEnable(true) 自行开启.
+namespace sylar {
+    bool isHookEnable();
+
+    void setHookEnable(bool flag);
+
+    // hook 后 connect 的默认超时, 毫秒, UINT64_MAX 表示不超时
+    void setConnectTimeout(uint64_t ms);
+}
+
+extern "C" {
+
+// 原始函数, 通过 dlsym(RTLD_NEXT) 取得
+typedef unsigned int (*sleep_fun)(unsigned int seconds);
+extern sleep_fun sleep_f;
+
+typedef int (*usleep_fun)(useconds_t usec);
+extern usleep_fun usleep_f;
+
+typedef int (*nanosleep_fun)(const struct timespec *req, struct timespec *rem);
+extern nanosleep_fun nanosleep_f;
+
+typedef int (*socket_fun)(int domain, int type, int protocol);
+extern socket_fun socket_f;
+
+typedef int (*connect_fun)(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
+extern connect_fun connect_f;
+
+typedef int (*accept_fun)(int s, struct sockaddr *addr, socklen_t *addrlen);
+extern accept_fun accept_f;
+
+typedef ssize_t (*read_fun)(int fd, void *buf, size_t count);
+extern read_fun read_f;
+
+typedef ssize_t (*readv_fun)(int fd, const struct iovec *iov, int iovcnt);
+extern readv_fun readv_f;
+
+typedef ssize_t (*recv_fun)(int sockfd, void *buf, size_t len, int flags);
+extern recv_fun recv_f;
+
+typedef ssize_t (*recvfrom_fun)(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr,
+                                socklen_t *addrlen);
+extern recvfrom_fun recvfrom_f;
+
+typedef ssize_t (*recvmsg_fun)(int sockfd, struct msghdr *msg, int flags);
+extern recvmsg_fun recvmsg_f;
+
+typedef ssize_t (*write_fun)(int fd, const void *buf, size_t count);
+extern write_fun write_f;
+
+typedef ssize_t (*writev_fun)(int fd, const struct iovec *iov, int iovcnt);
+extern writev_fun writev_f;
+
+typedef ssize_t (*send_fun)(int s, const void *msg, size_t len, int flags);
+extern send_fun send_f;
+
+typedef ssize_t (*sendto_fun)(int s, const void *msg, size_t len, int flags, const struct sockaddr *to,
+                              socklen_t tolen);
+extern sendto_fun sendto_f;
+
+typedef ssize_t (*sendmsg_fun)(int s, const struct msghdr *msg, int flags);
+extern sendmsg_fun sendmsg_f;
+
+typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset, size_t count);
+extern sendfile_fun sendfile_f;
+
+typedef int (*close_fun)(int fd);
+extern close_fun close_f;
+
+typedef int (*fcntl_fun)(int fd, int cmd, ...);
+extern fcntl_fun fcntl_f;
+
+typedef int (*ioctl_fun)(int d, unsigned long int request, ...);
+extern ioctl_fun ioctl_f;
+
+typedef int (*setsockopt_fun)(int sockfd, int level, int optname, const void *optval, socklen_t optlen);
+extern setsockopt_fun setsockopt_f;
+
+// 带超时的 connect, timeout_ms 为 UINT64_MAX 时不超时
+int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen, uint64_t timeout_ms);
+
+}
+
+#endif //SYLAR_WEB_SERVER_HOOK_H
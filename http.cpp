@@ -0,0 +1,326 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "http.h"
+#include <ctime>
+#include <unistd.h>
+#include <fmt/format.h>
+
+namespace sylar {
+    namespace http {
+
+        namespace {
+            constexpr std::string_view kMethodNames[] = {
+#define XX(name) #name,
+                    SYLAR_HTTP_METHOD_MAP(XX)
+#undef XX
+            };
+
+            inline char toLower(char c) {
+                return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+            }
+
+            std::string_view trim(std::string_view str) {
+                while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+                    str.remove_prefix(1);
+                }
+                while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+                    str.remove_suffix(1);
+                }
+                return str;
+            }
+
+            // 严格的十进制数, 溢出或有其他字符时返回 false
+            bool parseSize(std::string_view str, size_t &value) {
+                if (str.empty() || str.size() > 18) {
+                    return false;
+                }
+                value = 0;
+                for (char c: str) {
+                    if (c < '0' || c > '9') {
+                        return false;
+                    }
+                    value = value * 10 + (c - '0');
+                }
+                return true;
+            }
+
+            // 按秒缓存的 Date 头部
+            struct DateCache {
+                time_t second = -1;
+                char text[64];
+                size_t len = 0;
+            };
+
+            thread_local DateCache t_date;
+
+            std::string_view dateHeader() {
+                time_t now = time(nullptr);
+                if (now != t_date.second) {
+                    struct tm tm{};
+                    gmtime_r(&now, &tm);
+                    t_date.len = strftime(t_date.text, sizeof(t_date.text), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+                    t_date.second = now;
+                }
+                return {t_date.text, t_date.len};
+            }
+        }
+
+        std::string_view toString(HttpMethod method) {
+            size_t i = (size_t) method;
+            return i < std::size(kMethodNames) ? kMethodNames[i] : std::string_view("<unknown>");
+        }
+
+        HttpMethod toMethod(std::string_view str) {
+            for (size_t i = 0; i < std::size(kMethodNames); i++) {
+                if (kMethodNames[i] == str) {
+                    return (HttpMethod) i;
+                }
+            }
+            return HttpMethod::INVALID;
+        }
+
+        std::string_view toReason(HttpStatus status) {
+            switch (status) {
+#define XX(code, name, desc) case HttpStatus::name: return #desc;
+                SYLAR_HTTP_STATUS_MAP(XX)
+#undef XX
+            }
+            return "Unknown";
+        }
+
+        bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); i++) {
+                if (toLower(a[i]) != toLower(b[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string_view HttpRequest::getHeader(std::string_view name) const {
+            for (size_t i = 0; i < m_header_count; i++) {
+                if (equalsIgnoreCase(m_headers[i].name, name)) {
+                    return m_headers[i].value;
+                }
+            }
+            return {};
+        }
+
+        void HttpRequestParser::reset() {
+            m_scanned = 0;
+            m_header_size = 0;
+            m_body_size = 0;
+            m_parsed_base = nullptr;
+        }
+
+        HttpRequestParser::Result HttpRequestParser::fail(HttpStatus status) {
+            m_error = status;
+            reset();
+            return Result::ERROR;
+        }
+
+        HttpRequestParser::Result HttpRequestParser::parse(std::string_view data, HttpRequest &request) {
+            if (m_header_size == 0) {
+                // 头部结尾可能跨越两次到达的数据, 往回多看 3 个字节
+                size_t start = m_scanned >= 3 ? m_scanned - 3 : 0;
+                size_t pos = data.find("\r\n\r\n", start);
+                if (pos == std::string_view::npos) {
+                    if (data.size() > m_max_header_size) {
+                        return fail(HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+                    }
+                    m_scanned = data.size();
+                    return Result::INCOMPLETE;
+                }
+                m_header_size = pos + 4;
+                if (m_header_size > m_max_header_size) {
+                    return fail(HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+                }
+                m_parsed_base = nullptr;
+            }
+            if (m_parsed_base != data.data()) {
+                if (parseHead(data.substr(0, m_header_size), request) == Result::ERROR) {
+                    return Result::ERROR;
+                }
+                m_parsed_base = data.data();
+            }
+            if (data.size() - m_header_size < m_body_size) {
+                return Result::INCOMPLETE;
+            }
+            request.m_body = data.substr(m_header_size, m_body_size);
+            m_consumed = m_header_size + m_body_size;
+            reset();
+            return Result::COMPLETE;
+        }
+
+        HttpRequestParser::Result HttpRequestParser::parseHead(std::string_view head, HttpRequest &request) {
+            // 请求行: 方法 SP 目标 SP 版本
+            size_t eol = head.find("\r\n");
+            std::string_view line = head.substr(0, eol);
+            size_t sp1 = line.find(' ');
+            if (sp1 == std::string_view::npos || sp1 == 0) {
+                return fail(HttpStatus::BAD_REQUEST);
+            }
+            size_t sp2 = line.find(' ', sp1 + 1);
+            if (sp2 == std::string_view::npos || sp2 == sp1 + 1) {
+                return fail(HttpStatus::BAD_REQUEST);
+            }
+            request.m_method_str = line.substr(0, sp1);
+            request.m_method = toMethod(request.m_method_str);
+            if (request.m_method == HttpMethod::INVALID) {
+                return fail(HttpStatus::NOT_IMPLEMENTED);
+            }
+
+            std::string_view version = line.substr(sp2 + 1);
+            if (version == "HTTP/1.1") {
+                request.m_version_minor = 1;
+            } else if (version == "HTTP/1.0") {
+                request.m_version_minor = 0;
+            } else {
+                return fail(version.substr(0, 5) == "HTTP/" ? HttpStatus::HTTP_VERSION_NOT_SUPPORTED
+                                                            : HttpStatus::BAD_REQUEST);
+            }
+            request.m_keep_alive = request.m_version_minor == 1;
+
+            std::string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+            request.m_target = target;
+            // 绝对形式 http://host/path 只保留路径部分
+            size_t scheme = target.find("://");
+            if (scheme != std::string_view::npos && target.front() != '/') {
+                size_t slash = target.find('/', scheme + 3);
+                target = slash == std::string_view::npos ? std::string_view("/") : target.substr(slash);
+            }
+            size_t question = target.find('?');
+            request.m_path = target.substr(0, question);
+            request.m_query = question == std::string_view::npos ? std::string_view() : target.substr(question + 1);
+            if (request.m_path.empty() || (request.m_path.front() != '/' && request.m_path != "*")) {
+                return fail(HttpStatus::BAD_REQUEST);
+            }
+
+            // 头部, 以空行结束
+            request.m_header_count = 0;
+            m_body_size = 0;
+            bool has_length = false;
+            size_t pos = eol + 2;
+            while (pos < head.size()) {
+                size_t end = head.find("\r\n", pos);
+                line = head.substr(pos, end - pos);
+                pos = end + 2;
+                if (line.empty()) {
+                    break;
+                }
+                size_t colon = line.find(':');
+                if (colon == std::string_view::npos || colon == 0 || line[colon - 1] == ' ' ||
+                    line[colon - 1] == '\t') {
+                    return fail(HttpStatus::BAD_REQUEST);
+                }
+                if (request.m_header_count == HttpRequest::kMaxHeaders) {
+                    return fail(HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+                }
+                std::string_view name = line.substr(0, colon);
+                std::string_view value = trim(line.substr(colon + 1));
+                request.m_headers[request.m_header_count++] = HttpHeader{name, value};
+
+                if (equalsIgnoreCase(name, "Content-Length")) {
+                    size_t length = 0;
+                    if (!parseSize(value, length) || (has_length && length != m_body_size)) {
+                        return fail(HttpStatus::BAD_REQUEST);
+                    }
+                    if (length > m_max_body_size) {
+                        return fail(HttpStatus::PAYLOAD_TOO_LARGE);
+                    }
+                    m_body_size = length;
+                    has_length = true;
+                } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                    return fail(HttpStatus::NOT_IMPLEMENTED);
+                } else if (equalsIgnoreCase(name, "Connection")) {
+                    // 逗号分隔的选项
+                    while (!value.empty()) {
+                        size_t comma = value.find(',');
+                        std::string_view token = trim(value.substr(0, comma));
+                        if (equalsIgnoreCase(token, "close")) {
+                            request.m_keep_alive = false;
+                        } else if (equalsIgnoreCase(token, "keep-alive")) {
+                            request.m_keep_alive = true;
+                        }
+                        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+                    }
+                }
+            }
+            request.m_body = {};
+            return Result::COMPLETE;
+        }
+
+        HttpResponse::~HttpResponse() {
+            if (m_file_fd >= 0) {
+                ::close(m_file_fd);
+            }
+        }
+
+        void HttpResponse::reset() {
+            m_status = HttpStatus::OK;
+            m_keep_alive = true;
+            m_headers.clear();
+            m_body.clear();
+            if (m_file_fd >= 0) {
+                ::close(m_file_fd);
+            }
+            m_file_fd = -1;
+            m_file_offset = 0;
+            m_file_length = 0;
+        }
+
+        void HttpResponse::addHeader(std::string_view name, std::string_view value) {
+            m_headers.append(name);
+            m_headers.append(": ");
+            m_headers.append(value);
+            m_headers.append("\r\n");
+        }
+
+        void HttpResponse::setFile(int fd, off_t offset, size_t length) {
+            if (m_file_fd >= 0 && m_file_fd != fd) {
+                ::close(m_file_fd);
+            }
+            m_file_fd = fd;
+            m_file_offset = offset;
+            m_file_length = length;
+            m_body.clear();
+        }
+
+        void HttpResponse::appendHead(ByteArray &out, int version_minor) const {
+            // 先在线程本地的缓冲里拼好, 再一次追加到块链
+            static thread_local std::string t_head;
+            std::string &head = t_head;
+            head.clear();
+            int code = (int) m_status;
+            head.append(version_minor == 0 ? "HTTP/1.0 " : "HTTP/1.1 ");
+            fmt::format_int code_str(code);
+            head.append(code_str.data(), code_str.size());
+            head.push_back(' ');
+            head.append(toReason(m_status));
+            head.append("\r\n");
+            head.append(dateHeader());
+            head.append("Server: sylar\r\n");
+            head.append(m_headers);
+            // 1xx, 204, 304 没有响应体
+            if (code >= 200 && code != 204 && code != 304) {
+                fmt::format_int length(getContentLength());
+                head.append("Content-Length: ");
+                head.append(length.data(), length.size());
+                head.append("\r\n");
+            }
+            if (!m_keep_alive) {
+                head.append("Connection: close\r\n");
+            } else if (version_minor == 0) {
+                head.append("Connection: keep-alive\r\n");
+            }
+            head.append("\r\n");
+            out.write(head.data(), head.size());
+        }
+
+    }
+}
@@ -0,0 +1,233 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_HTTP_H
+#define SYLAR_WEB_SERVER_HTTP_H
+
+#include <sys/types.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "bytearray.h"
+
+namespace sylar {
+    namespace http {
+
+#define SYLAR_HTTP_METHOD_MAP(XX) \
+        XX(GET) \
+        XX(HEAD) \
+        XX(POST) \
+        XX(PUT) \
+        XX(DELETE) \
+        XX(CONNECT) \
+        XX(OPTIONS) \
+        XX(TRACE) \
+        XX(PATCH)
+
+        enum class HttpMethod {
+#define XX(name) name,
+            SYLAR_HTTP_METHOD_MAP(XX)
+#undef XX
+            INVALID
+        };
+
+#define SYLAR_HTTP_STATUS_MAP(XX) \
+        XX(100, CONTINUE, Continue) \
+        XX(200, OK, OK) \
+        XX(201, CREATED, Created) \
+        XX(204, NO_CONTENT, No Content) \
+        XX(206, PARTIAL_CONTENT, Partial Content) \
+        XX(301, MOVED_PERMANENTLY, Moved Permanently) \
+        XX(302, FOUND, Found) \
+        XX(304, NOT_MODIFIED, Not Modified) \
+        XX(400, BAD_REQUEST, Bad Request) \
+        XX(401, UNAUTHORIZED, Unauthorized) \
+        XX(403, FORBIDDEN, Forbidden) \
+        XX(404, NOT_FOUND, Not Found) \
+        XX(405, METHOD_NOT_ALLOWED, Method Not Allowed) \
+        XX(408, REQUEST_TIMEOUT, Request Timeout) \
+        XX(413, PAYLOAD_TOO_LARGE, Payload Too Large) \
+        XX(414, URI_TOO_LONG, URI Too Long) \
+        XX(431, REQUEST_HEADER_FIELDS_TOO_LARGE, Request Header Fields Too Large) \
+        XX(500, INTERNAL_SERVER_ERROR, Internal Server Error) \
+        XX(501, NOT_IMPLEMENTED, Not Implemented) \
+        XX(503, SERVICE_UNAVAILABLE, Service Unavailable) \
+        XX(505, HTTP_VERSION_NOT_SUPPORTED, HTTP Version Not Supported)
+
+        enum class HttpStatus {
+#define XX(code, name, desc) name = code,
+            SYLAR_HTTP_STATUS_MAP(XX)
+#undef XX
+        };
+
+        // 返回的字符串是静态的, 可以长期引用
+        std::string_view toString(HttpMethod method);
+
+        HttpMethod toMethod(std::string_view str);
+
+        std::string_view toReason(HttpStatus status);
+
+        // 不区分大小写比较, 用于头部名字和 Connection 之类的取值
+        bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+        struct HttpHeader {
+            std::string_view name;
+            std::string_view value;
+        };
+
+// HTTP 请求, 所有字段都是指向接收缓冲的视图, 不拷贝
+// 视图在连接的接收缓冲被移动或覆盖前有效(处理下一个请求之前)
+        class HttpRequest {
+        public:
+            static constexpr size_t kMaxHeaders = 64;
+
+            HttpMethod getMethod() const { return m_method; }
+
+            // 请求行中的原始方法名
+            std::string_view getMethodString() const { return m_method_str; }
+
+            // 请求行中的原始目标, 包括查询串
+            std::string_view getTarget() const { return m_target; }
+
+            std::string_view getPath() const { return m_path; }
+
+            std::string_view getQuery() const { return m_query; }
+
+            // 1 表示 HTTP/1.1, 0 表示 HTTP/1.0
+            int getVersionMinor() const { return m_version_minor; }
+
+            bool isKeepAlive() const { return m_keep_alive; }
+
+            std::string_view getBody() const { return m_body; }
+
+            size_t getHeaderCount() const { return m_header_count; }
+
+            const HttpHeader &getHeader(size_t i) const { return m_headers[i]; }
+
+            // 名字不区分大小写, 不存在时返回空
+            std::string_view getHeader(std::string_view name) const;
+
+        private:
+            friend class HttpRequestParser;
+
+            HttpMethod m_method = HttpMethod::INVALID;
+            std::string_view m_method_str;
+            std::string_view m_target;
+            std::string_view m_path;
+            std::string_view m_query;
+            int m_version_minor = 1;
+            bool m_keep_alive = true;
+            std::string_view m_body;
+            size_t m_header_count = 0;
+            std::array<HttpHeader, kMaxHeaders> m_headers;
+        };
+
+// 增量式请求解析器, 不分配内存
+// 每次传入接收缓冲中还没有消费的全部数据; 请求不完整时记住已经扫描过的位置, 下次只扫描新到达的部分.
+// 解析完一个请求后 getConsumed() 为它占用的字节数, 调用者消费掉这些字节后继续解析下一个(流水线请求).
+// 不支持请求体的分块传输编码(返回 501).
+        class HttpRequestParser {
+        public:
+            enum class Result {
+                COMPLETE,
+                INCOMPLETE,
+                ERROR
+            };
+
+            explicit HttpRequestParser(size_t max_header_size = 8 * 1024, size_t max_body_size = 1024 * 1024)
+                    : m_max_header_size(max_header_size), m_max_body_size(max_body_size) {}
+
+            // data 为接收缓冲中未消费的数据, 每次都从请求开头传入
+            Result parse(std::string_view data, HttpRequest &request);
+
+            // COMPLETE 之后有效, 请求(头部加请求体)的字节数
+            size_t getConsumed() const { return m_consumed; }
+
+            // ERROR 之后有效, 应该回复给客户端的状态码
+            HttpStatus getError() const { return m_error; }
+
+            // 开始解析一个新请求, COMPLETE 之后自动调用
+            void reset();
+
+        private:
+            Result parseHead(std::string_view head, HttpRequest &request);
+
+            Result fail(HttpStatus status);
+
+        private:
+            size_t m_max_header_size;
+            size_t m_max_body_size;
+            size_t m_scanned = 0;           //已经确认不包含头部结尾的字节数
+            size_t m_header_size = 0;       //头部(含空行)字节数, 0 表示还没有找到头部结尾
+            size_t m_body_size = 0;
+            const char *m_parsed_base = nullptr;    //上次解析头部时缓冲的起始地址, 缓冲移动后需要重新解析
+            size_t m_consumed = 0;
+            HttpStatus m_error = HttpStatus::BAD_REQUEST;
+        };
+
+// HTTP 响应
+// 头部直接拼接成文本, 连接复用同一个对象, 稳定状态下不分配内存.
+// 响应体可以是内存中的数据, 也可以是文件的一段(由服务器用 sendfile 发送)
+        class HttpResponse {
+        public:
+            HttpResponse() = default;
+
+            HttpResponse(const HttpResponse &) = delete;
+
+            HttpResponse &operator=(const HttpResponse &) = delete;
+
+            ~HttpResponse();
+
+            // 准备下一个响应, 会关闭还没有发送的文件
+            void reset();
+
+            HttpStatus getStatus() const { return m_status; }
+
+            void setStatus(HttpStatus status) { m_status = status; }
+
+            // Content-Length 和 Connection 由服务器填写, 不要手动添加
+            void addHeader(std::string_view name, std::string_view value);
+
+            void setBody(std::string_view body) { m_body.assign(body); }
+
+            void appendBody(std::string_view body) { m_body.append(body); }
+
+            std::string_view getBody() const { return m_body; }
+
+            // 用文件 fd 的 [offset, offset + length) 作为响应体, fd 由响应负责关闭
+            void setFile(int fd, off_t offset, size_t length);
+
+            bool hasFile() const { return m_file_fd >= 0; }
+
+            int getFileFd() const { return m_file_fd; }
+
+            off_t getFileOffset() const { return m_file_offset; }
+
+            size_t getFileLength() const { return m_file_length; }
+
+            // 响应体字节数
+            size_t getContentLength() const { return hasFile() ? m_file_length : m_body.size(); }
+
+            bool isKeepAlive() const { return m_keep_alive; }
+
+            void setKeepAlive(bool v) { m_keep_alive = v; }
+
+            // 把状态行和头部追加到 out
+            void appendHead(ByteArray &out, int version_minor) const;
+
+        private:
+            HttpStatus m_status = HttpStatus::OK;
+            bool m_keep_alive = true;
+            std::string m_headers;
+            std::string m_body;
+            int m_file_fd = -1;
+            off_t m_file_offset = 0;
+            size_t m_file_length = 0;
+        };
+
+    }
+}
+
+#endif //SYLAR_WEB_SERVER_HTTP_H
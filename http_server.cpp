@@ -0,0 +1,290 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "http_server.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "fd_manager.h"
+#include "hook.h"
+
+namespace sylar {
+    namespace http {
+
+        namespace {
+            constexpr size_t kInitialBufferSize = 16 * 1024;
+            constexpr size_t kOutputFlushSize = 64 * 1024;     //流水线响应累积到这么多先写出一次
+
+            uint64_t nowUs() {
+                return std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            // 把 out 全部写出并清空; fd 是 hook 管理的 socket, 写不动时挂起协程
+            bool writeAll(int fd, ByteArray &out, int flags) {
+                while (!out.empty()) {
+                    ssize_t n = out.writeTo(fd, flags | MSG_NOSIGNAL);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+
+        HttpServer::HttpServer(IOManager *iom, ServletDispatch::ptr dispatch)
+                : m_iom(iom), m_dispatch(dispatch ? std::move(dispatch) : std::make_shared<ServletDispatch>()) {
+            if (!m_iom) {
+                throw std::invalid_argument("http server needs an IOManager");
+            }
+        }
+
+        HttpServer::~HttpServer() {
+            stop();
+            for (int fd: m_listen_fds) {
+                ::close(fd);
+            }
+        }
+
+        bool HttpServer::bind(const std::string &ip, uint16_t port) {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1) {
+                SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "http server invalid address {}", ip);
+                return false;
+            }
+            size_t n = m_iom->getThreadCount();
+            size_t bound = 0;
+            for (size_t i = 0; i < n; i++) {
+                int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (fd < 0) {
+                    break;
+                }
+                int on = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+                if (n > 1 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0 && i > 0) {
+                    ::close(fd);
+                    break;
+                }
+                if (::bind(fd, (const sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+                    if (i == 0) {
+                        SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "http server bind {}:{} failed: {}",
+                                        ip, port, strerror(errno));
+                    }
+                    ::close(fd);
+                    break;
+                }
+                if (i == 0 && port == 0) {
+                    // 系统分配的端口, 其余监听 socket 绑定到同一个端口
+                    socklen_t len = sizeof(addr);
+                    getsockname(fd, (sockaddr *) &addr, &len);
+                    port = ntohs(addr.sin_port);
+                }
+                m_listen_fds.push_back(fd);
+                bound++;
+            }
+            if (bound == 0) {
+                return false;
+            }
+            m_port = port;
+            return true;
+        }
+
+        void HttpServer::start() {
+            m_stopping = false;
+            size_t threads = m_iom->getThreadCount();
+            for (size_t i = 0; i < m_listen_fds.size(); i++) {
+                int fd = m_listen_fds[i];
+                m_acceptors.fetch_add(1, std::memory_order_relaxed);
+                m_iom->schedule([this, fd]() { acceptLoop(fd); }, (int) (i % threads));
+            }
+        }
+
+        void HttpServer::stop() {
+            if (m_stopping.exchange(true)) {
+                return;
+            }
+            // 监听 socket shutdown 后 accept 返回 EINVAL, 连接 shutdown 后 read 返回 0
+            for (int fd: m_listen_fds) {
+                shutdown(fd, SHUT_RDWR);
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (int fd: m_clients) {
+                    shutdown(fd, SHUT_RDWR);
+                }
+            }
+            for (;;) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_clients.empty() && m_acceptors.load(std::memory_order_acquire) == 0) {
+                        break;
+                    }
+                }
+                // 在工作线程中调用时 hook 只挂起协程
+                usleep(1000);
+            }
+        }
+
+        void HttpServer::acceptLoop(int listen_fd) {
+            // 监听 socket 不是在工作线程上创建的, 交给 hook 管理
+            FdManager::getInstance().get(listen_fd, true);
+            while (!m_stopping.load(std::memory_order_relaxed)) {
+                int fd = ::accept(listen_fd, nullptr, nullptr);
+                if (fd < 0) {
+                    if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                        usleep(10 * 1000);
+                    }
+                    continue;
+                }
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_stopping.load(std::memory_order_relaxed)) {
+                        ::close(fd);
+                        break;
+                    }
+                    m_clients.insert(fd);
+                }
+                m_iom->schedule([this, fd]() { handleClient(fd); });
+            }
+            m_acceptors.fetch_sub(1, std::memory_order_release);
+        }
+
+        void HttpServer::handleClient(int fd) {
+            if (m_recv_timeout != UINT64_MAX) {
+                timeval tv{(time_t) (m_recv_timeout / 1000), (suseconds_t) (m_recv_timeout % 1000 * 1000)};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            }
+            HttpRequestParser parser(m_max_header_size, m_max_body_size);
+            HttpRequest request;
+            HttpResponse response;
+            std::vector<char> buf(kInitialBufferSize);
+            size_t begin = 0, end = 0;      //buf 中未消费的数据
+            ByteArray out;
+
+            bool alive = true;
+            while (alive) {
+                if (end == buf.size()) {
+                    if (begin > 0) {
+                        memmove(buf.data(), buf.data() + begin, end - begin);
+                        end -= begin;
+                        begin = 0;
+                    } else {
+                        // 一个请求放不下, 解析器保证不会超过头部和请求体的上限
+                        buf.resize(buf.size() * 2);
+                    }
+                }
+                ssize_t n = ::read(fd, buf.data() + end, buf.size() - end);
+                if (n <= 0) {
+                    break;
+                }
+                end += n;
+
+                while (alive && begin < end) {
+                    auto result = parser.parse(std::string_view(buf.data() + begin, end - begin), request);
+                    if (result == HttpRequestParser::Result::INCOMPLETE) {
+                        break;
+                    }
+                    uint64_t start = nowUs();
+                    response.reset();
+                    if (result == HttpRequestParser::Result::ERROR) {
+                        response.setStatus(parser.getError());
+                        response.setKeepAlive(false);
+                        response.addHeader("Content-Type", "text/plain; charset=utf-8");
+                        response.setBody(toReason(parser.getError()));
+                        response.appendHead(out, 1);
+                        out.write(response.getBody());
+                        logAccess("-", "-", response.getStatus(), nowUs() - start);
+                        alive = false;
+                        break;
+                    }
+
+                    response.setKeepAlive(request.isKeepAlive());
+                    try {
+                        m_dispatch->handle(request, response);
+                    } catch (std::exception &e) {
+                        SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "http servlet {} {} failed: {}",
+                                        request.getMethodString(), request.getPath(), e.what());
+                        response.reset();
+                        response.setStatus(HttpStatus::INTERNAL_SERVER_ERROR);
+                        response.setKeepAlive(false);
+                    }
+                    if (m_stopping.load(std::memory_order_relaxed)) {
+                        response.setKeepAlive(false);
+                    }
+                    alive = response.isKeepAlive();
+                    if (!serve(fd, request, response, out)) {
+                        alive = false;
+                        out.clear();
+                    }
+                    logAccess(toString(request.getMethod()), request.getPath(), response.getStatus(),
+                              nowUs() - start);
+                    begin += parser.getConsumed();
+                }
+                if (begin == end) {
+                    begin = end = 0;
+                }
+                if (!writeAll(fd, out, 0)) {
+                    break;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_clients.erase(fd);
+            ::close(fd);
+        }
+
+        bool HttpServer::serve(int fd, const HttpRequest &request, HttpResponse &response, ByteArray &out) {
+            response.appendHead(out, request.getVersionMinor());
+            if (request.getMethod() == HttpMethod::HEAD) {
+                return true;
+            }
+            if (!response.hasFile()) {
+                out.write(response.getBody());
+                if (out.size() >= kOutputFlushSize) {
+                    return writeAll(fd, out, 0);
+                }
+                return true;
+            }
+
+            // 头部带 MSG_MORE, 和文件的第一段合并成满的 TCP 段
+            if (!writeAll(fd, out, MSG_MORE)) {
+                return false;
+            }
+            off_t offset = response.getFileOffset();
+            size_t left = response.getFileLength();
+            while (left > 0) {
+                ssize_t n = ::sendfile(fd, response.getFileFd(), &offset, left);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                left -= n;
+            }
+            return true;
+        }
+
+        void HttpServer::logAccess(std::string_view method, std::string_view path, HttpStatus status,
+                                   uint64_t latency_us) {
+            if (!m_access_logger || !m_access_logger->isEnabled(LogLevel::Level::INFO)) {
+                return;
+            }
+            LogEvent::ptr event = m_access_logger->captureEvent(std::source_location::current());
+            event->setHttpAccess(method, path, (uint32_t) status, latency_us);
+            event->format("{} {} {} {}us", method, path, (int) status, latency_us);
+            m_access_logger->log(LogLevel::Level::INFO, std::move(event));
+        }
+
+    }
+}
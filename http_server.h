@@ -0,0 +1,89 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_HTTP_SERVER_H
+#define SYLAR_WEB_SERVER_HTTP_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "bytearray.h"
+#include "http.h"
+#include "iomanager.h"
+#include "log.h"
+#include "servlet.h"
+
+namespace sylar {
+    namespace http {
+
+// HTTP/1.1 服务器, 运行在 IOManager 上, 每个连接一个协程, 阻塞式的读写经过 hook 挂起协程
+// 每个工作线程有自己的 SO_REUSEPORT 监听 socket 和 accept 协程, 由内核分配连接, 不争抢同一个监听 socket.
+// 连接上一次读到的所有完整请求(流水线)处理完后, 响应在 ByteArray 块链中合并成一次 writev; 文件响应体用 sendfile 直接从页缓存发送.
+        class HttpServer {
+        public:
+            typedef std::shared_ptr<HttpServer> ptr;
+
+            explicit HttpServer(IOManager *iom, ServletDispatch::ptr dispatch = nullptr);
+
+            HttpServer(const HttpServer &) = delete;
+
+            HttpServer &operator=(const HttpServer &) = delete;
+
+            ~HttpServer();
+
+            // 监听 ip:port, port 为 0 时由系统分配(之后用 getPort() 查询); 必须在 start() 之前调用
+            bool bind(const std::string &ip, uint16_t port);
+
+            uint16_t getPort() const { return m_port; }
+
+            void start();
+
+            // 停止接受新连接并关闭现有连接, 等所有连接协程退出后返回
+            void stop();
+
+            ServletDispatch::ptr getDispatch() const { return m_dispatch; }
+
+            // 访问日志以 INFO 级别写到这个 logger, 格式中用 %M %U %S %D 输出方法, 路径, 状态码和耗时; 为空时不记录
+            void setAccessLogger(Logger::ptr logger) { m_access_logger = std::move(logger); }
+
+            // 连接空闲多久没有收到请求就关闭, 毫秒
+            void setRecvTimeout(uint64_t ms) { m_recv_timeout = ms; }
+
+            void setMaxHeaderSize(size_t size) { m_max_header_size = size; }
+
+            void setMaxBodySize(size_t size) { m_max_body_size = size; }
+
+        private:
+            void acceptLoop(int listen_fd);
+
+            void handleClient(int fd);
+
+            // 处理一个已经解析完的请求, 响应追加到 out; 文件响应体会先把 out 写出再 sendfile. 写失败时返回 false
+            bool serve(int fd, const HttpRequest &request, HttpResponse &response, ByteArray &out);
+
+            void logAccess(std::string_view method, std::string_view path, HttpStatus status, uint64_t latency_us);
+
+        private:
+            IOManager *m_iom;
+            ServletDispatch::ptr m_dispatch;
+            Logger::ptr m_access_logger;
+            uint64_t m_recv_timeout = 60 * 1000;
+            size_t m_max_header_size = 8 * 1024;
+            size_t m_max_body_size = 1024 * 1024;
+            uint16_t m_port = 0;
+            std::vector<int> m_listen_fds;
+            std::atomic<bool> m_stopping{false};
+            std::atomic<size_t> m_acceptors{0};     //还在运行的 accept 协程
+            std::mutex m_mutex;
+            std::unordered_set<int> m_clients;      //打开的连接, 由 m_mutex 保护, 协程关闭 fd 之前先移除
+        };
+
+    }
+}
+
+#endif //SYLAR_WEB_SERVER_HTTP_SERVER_H
@@ -0,0 +1,284 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "iomanager.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "fd_manager.h"
+#include "hook.h"
+#include "log.h"
+
+namespace sylar {
+
+    namespace {
+        constexpr int kMaxEvents = 256;
+        constexpr uint64_t kMaxIdleMs = 3000;
+    }
+
+    IOManager::IOManager(size_t threads, const std::string &name) : Scheduler(threads, name) {
+        for (size_t i = 0; i < threads; i++) {
+            int epfd = epoll_create1(EPOLL_CLOEXEC);
+            int evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (epfd < 0 || evfd < 0) {
+                throw std::runtime_error(std::string("iomanager init failed: ") + strerror(errno));
+            }
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLET;
+            event.data.ptr = nullptr;       //空指针表示唤醒用的 eventfd
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &event) != 0) {
+                throw std::runtime_error(std::string("iomanager init failed: ") + strerror(errno));
+            }
+            m_epfds.push_back(epfd);
+            m_eventfds.push_back(evfd);
+        }
+        m_fd_contexts.resize(64);
+        start();
+    }
+
+    IOManager::~IOManager() {
+        // 必须在派生类析构前停止, 基类析构时 idle/tickle 已经不是 IOManager 的版本
+        stop();
+        FdManager::getInstance().forgetIOManager(this);
+        for (size_t i = 0; i < m_epfds.size(); i++) {
+            close(m_epfds[i]);
+            close(m_eventfds[i]);
+        }
+        for (auto ctx: m_fd_contexts) {
+            delete ctx;
+        }
+    }
+
+    IOManager *IOManager::getThis() {
+        return dynamic_cast<IOManager *>(Scheduler::getThis());
+    }
+
+    IOManager::FdContext *IOManager::getFdContext(int fd, bool create) {
+        if (fd < 0) {
+            return nullptr;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(m_fd_mutex);
+            if ((size_t) fd < m_fd_contexts.size() && m_fd_contexts[fd]) {
+                return m_fd_contexts[fd];
+            }
+            if (!create) {
+                return nullptr;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(m_fd_mutex);
+        if ((size_t) fd >= m_fd_contexts.size()) {
+            m_fd_contexts.resize(std::max((size_t) fd + 1, m_fd_contexts.size() * 3 / 2));
+        }
+        if (!m_fd_contexts[fd]) {
+            m_fd_contexts[fd] = new FdContext;
+            m_fd_contexts[fd]->fd = fd;
+        }
+        return m_fd_contexts[fd];
+    }
+
+    int IOManager::addEvent(int fd, Event event, std::function<void()> cb) {
+        if (event != READ && event != WRITE) {
+            throw std::invalid_argument("addEvent accepts a single READ or WRITE event");
+        }
+        FdContext *ctx = getFdContext(fd, true);
+        if (!ctx) {
+            return -1;
+        }
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        if (ctx->waiting & event) {
+            SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "addEvent fd={} event={} already has a waiter",
+                            fd, (int) event);
+            return -1;
+        }
+        if (ctx->owner < 0) {
+            int worker = Scheduler::getThis() == this ? Scheduler::getWorkerIndex() : fd % (int) m_epfds.size();
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = ctx;
+            if (epoll_ctl(m_epfds[worker], EPOLL_CTL_ADD, fd, &ev) != 0) {
+                SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "epoll_ctl add fd={} failed: {}", fd,
+                                strerror(errno));
+                return -1;
+            }
+            ctx->owner = worker;
+            ctx->ready = NONE;
+        }
+
+        auto &ec = ctx->getContext(event);
+        if (cb) {
+            ec.cb = std::move(cb);
+        } else {
+            Fiber *fiber = Fiber::getThis();
+            if (!fiber) {
+                throw std::invalid_argument("addEvent without callback must be called inside a fiber");
+            }
+            ec.fiber = fiber->shared_from_this();
+        }
+        ec.thread = Scheduler::getThis() == this ? Scheduler::getWorkerIndex() : -1;
+        ctx->waiting |= event;
+        m_pending_events.fetch_add(1, std::memory_order_relaxed);
+        if (ctx->ready & event) {
+            // 之前到达的边缘
+            ctx->ready &= ~event;
+            trigger(ctx, event);
+        }
+        return 0;
+    }
+
+    void IOManager::trigger(FdContext *ctx, Event event) {
+        ctx->waiting &= ~event;
+        auto &ec = ctx->getContext(event);
+        if (ec.cb) {
+            schedule(std::move(ec.cb), ec.thread);
+            ec.cb = nullptr;
+        } else {
+            schedule(std::move(ec.fiber), ec.thread);
+            ec.fiber = nullptr;
+        }
+        ec.thread = -1;
+        if (m_pending_events.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            wakeAllIfStopping();
+        }
+    }
+
+    bool IOManager::delEvent(int fd, Event event) {
+        FdContext *ctx = getFdContext(fd, false);
+        if (!ctx) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        if (!(ctx->waiting & event)) {
+            return false;
+        }
+        ctx->waiting &= ~event;
+        auto &ec = ctx->getContext(event);
+        ec.cb = nullptr;
+        ec.fiber = nullptr;
+        ec.thread = -1;
+        if (m_pending_events.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            wakeAllIfStopping();
+        }
+        return true;
+    }
+
+    bool IOManager::cancelEvent(int fd, Event event) {
+        FdContext *ctx = getFdContext(fd, false);
+        if (!ctx) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        if (!(ctx->waiting & event)) {
+            return false;
+        }
+        trigger(ctx, event);
+        return true;
+    }
+
+    bool IOManager::cancelAll(int fd) {
+        FdContext *ctx = getFdContext(fd, false);
+        if (!ctx) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        if (ctx->owner >= 0) {
+            epoll_ctl(m_epfds[ctx->owner], EPOLL_CTL_DEL, fd, nullptr);
+            ctx->owner = -1;
+        }
+        ctx->ready = NONE;
+        bool had = ctx->waiting != NONE;
+        if (ctx->waiting & READ) {
+            trigger(ctx, READ);
+        }
+        if (ctx->waiting & WRITE) {
+            trigger(ctx, WRITE);
+        }
+        return had;
+    }
+
+    void IOManager::tickle(size_t worker) {
+        uint64_t one = 1;
+        ssize_t rt = write(m_eventfds[worker], &one, sizeof(one));
+        (void) rt;
+    }
+
+    void IOManager::wakeAllIfStopping() {
+        if (isStopRequested()) {
+            for (size_t i = 0; i < m_eventfds.size(); i++) {
+                tickle(i);
+            }
+        }
+    }
+
+    void IOManager::onWorkerStart(size_t worker) {
+        setHookEnable(true);
+    }
+
+    void IOManager::onTimerInsertedAtFront() {
+        wakeOne(Scheduler::getThis() == this ? (size_t) Scheduler::getWorkerIndex() : (size_t) -1);
+    }
+
+    bool IOManager::stopping() {
+        return Scheduler::stopping() && m_pending_events.load(std::memory_order_acquire) == 0 && !hasTimer();
+    }
+
+    void IOManager::idle(size_t worker) {
+        uint64_t next = getNextTimeout();
+        processEvents(worker, (int) std::min(next, kMaxIdleMs));
+    }
+
+    void IOManager::poll(size_t worker) {
+        processEvents(worker, 0);
+    }
+
+    void IOManager::processEvents(size_t worker, int timeout) {
+        epoll_event events[kMaxEvents];
+        int n;
+        do {
+            n = epoll_wait(m_epfds[worker], events, kMaxEvents, timeout);
+        } while (n < 0 && errno == EINTR);
+
+        for (int i = 0; i < n; i++) {
+            epoll_event &ev = events[i];
+            if (!ev.data.ptr) {
+                uint64_t value;
+                while (read(m_eventfds[worker], &value, sizeof(value)) > 0) {
+                }
+                continue;
+            }
+            auto *ctx = static_cast<FdContext *>(ev.data.ptr);
+            uint32_t fired = NONE;
+            if (ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                fired |= READ;
+            }
+            if (ev.events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                fired |= WRITE;
+            }
+            std::lock_guard<std::mutex> lock(ctx->mutex);
+            for (Event event: {READ, WRITE}) {
+                if (!(fired & event)) {
+                    continue;
+                }
+                if (ctx->waiting & event) {
+                    trigger(ctx, event);
+                } else {
+                    ctx->ready |= event;
+                }
+            }
+        }
+
+        std::vector<std::function<void()>> cbs;
+        listExpiredCb(cbs);
+        for (auto &cb: cbs) {
+            schedule(std::move(cb));
+        }
+        if (!cbs.empty() && !hasTimer()) {
+            wakeAllIfStopping();
+        }
+    }
+
+}
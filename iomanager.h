@@ -0,0 +1,106 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_IOMANAGER_H
+#define SYLAR_WEB_SERVER_IOMANAGER_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "scheduler.h"
+#include "timer.h"
+
+namespace sylar {
+
+// IO 协程调度器
+// 每个工作线程有自己的 epoll 和用于唤醒的 eventfd, 空闲时阻塞在 epoll_wait 上, 超时时间由时间轮决定.
+// 文件描述符第一次等待事件时以边缘触发方式注册到当前工作线程的 epoll(不是工作线程时按 fd 分配), 之后不再 epoll_ctl;
+// 没有等待者时到达的边缘记录下来, 下一次 addEvent 直接就绪, 不会丢失.
+// 等待事件的协程总是回到挂起它的工作线程上恢复, 协程里编译器缓存的线程本地变量地址(比如 errno)在挂起前后保持有效.
+    class IOManager : public Scheduler, public TimerManager {
+    public:
+        typedef std::shared_ptr<IOManager> ptr;
+
+        enum Event {
+            NONE = 0x0,
+            READ = 0x1,
+            WRITE = 0x4,
+        };
+
+        explicit IOManager(size_t threads = 1, const std::string &name = "io");
+
+        ~IOManager() override;
+
+        // 等待 fd 上的事件, 事件就绪时执行 cb; cb 为空时在协程中调用, 就绪时恢复当前协程(调用者随后应 yield)
+        // 在工作线程上调用时 cb 或协程回到这个工作线程执行
+        // 同一个 fd 的同一种事件同时只能有一个等待者, 成功返回 0, 失败返回 -1
+        int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+
+        // 取消等待, 不触发; 没有等待者时返回 false
+        bool delEvent(int fd, Event event);
+
+        // 取消等待并触发, 等待者醒来后重新检查 fd 的状态
+        bool cancelEvent(int fd, Event event);
+
+        // 触发 fd 上所有的等待者并从 epoll 中移除, 关闭 fd 之前调用
+        bool cancelAll(int fd);
+
+        static IOManager *getThis();
+
+    protected:
+        void tickle(size_t worker) override;
+
+        void idle(size_t worker) override;
+
+        void poll(size_t worker) override;
+
+        bool stopping() override;
+
+        void onTimerInsertedAtFront() override;
+
+        // 工作线程开启 hook
+        void onWorkerStart(size_t worker) override;
+
+    private:
+        struct FdContext {
+            struct EventContext {
+                Fiber::ptr fiber;
+                std::function<void()> cb;
+                int thread = -1;        //执行 cb 或恢复 fiber 的工作线程
+            };
+
+            std::mutex mutex;
+            int fd = 0;
+            int owner = -1;             //注册到哪个工作线程的 epoll, -1 表示还没有注册
+            uint32_t waiting = NONE;    //有等待者的事件
+            uint32_t ready = NONE;      //已经到达但还没有等待者的事件
+            EventContext read;
+            EventContext write;
+
+            EventContext &getContext(Event event) { return event == READ ? read : write; }
+        };
+
+        FdContext *getFdContext(int fd, bool create);
+
+        // 需要持有 ctx->mutex
+        void trigger(FdContext *ctx, Event event);
+
+        void wakeAllIfStopping();
+
+        // 等待最多 timeout 毫秒, 调度就绪 fd 上的等待者和到期的定时器
+        void processEvents(size_t worker, int timeout);
+
+    private:
+        std::vector<int> m_epfds;
+        std::vector<int> m_eventfds;
+        std::shared_mutex m_fd_mutex;
+        std::vector<FdContext *> m_fd_contexts;     //下标为 fd, 对象不会释放, 地址可以放进 epoll_event
+        std::atomic<size_t> m_pending_events{0};
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_IOMANAGER_H
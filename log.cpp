@@ -3,17 +3,316 @@
 //
 
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "log.h"
+#include "log_binary.h"
+#include "log_structured.h"
 
 
 namespace sylar {
+    namespace {
+        uint64_t coarseNowUs() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+            return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+        }
+
+        // 不经过 SYLAR_LOG_* 宏的事件(直接调用 Logger::log 或 SYLAR_LOG_BIN)按文件名和行号找调用点状态
+        // 开放寻址的无锁表, 只增不删; 冲突太多找不到位置时不限流
+        class LogSiteTable {
+        public:
+            static LogSiteTable &getInstance() {
+                static LogSiteTable instance;
+                return instance;
+            }
+
+            LogSiteLimiter *find(std::string_view file_name, int32_t line) {
+                uint64_t key = std::hash<std::string_view>()(file_name) * 31 + (uint32_t) line;
+                if (key == 0) {
+                    key = 1;
+                }
+                for (size_t i = 0; i < kMaxProbe; i++) {
+                    Entry &entry = m_entries[(key + i) & (kSize - 1)];
+                    uint64_t current = entry.key.load(std::memory_order_acquire);
+                    if (current == 0 && entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                        return &entry.limiter;
+                    }
+                    if (current == key) {
+                        return &entry.limiter;
+                    }
+                }
+                return nullptr;
+            }
+
+        private:
+            static constexpr size_t kSize = 1024;
+            static constexpr size_t kMaxProbe = 16;
+
+            struct Entry {
+                std::atomic<uint64_t> key{0};
+                LogSiteLimiter limiter;
+            };
+
+            Entry m_entries[kSize];
+        };
+    }
+
+    bool LogSiteLimiter::admit(const LogRateLimit &limit, uint64_t &suppressed) {
+        if (limit.sample_every > 1 && m_count.fetch_add(1, std::memory_order_relaxed) % limit.sample_every != 0) {
+            return false;
+        }
+        uint64_t now_us = coarseNowUs();
+        if (limit.coalesce_ms) {
+            // 窗口结束后第一个抢到 CAS 的线程放行
+            uint64_t now_ms = now_us / 1000;
+            uint64_t next = m_next_pass_ms.load(std::memory_order_relaxed);
+            if (now_ms < next ||
+                !m_next_pass_ms.compare_exchange_strong(next, now_ms + limit.coalesce_ms, std::memory_order_relaxed)) {
+                m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        if (limit.rate_per_sec) {
+            // GCRA: 每条事件把理论到达时间推后一个间隔, 超前当前时间不超过 burst - 1 个间隔时放行
+            uint64_t interval = std::max<uint64_t>(1000000 / limit.rate_per_sec, 1);
+            uint64_t burst = limit.burst ? limit.burst : limit.rate_per_sec;
+            uint64_t tolerance = interval * (burst - 1);
+            uint64_t tat = m_tat_us.load(std::memory_order_relaxed);
+            for (;;) {
+                uint64_t base = std::max(tat, now_us);
+                if (base - now_us > tolerance) {
+                    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (m_tat_us.compare_exchange_weak(tat, base + interval, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+        }
+        // 没有丢弃时只读不写, 避免放行的热路径上争抢缓存行
+        suppressed = m_suppressed.load(std::memory_order_relaxed) ? m_suppressed.exchange(0, std::memory_order_relaxed)
+                                                                 : 0;
+        return true;
+    }
+
+    std::atomic<uint64_t> Logger::s_generation{1};
+
     void Logger::log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) {
-        if (level < m_level)
+        if (level < getEffectiveLevel()) {
+            countFiltered();
+            // 与 SYLAR_LOG_* 宏一致, 被过滤掉的事件也进飞行记录
+            if (FlightRecorder::isEnabled()) {
+                FlightRecorder::record((int) level, event->getFileName(), (uint32_t) event->getLine(), m_name,
+                                       event->getContent(), event->getTime() * 1000000 + event->getTimeUsec());
+            }
+            return;
+        }
+        if (isLimited(level) &&
+            !admit(level, LogSiteTable::getInstance().find(event->getFileName(), event->getLine()),
+                   event->getFileName(), event->getLine())) {
+            return;
+        }
+        dispatch(level, std::move(event));
+    }
+
+    void Logger::logFields(LogLevel::Level level, const std::source_location &location, LogSiteLimiter &site,
+                           std::string_view message, std::initializer_list<LogField> fields) {
+        if (isLimited(level) && !admit(level, &site, location.file_name(), (int32_t) location.line())) {
             return;
+        }
+        LogEvent::ptr event = captureEvent(location);
+        event->setContent(message);
+        event->addFields(fields);
+        dispatch(level, std::move(event));
+    }
+
+    bool Logger::admit(LogLevel::Level level, LogSiteLimiter *site, std::string_view file_name, int32_t line) {
+        uint64_t suppressed = 0;
+        if (site && !site->admit(getRateLimit(), suppressed)) {
+            m_counters.add(RATE_LIMITED);
+            return false;
+        }
+        if (suppressed) {
+            LogEvent::ptr event = captureEvent(std::source_location::current());
+            event->setFileName(std::string(file_name));
+            event->setLine(line);
+            event->format("last message repeated {} times", suppressed);
+            dispatch(level, std::move(event));
+        }
+        return true;
+    }
+
+    namespace {
+        // 多个 appender 共用同一个格式对象时, 每条事件按格式对象只格式化一次, 组内的 appender 写同一份文本
+        void fanOut(const Logger::ptr &logger, LogLevel::Level level, const LogEvent::ptr &event,
+                    const Logger::AppenderList &appenders) {
+            // 不同的格式超过这个数时, 多出来的 appender 各自格式化
+            constexpr size_t kMaxGroups = 4;
+            struct Group {
+                LogFormatter *formatter = nullptr;
+                AtomicSharedPtr<LogFormatter>::Snapshot hold;   //本次分发期间保持格式对象存活
+                fmt::memory_buffer buf;
+                LogAppender::Formatted formatted;
+            };
+            Group groups[kMaxGroups];
+            size_t group_count = 0;
+            for (auto &appender: appenders) {
+                if (!appender->canLogFormatted()) {
+                    appender->log(logger, level, event);
+                    continue;
+                }
+                if (level < appender->getLevel()) {
+                    continue;
+                }
+                auto formatter = appender->readFormatter();
+                Group *group = nullptr;
+                for (size_t i = 0; i < group_count; i++) {
+                    if (groups[i].formatter == formatter.get()) {
+                        group = &groups[i];
+                        break;
+                    }
+                }
+                if (!group) {
+                    if (!formatter || group_count == kMaxGroups) {
+                        appender->log(logger, level, event);
+                        continue;
+                    }
+                    group = &groups[group_count++];
+                    group->formatter = formatter.get();
+                    group->hold = std::move(formatter);
+                    uint64_t begin = metrics::sampleTiming() ? metrics::nowNs() : 0;
+                    group->formatter->format(group->buf, logger, level, event);
+                    group->formatted.text = std::string_view(group->buf.data(), group->buf.size());
+                    group->formatted.format_ns = begin ? metrics::nowNs() - begin : 0;
+                }
+                appender->logFormatted(logger, level, event, group->formatted);
+            }
+        }
+    }
+
+    void Logger::dispatch(LogLevel::Level level, LogEvent::ptr event) {
+        // 先写飞行记录, appender 中崩溃时也能在转储里看到这条事件
+        if (FlightRecorder::isEnabled()) {
+            FlightRecorder::record((int) level, event->getFileName(), (uint32_t) event->getLine(), m_name,
+                                   event->getContent(), event->getTime() * 1000000 + event->getTimeUsec());
+        }
+        m_counters.add(std::min<size_t>((size_t) level, 5) - 1);
         auto self = shared_from_this();
-        for (auto &item: m_appenders) {
-            item->log(self, level, event);
+        // 快照版本没变且 appender 配置的代数也没变时不加锁
+        auto cache = m_effective_appenders.read();
+        if (!cache || cache->generation != s_generation.load(std::memory_order_acquire)) {
+            cache = AtomicSharedPtr<const AppenderCache>::Snapshot(getEffectiveAppenders());
+        }
+        if (cache->appenders.size() == 1) {
+            cache->appenders[0]->log(self, level, event);
+        } else {
+            fanOut(self, level, event, cache->appenders);
+        }
+        if (level == LogLevel::Level::FATAL && FlightRecorder::isEnabled()) {
+            FlightRecorder::dump("FATAL");
+        }
+    }
+
+    LogLevel::Level Logger::refreshEffectiveLevel() const {
+        // 先取版本号: 计算期间配置又被修改时, 存下的旧版本号会让下一次调用重新计算
+        uint64_t generation = s_generation.load(std::memory_order_acquire);
+        LogLevel::Level level = m_parent && m_level_inherited.load(std::memory_order_relaxed)
+                                ? m_parent->getEffectiveLevel() : m_level.load(std::memory_order_relaxed);
+        m_effective_level.store(generation << 8 | (uint64_t) level, std::memory_order_relaxed);
+        return level;
+    }
+
+    uint32_t Logger::refreshCaptureFields() const {
+        uint64_t generation = s_generation.load(std::memory_order_acquire);
+        uint32_t fields = 0;
+        for (auto &appender: getEffectiveAppenders()->appenders) {
+            fields |= appender->getCaptureFields();
+        }
+        if (m_coarse_clock.load(std::memory_order_relaxed) ||
+            (m_parent && (m_parent->getCaptureFields() & LogEvent::CAPTURE_COARSE_CLOCK))) {
+            fields |= LogEvent::CAPTURE_COARSE_CLOCK;
+        }
+        m_capture_fields.store(generation << 8 | fields, std::memory_order_relaxed);
+        return fields;
+    }
+
+    std::shared_ptr<const Logger::AppenderCache> Logger::getEffectiveAppenders() const {
+        uint64_t generation = s_generation.load(std::memory_order_acquire);
+        auto cache = m_effective_appenders.load();
+        if (cache && cache->generation == generation) {
+            return cache;
+        }
+        auto fresh = std::make_shared<AppenderCache>();
+        fresh->generation = generation;
+        fresh->appenders = *m_appenders.load();
+        if (m_parent && m_additive.load(std::memory_order_relaxed)) {
+            auto parent = m_parent->getEffectiveAppenders();
+            for (auto &item: parent->appenders) {
+                if (std::find(fresh->appenders.begin(), fresh->appenders.end(), item) == fresh->appenders.end()) {
+                    fresh->appenders.push_back(item);
+                }
+            }
         }
+        m_effective_appenders.store(fresh);
+        return fresh;
+    }
+
+    Logger::Metrics Logger::getMetrics() const {
+        Metrics metrics;
+        for (size_t i = 0; i < 5; i++) {
+            metrics.events[i] = m_counters.get(i);
+        }
+        metrics.filtered = m_counters.get(FILTERED);
+        metrics.rate_limited = m_counters.get(RATE_LIMITED);
+        return metrics;
+    }
+
+    void Logger::setLevel(LogLevel::Level level) {
+        m_level.store(level, std::memory_order_relaxed);
+        m_level_inherited.store(false, std::memory_order_relaxed);
+        bumpGeneration();
+    }
+
+    void Logger::clearLevel() {
+        m_level_inherited.store(true, std::memory_order_relaxed);
+        bumpGeneration();
+    }
+
+    void Logger::setAdditive(bool additive) {
+        m_additive.store(additive, std::memory_order_relaxed);
+        bumpGeneration();
+    }
+
+    void Logger::setCoarseClock(bool coarse) {
+        m_coarse_clock.store(coarse, std::memory_order_relaxed);
+        bumpGeneration();
+    }
+
+    void Logger::setRateLimit(const LogRateLimit &limit) {
+        m_limit_rate.store(limit.rate_per_sec, std::memory_order_relaxed);
+        m_limit_burst.store(limit.burst, std::memory_order_relaxed);
+        m_limit_sample.store(limit.sample_every, std::memory_order_relaxed);
+        m_limit_coalesce_ms.store(limit.coalesce_ms, std::memory_order_relaxed);
+        m_limit_max_level.store(limit.max_level, std::memory_order_relaxed);
+        m_limited.store(limit.enabled(), std::memory_order_relaxed);
+    }
+
+    LogRateLimit Logger::getRateLimit() const {
+        LogRateLimit limit;
+        limit.rate_per_sec = m_limit_rate.load(std::memory_order_relaxed);
+        limit.burst = m_limit_burst.load(std::memory_order_relaxed);
+        limit.sample_every = m_limit_sample.load(std::memory_order_relaxed);
+        limit.coalesce_ms = m_limit_coalesce_ms.load(std::memory_order_relaxed);
+        limit.max_level = m_limit_max_level.load(std::memory_order_relaxed);
+        return limit;
     }
 
     void Logger::debug(sylar::LogEvent::ptr event) {
@@ -33,21 +332,39 @@ namespace sylar {
     }
 
     void Logger::addAppender(LogAppender::ptr appender) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         if (!appender->getFormatter()) {
             appender->setFormatter(log_formatter);
         }
-        m_appenders.insert(appender);
+        auto old_list = m_appenders.load();
+        if (std::find(old_list->begin(), old_list->end(), appender) != old_list->end()) {
+            return;
+        }
+        auto new_list = std::make_shared<AppenderList>(*old_list);
+        new_list->push_back(std::move(appender));
+        m_appenders.store(std::move(new_list));
+        bumpGeneration();
     }
 
     void Logger::delAppender(LogAppender::ptr appender) {
-        m_appenders.erase(appender);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto old_list = m_appenders.load();
+        auto new_list = std::make_shared<AppenderList>();
+        new_list->reserve(old_list->size());
+        for (auto &item: *old_list) {
+            if (item != appender) {
+                new_list->push_back(item);
+            }
+        }
+        m_appenders.store(std::move(new_list));
+        bumpGeneration();
     }
 
     void Logger::error(LogEvent::ptr event) {
         log(LogLevel::Level::ERROR, event);
     }
 
-    std::string Logger::getName() const {
+    const std::string &Logger::getName() const {
         return m_name;
     }
 
@@ -55,34 +372,682 @@ namespace sylar {
         m_name = name;
     }
 
+    void LogAppender::setFormatter(LogFormatter::ptr val) {
+        m_formatter.store(std::move(val));
+        // logger 按格式决定采集哪些字段
+        Logger::bumpGeneration();
+    }
+
+    LogAppender::Metrics LogAppender::getMetrics() const {
+        Metrics metrics;
+        metrics.events = m_counters.get(EVENTS);
+        metrics.bytes = m_counters.get(BYTES);
+        metrics.writes = m_counters.get(WRITES);
+        metrics.dropped = m_counters.get(DROPPED);
+        metrics.format_ns = m_format_ns.snapshot();
+        metrics.write_ns = m_write_ns.snapshot();
+        return metrics;
+    }
+
     void StdoutLogAppender::log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) {
         if (level >= m_level) {
-            std::cout << m_formatter->format(logger, level, event);
+            fmt::memory_buffer buf;
+            uint64_t begin = formatBegin();
+            readFormatter()->format(buf, logger, level, event);
+            countEvent(begin);
+            write(std::string_view(buf.data(), buf.size()), begin != 0);
         }
     }
 
+    void StdoutLogAppender::logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                         const LogEvent::ptr &event, const Formatted &formatted) {
+        countFormatted(formatted);
+        write(formatted.text, formatted.format_ns != 0);
+    }
+
+    void StdoutLogAppender::write(std::string_view text, bool timed) {
+        // 与格式化耗时一起采样
+        uint64_t write_begin = timed ? metrics::nowNs() : 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::cout.write(text.data(), (std::streamsize) text.size());
+        }
+        countWrite(write_begin, text.size());
+    }
+
+    void StdoutLogAppender::flush() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::cout.flush();
+    }
+
+    namespace {
+        uint64_t nowMs() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+            return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        }
+
+        // 定时处理 FileLogAppender 的时间阈值, 全进程共用一个线程
+        // 对象故意不析构, 避免进程退出时和静态 appender 的析构顺序问题
+        class FileFlushTimer {
+        public:
+            static FileFlushTimer &getInstance() {
+                static FileFlushTimer *instance = new FileFlushTimer;
+                return *instance;
+            }
+
+            void add(FileLogAppender *appender) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_appenders.push_back(appender);
+                if (!m_started) {
+                    m_started = true;
+                    std::thread(&FileFlushTimer::run, this).detach();
+                }
+            }
+
+            void del(FileLogAppender *appender) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_appenders.erase(std::remove(m_appenders.begin(), m_appenders.end(), appender),
+                                  m_appenders.end());
+            }
+
+        private:
+            void run() {
+                for (;;) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    uint64_t now = nowMs();
+                    for (auto appender: m_appenders) {
+                        appender->onTimer(now);
+                    }
+                }
+            }
+
+            std::mutex m_mutex;
+            std::vector<FileLogAppender *> m_appenders;
+            bool m_started = false;
+        };
+    }
+
+    FileLogAppender::FileLogAppender(const std::string &file_name) : FileLogAppender(file_name, Options()) {}
+
+    FileLogAppender::FileLogAppender(const std::string &file_name, const Options &options)
+            : m_file_name(file_name), m_options(options) {
+        {
+            std::lock_guard<std::mutex> lock(m_io_mutex);
+            openFile();
+        }
+        if (m_options.flush_interval_ms || m_options.rotate_interval_s || m_options.fsync_interval_ms) {
+            FileFlushTimer::getInstance().add(this);
+        }
+    }
+
+    FileLogAppender::~FileLogAppender() {
+        FileFlushTimer::getInstance().del(this);
+        writeBuffer(false);
+        // 最后再重试一次, 仍然写不出的事件计为丢弃
+        if (int error = writeChain(m_retry)) {
+            dropEvents(m_retry_events, error);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool FileLogAppender::openFile() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+        m_fd = open(m_file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        m_file_size = 0;
+        struct stat st;
+        if (m_fd >= 0 && fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            m_file_size = (uint64_t) st.st_size;
+        }
+        m_next_rotate_s = m_options.rotate_interval_s ? nextRotateTime((uint64_t) time(nullptr)) : 0;
+        return m_fd >= 0;
+    }
+
     bool FileLogAppender::reopen() {
-        if (m_filestream) {
-            m_filestream.close();
+        writeBuffer(false);
+        std::lock_guard<std::mutex> lock(m_io_mutex);
+        return openFile();
+    }
+
+    uint64_t FileLogAppender::nextRotateTime(uint64_t now_s) const {
+        // 按本地时间对齐, 例如 86400 在本地零点切分
+        struct tm tm;
+        time_t t = (time_t) now_s;
+        localtime_r(&t, &tm);
+        int64_t local = (int64_t) now_s + tm.tm_gmtoff;
+        int64_t interval = m_options.rotate_interval_s;
+        return (uint64_t) ((local / interval + 1) * interval - tm.tm_gmtoff);
+    }
+
+    void FileLogAppender::rotate(uint64_t now_s) {
+        struct tm tm;
+        time_t t = (time_t) now_s;
+        localtime_r(&t, &tm);
+        char suffix[32];
+        strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+        std::string target = m_file_name + suffix;
+        for (int i = 1; access(target.c_str(), F_OK) == 0; i++) {
+            target = m_file_name + suffix + "." + std::to_string(i);
+        }
+        if (m_fd >= 0 && m_unsynced_bytes) {
+            fdatasync(m_fd);
+            m_unsynced_bytes = 0;
         }
+        rename(m_file_name.c_str(), target.c_str());
+        openFile();
+    }
 
-        m_filestream.open(m_file_name);
-        return !!m_filestream;
+    int FileLogAppender::writeChain(ByteArray &chain) {
+        // 块链直接交给 writev, 不再拼成连续内存
+        size_t written = 0;
+        int error = m_fd >= 0 ? 0 : EBADF;
+        uint64_t write_begin = chain.empty() ? 0 : metrics::nowNs();
+        while (!error && !chain.empty()) {
+            ssize_t n = chain.writeTo(m_fd);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                error = errno;
+                break;
+            }
+            written += (size_t) n;
+        }
+        m_file_size += written;
+        m_unsynced_bytes += written;
+        if (write_begin) {
+            countWrite(write_begin, written);
+        }
+        return chain.empty() ? 0 : error;
+    }
+
+    void FileLogAppender::dropEvents(uint64_t events, int error) {
+        countDropped(events);
+        m_unreported_drops += events;
+        // 磁盘满等持续的错误下每次写盘都会失败, 最多 10 秒报告一次
+        uint64_t now_ms = nowMs();
+        if (m_last_report_ms && now_ms - m_last_report_ms < 10000) {
+            return;
+        }
+        fprintf(stderr, "sylar log: write %s failed: %s, dropped %lu events\n", m_file_name.c_str(),
+                strerror(error), (unsigned long) m_unreported_drops);
+        m_unreported_drops = 0;
+        m_last_report_ms = now_ms;
+    }
+
+    void FileLogAppender::writeBuffer(bool force_sync) {
+        std::lock_guard<std::mutex> io_lock(m_io_mutex);
+        ByteArray pending;
+        uint64_t pending_events;
+        {
+            // 在 io 锁内交换缓冲, 保证多个线程交出的缓冲按顺序写入
+            std::lock_guard<std::mutex> lock(m_mutex);
+            pending = std::move(m_buffer);
+            m_buffer = std::move(m_spare);
+            m_buffer_since_ms = 0;
+            pending_events = m_buffer_events;
+            m_buffer_events = 0;
+        }
+
+        uint64_t now_s = (uint64_t) time(nullptr);
+        if (m_options.rotate_interval_s && now_s >= m_next_rotate_s) {
+            rotate(now_s);
+        }
+        if (m_options.max_file_size && m_file_size > 0 && m_file_size + pending.size() > m_options.max_file_size) {
+            rotate(now_s);
+        }
+
+        if (m_fd < 0 && (!m_retry.empty() || !pending.empty())) {
+            openFile();
+        }
+        // 上次写失败留下的块链先写, 保持顺序; 仍然失败时本次的缓冲直接丢弃, 最多只留一条块链
+        int error = writeChain(m_retry);
+        if (error) {
+            if (!pending.empty()) {
+                dropEvents(pending_events, error);
+            }
+        } else {
+            m_retry_events = 0;
+            if ((error = writeChain(pending))) {
+                // 留到下次写盘时重试, 已经写出一部分的事件也记在这条块链上
+                std::swap(m_retry, pending);
+                m_retry_events = pending_events;
+                if (m_retry.size() > std::max<size_t>(m_options.buffer_size, 1) * 4) {
+                    // 太大的块链不再保留, 避免错误持续时内存无限增长
+                    m_retry.clear();
+                    dropEvents(m_retry_events, error);
+                    m_retry_events = 0;
+                }
+            }
+        }
+
+        uint64_t now_ms = nowMs();
+        bool sync = force_sync ||
+                    (m_options.fsync_bytes && m_unsynced_bytes >= m_options.fsync_bytes) ||
+                    (m_options.fsync_interval_ms && now_ms - m_last_sync_ms >= m_options.fsync_interval_ms);
+        if (sync && m_fd >= 0 && m_unsynced_bytes) {
+            fdatasync(m_fd);
+            m_unsynced_bytes = 0;
+            m_last_sync_ms = now_ms;
+        }
+
+        // 写完的缓冲留作下次交换用, 块已经还给内存池
+        pending.clear();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_spare = std::move(pending);
+    }
+
+    void FileLogAppender::flush() {
+        writeBuffer(false);
+    }
+
+    void FileLogAppender::onTimer(uint64_t now_ms) {
+        bool need_write;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            need_write = m_options.flush_interval_ms && !m_buffer.empty() &&
+                         now_ms - m_buffer_since_ms >= m_options.flush_interval_ms;
+        }
+        if (need_write) {
+            writeBuffer(false);
+            return;
+        }
+        std::lock_guard<std::mutex> io_lock(m_io_mutex);
+        uint64_t now_s = (uint64_t) time(nullptr);
+        if (m_options.rotate_interval_s && now_s >= m_next_rotate_s) {
+            rotate(now_s);
+        }
+        // 空闲时把之前写入但还没 fsync 的数据落盘
+        if (m_options.fsync_interval_ms && m_fd >= 0 && m_unsynced_bytes &&
+            now_ms - m_last_sync_ms >= m_options.fsync_interval_ms) {
+            fdatasync(m_fd);
+            m_unsynced_bytes = 0;
+            m_last_sync_ms = now_ms;
+        }
     }
 
     void FileLogAppender::log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) {
-        if (level >= m_level) {
-            m_formatter->format(m_filestream, logger, level, event);
+        if (level < m_level) {
+            return;
+        }
+        // 格式化在锁外完成
+        fmt::memory_buffer buf;
+        uint64_t begin = formatBegin();
+        readFormatter()->format(buf, logger, level, event);
+        countEvent(begin);
+        append(level, std::string_view(buf.data(), buf.size()));
+    }
+
+    void FileLogAppender::logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                       const LogEvent::ptr &event, const Formatted &formatted) {
+        countFormatted(formatted);
+        append(level, formatted.text);
+    }
+
+    void FileLogAppender::append(LogLevel::Level level, std::string_view text) {
+        bool urgent = m_options.fsync_on_error && level >= LogLevel::Level::ERROR;
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_buffer.empty()) {
+                m_buffer_since_ms = nowMs();
+            }
+            m_buffer.write(text);
+            m_buffer_events++;
+            full = m_buffer.size() >= m_options.buffer_size;
+        }
+        if (full || urgent) {
+            writeBuffer(urgent);
+        }
+    }
+
+    AsyncLogAppender::AsyncLogAppender(LogAppender::ptr target, size_t capacity, OverflowPolicy policy,
+                                       size_t batch_size)
+            : m_target(std::move(target)), m_policy(policy), m_batch_size(batch_size ? batch_size : 1),
+              m_queue(capacity) {
+        if (!m_target) {
+            throw std::invalid_argument("async log appender needs a target appender");
+        }
+        m_thread = std::thread(&AsyncLogAppender::run, this);
+    }
+
+    AsyncLogAppender::~AsyncLogAppender() {
+        stop();
+    }
+
+    void AsyncLogAppender::log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) {
+        if (level < m_level) {
+            return;
+        }
+        countEvent(0);
+        // 与 stop() 配对: 要么这里看到 m_stopped, 要么 stop() 等到本次入队结束后再做最后的清空
+        m_pushing.fetch_add(1, std::memory_order_seq_cst);
+        if (m_stopped.load(std::memory_order_seq_cst)) {
+            m_pushing.fetch_sub(1, std::memory_order_release);
+            m_target->log(logger, level, event);
+            return;
+        }
+        Item item{logger, level, std::move(event)};
+        if (!m_queue.tryPush(item)) {
+            switch (m_policy) {
+                case OverflowPolicy::DROP_NEWEST:
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    m_pushing.fetch_sub(1, std::memory_order_release);
+                    return;
+                case OverflowPolicy::DROP_OLDEST: {
+                    Item oldest;
+                    while (!m_queue.tryPush(item)) {
+                        if (m_queue.tryPop(oldest)) {
+                            oldest = Item();
+                            m_dropped.fetch_add(1, std::memory_order_relaxed);
+                            m_processed.fetch_add(1, std::memory_order_release);
+                        }
+                    }
+                    break;
+                }
+                case OverflowPolicy::BLOCK: {
+                    // 先短暂让出 CPU 重试, 仍然满再睡眠等待后台线程腾出空间
+                    bool pushed = false;
+                    for (int i = 0; i < 64 && !pushed; i++) {
+                        std::this_thread::yield();
+                        pushed = m_queue.tryPush(item);
+                    }
+                    if (pushed) {
+                        break;
+                    }
+                    m_blocked_producers.fetch_add(1, std::memory_order_seq_cst);
+                    while (!m_queue.tryPush(item)) {
+                        // 后台线程已经退出, 没有人再腾出空间, 直接写到被包装的 appender
+                        if (m_stopped.load(std::memory_order_acquire)) {
+                            m_blocked_producers.fetch_sub(1, std::memory_order_relaxed);
+                            m_pushing.fetch_sub(1, std::memory_order_release);
+                            m_target->log(item.logger, item.level, item.event);
+                            return;
+                        }
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_flusher_cond.notify_one();
+                        m_producer_cond.wait_for(lock, std::chrono::milliseconds(1));
+                    }
+                    m_blocked_producers.fetch_sub(1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+        }
+        m_pushing.fetch_sub(1, std::memory_order_release);
+        // 与 run() 中设置 m_flusher_sleeping 后的检查配对, 避免丢失唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_flusher_sleeping.load(std::memory_order_relaxed)) {
+            wakeFlusher();
+        }
+    }
+
+    LogAppender::Metrics AsyncLogAppender::getMetrics() const {
+        Metrics metrics = LogAppender::getMetrics();
+        metrics.dropped = getDropped();
+        uint64_t enqueued = m_queue.enqueuePos();
+        uint64_t processed = m_processed.load(std::memory_order_acquire);
+        metrics.queue_depth = enqueued > processed ? enqueued - processed : 0;
+        return metrics;
+    }
+
+    void AsyncLogAppender::flush() {
+        if (m_stopped.load(std::memory_order_acquire)) {
+            m_target->flush();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            // 后台线程可能已经退出, 剩余事件由 stop() 写完
+            lock.unlock();
+            m_target->flush();
+            return;
+        }
+        m_flush_target = std::max<uint64_t>(m_flush_target, m_queue.enqueuePos());
+        uint64_t ticket = ++m_flush_ticket;
+        m_flusher_cond.notify_one();
+        m_flush_done_cond.wait(lock, [this, ticket]() { return m_flushed_ticket >= ticket; });
+    }
+
+    void AsyncLogAppender::flush(std::function<void()> cb) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_stopping) {
+                m_flush_target = std::max<uint64_t>(m_flush_target, m_queue.enqueuePos());
+                m_flush_callbacks.emplace_back(++m_flush_ticket, std::move(cb));
+                m_flusher_cond.notify_one();
+                return;
+            }
+        }
+        // 后台线程已经在退出, 剩余事件由它写完
+        stop();
+        m_target->flush();
+        cb();
+    }
+
+    void AsyncLogAppender::stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping) {
+                return;
+            }
+            m_stopping = true;
+            m_flusher_cond.notify_one();
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        // 后台线程最后一次检查队列之后仍可能有事件入队: 先让之后的生产者直接写被包装的 appender,
+        // 再等正在入队的生产者结束, 把剩下的事件写完
+        m_stopped.store(true, std::memory_order_seq_cst);
+        Item item;
+        for (;;) {
+            // 先取计数再清空: 计数为 0 时之前的入队都已可见, 之后的生产者不会再入队
+            bool idle = m_pushing.load(std::memory_order_acquire) == 0;
+            while (m_queue.tryPop(item)) {
+                m_target->log(item.logger, item.level, item.event);
+                item = Item();
+                m_processed.fetch_add(1, std::memory_order_release);
+            }
+            if (idle) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        m_target->flush();
+    }
+
+    void AsyncLogAppender::setFormatter(LogFormatter::ptr val) {
+        LogAppender::setFormatter(val);
+        if (!m_target->getFormatter()) {
+            m_target->setFormatter(val);
+        }
+    }
+
+    void AsyncLogAppender::wakeFlusher() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_flusher_cond.notify_one();
+    }
+
+    void AsyncLogAppender::run() {
+        Item item;
+        for (;;) {
+            size_t n = 0;
+            while (n < m_batch_size && m_queue.tryPop(item)) {
+                m_target->log(item.logger, item.level, item.event);
+                item = Item();
+                m_processed.fetch_add(1, std::memory_order_release);
+                n++;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (n > 0 && m_blocked_producers.load(std::memory_order_relaxed)) {
+                m_producer_cond.notify_all();
+            }
+            if (m_flush_ticket > m_flushed_ticket &&
+                m_processed.load(std::memory_order_acquire) >= m_flush_target) {
+                uint64_t ticket = m_flush_ticket;
+                lock.unlock();
+                m_target->flush();
+                lock.lock();
+                m_flushed_ticket = ticket;
+                m_flush_done_cond.notify_all();
+                runFlushCallbacks(lock);
+            }
+            if (n == m_batch_size) {
+                continue;
+            }
+            if (m_stopping && m_queue.empty()) {
+                break;
+            }
+            m_flusher_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_queue.empty() && m_flush_ticket == m_flushed_ticket && !m_stopping) {
+                // 超时只是兜底, 正常情况下由生产者或 flush() 唤醒
+                m_flusher_cond.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            m_flusher_sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        m_target->flush();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_flushed_ticket = m_flush_ticket;
+        m_flush_done_cond.notify_all();
+        runFlushCallbacks(lock);
+    }
+
+    void AsyncLogAppender::runFlushCallbacks(std::unique_lock<std::mutex> &lock) {
+        auto end = m_flush_callbacks.begin();
+        while (end != m_flush_callbacks.end() && end->first <= m_flushed_ticket) {
+            ++end;
+        }
+        if (end == m_flush_callbacks.begin()) {
+            return;
+        }
+        std::vector<std::pair<uint64_t, std::function<void()>>> done(std::make_move_iterator(m_flush_callbacks.begin()),
+                                                                     std::make_move_iterator(end));
+        m_flush_callbacks.erase(m_flush_callbacks.begin(), end);
+        lock.unlock();
+        for (auto &item: done) {
+            item.second();
+        }
+        lock.lock();
+    }
+
+    namespace detail {
+        namespace {
+            struct DateTimeCache {
+                static constexpr size_t kMaxParts = 8;
+                static constexpr size_t kMaxText = 128;
+
+                uint64_t id = 0;
+                uint64_t second = 0;
+                uint16_t len[kMaxParts] = {};
+                char text[kMaxText] = {};
+            };
+
+            // 直接映射的线程缓存, 同一线程交替使用多个时间格式时各占一个槽
+            thread_local DateTimeCache t_date_time_cache[16];
+
+            std::atomic<uint64_t> s_date_time_layout_id{0};
+
+            void appendDigits(fmt::memory_buffer &buf, uint32_t value, int digits) {
+                char tmp[8];
+                for (int i = digits - 1; i >= 0; i--) {
+                    tmp[i] = (char) ('0' + value % 10);
+                    value /= 10;
+                }
+                buf.append(tmp, tmp + digits);
+            }
+        }
+
+        DateTimeLayout::DateTimeLayout(std::string_view time_format)
+                : m_id(++s_date_time_layout_id) {
+            if (time_format.empty()) {
+                time_format = "%Y-%m-%d %H:%M:%S";
+            }
+            std::string part;
+            for (size_t i = 0; i < time_format.size(); i++) {
+                char c = time_format[i];
+                if (c == '%' && i + 1 < time_format.size()) {
+                    char next = time_format[i + 1];
+                    if (next == 'L' || next == 'f') {
+                        m_parts.push_back(part);
+                        m_subsec_digits.push_back(next == 'L' ? 3 : 6);
+                        part.clear();
+                    } else {
+                        part += c;
+                        part += next;
+                    }
+                    i++;
+                    continue;
+                }
+                part += c;
+            }
+            m_parts.push_back(part);
+        }
+
+        void DateTimeLayout::append(fmt::memory_buffer &buf, const LogEvent &event) const {
+            DateTimeCache &cache = t_date_time_cache[m_id % (sizeof(t_date_time_cache) / sizeof(DateTimeCache))];
+            uint64_t second = event.getTime();
+            uint32_t usec = event.getTimeUsec();
+            if (cache.id != m_id || cache.second != second) {
+                struct tm tm;
+                time_t time = (time_t) second;
+                localtime_r(&time, &tm);
+                bool cacheable = m_parts.size() <= DateTimeCache::kMaxParts;
+                size_t used = 0;
+                char tmp[256];
+                for (size_t i = 0; cacheable && i < m_parts.size(); i++) {
+                    size_t n = m_parts[i].empty() ? 0 : strftime(tmp, sizeof(tmp), m_parts[i].c_str(), &tm);
+                    if (used + n > sizeof(cache.text)) {
+                        cacheable = false;
+                        break;
+                    }
+                    memcpy(cache.text + used, tmp, n);
+                    cache.len[i] = (uint16_t) n;
+                    used += n;
+                }
+                if (!cacheable) {
+                    // 格式太复杂, 不走缓存
+                    cache.id = 0;
+                    for (size_t i = 0; i < m_parts.size(); i++) {
+                        size_t n = m_parts[i].empty() ? 0 : strftime(tmp, sizeof(tmp), m_parts[i].c_str(), &tm);
+                        buf.append(tmp, tmp + n);
+                        if (i < m_subsec_digits.size()) {
+                            appendDigits(buf, m_subsec_digits[i] == 3 ? usec / 1000 : usec, m_subsec_digits[i]);
+                        }
+                    }
+                    return;
+                }
+                cache.id = m_id;
+                cache.second = second;
+            }
+
+            const char *text = cache.text;
+            for (size_t i = 0; i < m_parts.size(); i++) {
+                buf.append(text, text + cache.len[i]);
+                text += cache.len[i];
+                if (i < m_subsec_digits.size()) {
+                    appendDigits(buf, m_subsec_digits[i] == 3 ? usec / 1000 : usec, m_subsec_digits[i]);
+                }
+            }
         }
     }
 
+#define SYLAR_FORMAT_ITEM_ARGS \
+    fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent::ptr &event
+
     class StringFormatItem : public LogFormatter::FormatItem {
     public:
         StringFormatItem(const std::string &str) : m_str(str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << m_str;
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(m_str);
         }
 
     private:
@@ -93,9 +1058,8 @@ namespace sylar {
     public:
         MessageFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getContent();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(event->getContent());
         }
     };
 
@@ -103,9 +1067,8 @@ namespace sylar {
     public:
         ThreadIdFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getThreadId();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendInt(buf, event->getThreadId());
         }
 
     };
@@ -114,9 +1077,8 @@ namespace sylar {
     public:
         FiberIdFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getFiberId();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendInt(buf, event->getFiberId());
         }
     };
 
@@ -124,9 +1086,8 @@ namespace sylar {
     public:
         LineNumFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getLine();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendInt(buf, event->getLine());
         }
     };
 
@@ -134,9 +1095,8 @@ namespace sylar {
     public:
         ElapseFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getElapse();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendInt(buf, event->getElapse());
         }
     };
 
@@ -144,9 +1104,8 @@ namespace sylar {
     public:
         NewLineFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << std::endl;
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.push_back('\n');
         }
     };
 
@@ -154,9 +1113,8 @@ namespace sylar {
     public:
         FileNameFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getFileName();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(event->getFileName());
         }
     };
 
@@ -164,9 +1122,8 @@ namespace sylar {
     public:
         LogNameFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << 0;
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(logger->getName());
         }
     };
 
@@ -174,9 +1131,8 @@ namespace sylar {
     public:
         TabFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << "\t";
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.push_back('\t');
         }
     };
 
@@ -184,44 +1140,79 @@ namespace sylar {
     public:
         LogLevelFormatItem(const std::string &str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << LogLevel::toString(level);
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(LogLevel::toString(level));
         }
     };
 
     class DateTimeFormatItem : public LogFormatter::FormatItem {
     public:
-        DateTimeFormatItem(const std::string &time_format = "%Y-%m-%d %H:%M:%S") : m_time_format(time_format) {
-            if (m_time_format.empty()) {
-                m_time_format = "%Y-%m-%d %H:%M:%S";
-            }
-        }
+        DateTimeFormatItem(const std::string &time_format = "%Y-%m-%d %H:%M:%S") : m_layout(time_format) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            struct tm tm;
-            time_t time = event->getTime();
-            localtime_r(&time, &tm);
-            char buf[64];
-            strftime(buf, sizeof(buf), m_time_format.c_str(), &tm);
-            os << buf;
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            m_layout.append(buf, *event);
         }
 
     private:
-        std::string m_time_format;
+        detail::DateTimeLayout m_layout;
     };
 
     class ThreadNameFormatItem : public LogFormatter::FormatItem {
     public:
         ThreadNameFormatItem(const std::string str) {}
 
-        void
-        format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
-            os << event->getThreadName();
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(event->getThreadName());
+        }
+    };
+
+    class HttpMethodFormatItem : public LogFormatter::FormatItem {
+    public:
+        HttpMethodFormatItem(const std::string &str) {}
+
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(event->getHttpMethod());
         }
     };
 
+    class HttpPathFormatItem : public LogFormatter::FormatItem {
+    public:
+        HttpPathFormatItem(const std::string &str) {}
+
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            buf.append(event->getHttpPath());
+        }
+    };
+
+    class HttpStatusFormatItem : public LogFormatter::FormatItem {
+    public:
+        HttpStatusFormatItem(const std::string &str) {}
+
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendInt(buf, event->getHttpStatus());
+        }
+    };
+
+    class HttpLatencyFormatItem : public LogFormatter::FormatItem {
+    public:
+        HttpLatencyFormatItem(const std::string &str) {}
+
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendInt(buf, event->getHttpLatencyUs());
+        }
+    };
+
+    class FieldsFormatItem : public LogFormatter::FormatItem {
+    public:
+        FieldsFormatItem(const std::string &str) {}
+
+        void format(SYLAR_FORMAT_ITEM_ARGS) override {
+            detail::appendLogfmtFields(buf, *event);
+        }
+    };
+
+#undef SYLAR_FORMAT_ITEM_ARGS
+
 
     LogFormatter::LogFormatter(const std::string &pattern) {
         reset(pattern);
@@ -259,7 +1250,9 @@ namespace sylar {
                         throw std::invalid_argument("log pattern format error: can't find ");
                     }
                     fmt_msg = m_pattern.substr(n, pos - n);
-
+                    n = pos + 1;
+                    fmt_version = 0;
+                    break;
                 }
                 n++;
                 if (n == m_pattern.size() && fmt_flag.empty()) {
@@ -292,7 +1285,12 @@ namespace sylar {
         *  %l 行号
         *  %T 制表符
         *  %F 协程id
-        *  %N 线程名称 */
+        *  %N 线程名称
+        *  %M HTTP 方法
+        *  %U HTTP 路径
+        *  %S HTTP 状态码
+        *  %D HTTP 请求耗时(微秒)
+        *  %K 附加字段, logfmt 格式 */
         static std::unordered_map<std::string, std::function<FormatItem::ptr(
                 const std::string &)>> s_format_items_map = {
 #define  XX(str, C) \
@@ -309,11 +1307,27 @@ namespace sylar {
                 XX(T, TabFormatItem),
                 XX(F, FiberIdFormatItem),
                 XX(N, ThreadNameFormatItem),
+                XX(M, HttpMethodFormatItem),
+                XX(U, HttpPathFormatItem),
+                XX(S, HttpStatusFormatItem),
+                XX(D, HttpLatencyFormatItem),
+                XX(K, FieldsFormatItem),
 #undef XX
 
         };
 
+        m_fields = 0;
         for (auto &item: vec) {
+            const std::string &flag = std::get<0>(item);
+            if (flag == "d") {
+                m_fields |= LogEvent::CAPTURE_TIME;
+            } else if (flag == "r") {
+                m_fields |= LogEvent::CAPTURE_ELAPSE;
+            } else if (flag == "t" || flag == "N") {
+                m_fields |= LogEvent::CAPTURE_THREAD;
+            } else if (flag == "F") {
+                m_fields |= LogEvent::CAPTURE_FIBER;
+            }
             auto iter = s_format_items_map.find(std::get<0>(item));
             if (iter != s_format_items_map.end()) {
                 m_items.push_back(iter->second(std::get<1>(item)));
@@ -327,35 +1341,131 @@ namespace sylar {
     }
 
     std::string
-    LogFormatter::format(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) {
+    LogFormatter::format(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent::ptr &event) {
+        fmt::memory_buffer buf;
+        format(buf, logger, level, event);
+        return fmt::to_string(buf);
+    }
 
-        std::stringstream ss;
-        for (auto &item: m_items) {
-            item->format(ss, logger, level, event);
-        }
-        return ss.str();
+    std::ostream &LogFormatter::format(std::ostream &os, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                       const LogEvent::ptr &event) {
+        fmt::memory_buffer buf;
+        format(buf, logger, level, event);
+        os.write(buf.data(), (std::streamsize) buf.size());
+        return os;
+    }
 
+    void LogFormatter::format(ByteArray &out, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                              const LogEvent::ptr &event) {
+        fmt::memory_buffer buf;
+        format(buf, logger, level, event);
+        out.write(buf.data(), buf.size());
     }
 
-    std::ostream &LogFormatter::format(std::ostream &os, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
-                                       LogEvent::ptr event) {
+    void LogFormatter::format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                              const LogEvent::ptr &event) {
         for (auto &item: m_items) {
-            item->format(os, logger, level, event);
+            item->format(buf, logger, level, event);
         }
-        return os;
     }
 
     void LogFormatter::reset(const std::string &pattern) {
         m_pattern = pattern;
+        m_items.clear();
         init();
+        // 采集字段可能变化
+        Logger::bumpGeneration();
+    }
+
+    // 把流式写入转接到事件的内容缓冲
+    class LogEvent::ContentStream : public std::ostream {
+    public:
+        explicit ContentStream(ContentBuffer &buf) : std::ostream(nullptr), m_streambuf(buf) {
+            rdbuf(&m_streambuf);
+        }
+
+    private:
+        class StreamBuf : public std::streambuf {
+        public:
+            explicit StreamBuf(ContentBuffer &buf) : m_buf(buf) {}
+
+        protected:
+            int_type overflow(int_type ch) override {
+                if (ch != traits_type::eof()) {
+                    m_buf.push_back((char) ch);
+                }
+                return traits_type::not_eof(ch);
+            }
+
+            std::streamsize xsputn(const char *s, std::streamsize n) override {
+                m_buf.append(s, s + n);
+                return n;
+            }
+
+        private:
+            ContentBuffer &m_buf;
+        };
+
+        StreamBuf m_streambuf;
+    };
+
+    LogEvent::ptr LogEvent::capture(const std::source_location &location, uint32_t fields) {
+        ptr event = create(location, 0u, 0u, 0u, (uint64_t) 0);
+        if (fields & CAPTURE_TIME) {
+            struct timespec ts;
+            clock_gettime(fields & CAPTURE_COARSE_CLOCK ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME, &ts);
+            event->m_time = (uint64_t) ts.tv_sec;
+            event->m_time_usec = (uint32_t) (ts.tv_nsec / 1000);
+        }
+        if (fields & CAPTURE_ELAPSE) {
+            event->m_elapse = (uint32_t) getElapseMs();
+        }
+        if (fields & CAPTURE_THREAD) {
+            const ThreadInfo &thread = ::getThreadInfo();
+            event->m_threadId = thread.tid;
+            event->m_thread_info = &thread;
+            event->m_thread_ref = true;
+            retainThreadInfo(&thread);
+        }
+        if (fields & CAPTURE_FIBER) {
+            event->m_fiberId = (uint32_t) ::getFiberId();
+        }
+        return event;
+    }
+
+    void LogEvent::ContentStreamDeleter::operator()(ContentStream *stream) const {
+        delete stream;
     }
 
-    const std::string &LogEvent::getFileName() const {
+    LogEvent::~LogEvent() {
+        if (m_thread_ref) {
+            releaseThreadInfo(m_thread_info);
+        }
+    }
+
+    void LogEvent::addField(const LogField &field) {
+        uint8_t key_len = (uint8_t) std::min<size_t>(field.key.size(), 255);
+        m_fields.push_back((char) field.type);
+        m_fields.push_back((char) key_len);
+        m_fields.append(field.key.data(), field.key.data() + key_len);
+        if (field.type == LogField::Type::STRING) {
+            uint32_t len = (uint32_t) field.str.size();
+            m_fields.append((const char *) &len, (const char *) &len + sizeof(len));
+            m_fields.append(field.str.data(), field.str.data() + len);
+        } else if (field.type == LogField::Type::BOOL) {
+            m_fields.push_back(field.b ? 1 : 0);
+        } else {
+            m_fields.append((const char *) &field.u, (const char *) &field.u + sizeof(field.u));
+        }
+    }
+
+    std::string_view LogEvent::getFileName() const {
         return m_file_name;
     }
 
     void LogEvent::setFileName(const std::string &mFileName) {
-        m_file_name = mFileName;
+        m_file_name_storage = mFileName;
+        m_file_name = m_file_name_storage;
     }
 
     int32_t LogEvent::getLine() const {
@@ -398,47 +1508,90 @@ namespace sylar {
         m_time = mTime;
     }
 
-    std::string LogEvent::getContent() const {
-        return m_content_stream.str();
-    }
-
-    void LogEvent::setContent(const std::string &content) {
-        m_content_stream.clear();
-        m_content_stream << content;
+    std::string_view LogEvent::getContent() const {
+        if (m_binary_site) {
+            std::call_once(m_binary_text_once, &LogEvent::formatBinaryContent, this);
+            return {m_binary_text->data(), m_binary_text->size()};
+        }
+        return {m_content.data(), m_content.size()};
     }
 
-    std::string LogEvent::getThreadName() const {
-        return m_thread_name;
+    void LogEvent::formatBinaryContent() const {
+        BinaryLogRegistry::Site site;
+        // 文本放在单独的缓冲, 参数所在的 m_content 不会因为追加而搬移, 其他线程可以同时读取参数
+        m_binary_text.reset(new ContentBuffer);
+        if (!BinaryLogRegistry::getInstance().getSite(m_binary_site, site)) {
+            fmt::format_to(std::back_inserter(*m_binary_text), "<unknown binary log site {}>", m_binary_site);
+            return;
+        }
+        binary_log::formatArgs(site.format, getBinaryArgs(), *m_binary_text);
     }
 
-    void LogEvent::setThreadName(const std::string &thread_name) {
-        m_thread_name = thread_name;
+    void LogEvent::setContent(std::string_view content) {
+        m_content.clear();
+        m_binary_site = 0;
+        m_binary_args_size = 0;
+        m_content.append(content);
     }
 
-    std::stringstream &LogEvent::getContentStream() {
-        return m_content_stream;
+    std::ostream &LogEvent::getContentStream() {
+        if (!m_content_stream) {
+            m_content_stream.reset(new ContentStream(m_content));
+        }
+        return *m_content_stream;
     }
 
     LoggerManager::LoggerManager() {
         m_root.reset(new Logger);
         m_root->addAppender(LogAppender::ptr (new StdoutLogAppender));
-        m_loggers[m_root->getName()] = m_root;
+        auto loggers = std::make_shared<LoggerMap>();
+        (*loggers)[m_root->getName()] = m_root;
+        m_loggers.store(std::move(loggers));
     }
 
 
     Logger::ptr LoggerManager::getLogger(const std::string &name) {
+        if (name.empty()) {
+            return m_root;
+        }
+        auto loggers = m_loggers.load();
+        auto it = loggers->find(name);
+        if (it != loggers->end()) {
+            return it->second;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto old_loggers = m_loggers.load();
+        it = old_loggers->find(name);
+        if (it != old_loggers->end()) {
+            return it->second;
+        }
+        auto new_loggers = std::make_shared<LoggerMap>(*old_loggers);
+        Logger::ptr logger = create(name, *new_loggers);
+        m_loggers.store(std::move(new_loggers));
+        return logger;
+    }
 
-        if(m_loggers.find(name) == m_loggers.end())
-            throw std::invalid_argument("123");
-        return m_loggers[name];
+    Logger::ptr LoggerManager::create(const std::string &name, LoggerMap &loggers) {
+        auto it = loggers.find(name);
+        if (it != loggers.end()) {
+            return it->second;
+        }
+        size_t pos = name.rfind('.');
+        Logger::ptr parent = pos == std::string::npos || pos == 0 ? m_root : create(name.substr(0, pos), loggers);
+        Logger::ptr logger(new Logger(name));
+        // 发布到表中之前设置, 之后不再修改
+        logger->m_parent = parent.get();
+        logger->m_level_inherited.store(true, std::memory_order_relaxed);
+        loggers[name] = logger;
+        return logger;
+    }
 
+    void LoggerManager::setRateLimit(const std::string &name, const LogRateLimit &limit) {
+        getLogger(name)->setRateLimit(limit);
     }
 
     void LoggerManager::addLogger(const std::string &name) {
-        if(m_loggers.find(name) != m_loggers.end())
-            return;
-        Logger::ptr logger(new Logger(name));
-        m_loggers[name] = logger;
+        getLogger(name);
     }
 
 
@@ -15,9 +15,25 @@
 #include <unordered_map>
 #include <functional>
 #include <sstream>
+#include <string_view>
+#include <ostream>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
 #include <fmt/core.h>
+#include <fmt/format.h>
 #include <source_location>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "bytearray.h"
+#include "log_flight_recorder.h"
+#include "log_metrics.h"
 #include "utils.h"
+#include "ring_queue.h"
+#include "pool_allocator.h"
+#include "mutex.h"
 
 namespace sylar {
 
@@ -53,28 +69,197 @@ namespace sylar {
 
     class Logger;
 
+// 调用点附加的类型化字段
+// 字符串只是引用, 加到事件时拷贝; 整数, 浮点数和 bool 按类型保存, 结构化格式器按类型输出
+    struct LogField {
+        enum class Type : uint8_t {
+            INT,
+            UINT,
+            DOUBLE,
+            BOOL,
+            STRING
+        };
+
+        LogField() = default;
+
+        template<class T>
+        LogField(std::string_view k, const T &v) : key(k) {
+            if constexpr (std::is_same_v<T, bool>) {
+                type = Type::BOOL;
+                b = v;
+            } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                type = Type::INT;
+                i = v;
+            } else if constexpr (std::is_integral_v<T>) {
+                type = Type::UINT;
+                u = v;
+            } else if constexpr (std::is_floating_point_v<T>) {
+                type = Type::DOUBLE;
+                d = v;
+            } else {
+                static_assert(std::is_convertible_v<const T &, std::string_view>, "unsupported log field type");
+                type = Type::STRING;
+                str = std::string_view(v);
+            }
+        }
+
+        std::string_view key;
+        Type type = Type::INT;
+        union {
+            int64_t i = 0;
+            uint64_t u;
+            double d;
+            bool b;
+        };
+        std::string_view str;
+    };
+
 //日志事件
     class LogEvent {
     public:
         typedef std::shared_ptr<LogEvent> ptr;
 
+        // 消息内容的内联缓冲, 大多数日志行不需要堆分配
+        typedef fmt::basic_memory_buffer<char, 256> ContentBuffer;
+
         LogEvent(const std::string &file_name, int32_t line, uint32_t elapse, uint32_t thread_id, uint32_t fiber_id,
-                 uint64_t time) :
-                m_file_name(file_name), m_line(line), m_elapse(elapse), m_threadId(thread_id), m_fiberId(fiber_id),
-                m_time(time) {}
+                 uint64_t time, uint32_t time_usec = 0) :
+                m_file_name_storage(file_name), m_file_name(m_file_name_storage), m_line(line), m_elapse(elapse),
+                m_threadId(thread_id), m_fiberId(fiber_id), m_time(time), m_time_usec(time_usec) {}
+
+        // 文件名直接引用 source_location 中的静态字符串, 不做拷贝
+        LogEvent(const std::source_location &location, uint32_t elapse, uint32_t thread_id, uint32_t fiber_id,
+                 uint64_t time, uint32_t time_usec = 0) :
+                m_file_name(location.file_name()), m_line((int32_t) location.line()), m_elapse(elapse),
+                m_threadId(thread_id), m_fiberId(fiber_id), m_time(time), m_time_usec(time_usec) {}
+
+        // 线程号和线程名都取自线程身份(getThreadInfo()), 只保存指针并持有一个引用
+        LogEvent(const std::source_location &location, uint32_t elapse, const ThreadInfo &thread, uint32_t fiber_id,
+                 uint64_t time, uint32_t time_usec = 0) :
+                m_file_name(location.file_name()), m_line((int32_t) location.line()), m_elapse(elapse),
+                m_threadId(thread.tid), m_fiberId(fiber_id), m_time(time), m_time_usec(time_usec),
+                m_thread_info(&thread), m_thread_ref(true) {
+            retainThreadInfo(&thread);
+        }
+
+        LogEvent(const LogEvent &) = delete;
+
+        LogEvent &operator=(const LogEvent &) = delete;
+
+        ~LogEvent();
+
+        // 从线程本地内存池分配事件, 稳定状态下没有堆分配
+        template<class... Args>
+        static ptr create(Args &&... args) {
+            return std::allocate_shared<LogEvent>(PoolAllocator<LogEvent>(), std::forward<Args>(args)...);
+        }
+
+        // 调用点按需采集的字段, 对应格式项 %d, %r, %t 和 %N, %F; 文件名和行号来自 source_location, 总是采集.
+        // 没有采集的字段为 0 或空
+        enum CaptureField : uint32_t {
+            CAPTURE_TIME = 1 << 0,
+            CAPTURE_ELAPSE = 1 << 1,
+            CAPTURE_THREAD = 1 << 2,        //线程号和线程名
+            CAPTURE_FIBER = 1 << 3,
+            CAPTURE_ALL = (1 << 4) - 1,
+            CAPTURE_COARSE_CLOCK = 1 << 4,  //时间取 CLOCK_REALTIME_COARSE, 精度为一个时钟节拍(通常 1~4ms)
+        };
+
+        // 在调用点采集 fields 中的字段: 当前时间, 启动以来的毫秒数, 线程号, 协程号
+        static ptr capture(const std::source_location &location, uint32_t fields = CAPTURE_ALL);
+
+        // 按 fmt 语法把消息追加到内容缓冲
+        template<class... Args>
+        void format(fmt::format_string<Args...> fmt, Args &&... args) {
+            fmt::format_to(std::back_inserter(m_content), fmt, std::forward<Args>(args)...);
+        }
+
+        // 二进制模式: 内容缓冲中先存放编码后的参数, 第一次 getContent() 时才格式化成文本追加在后面
+        ContentBuffer &beginBinary(uint32_t site) {
+            m_content.clear();
+            m_binary_site = site;
+            m_binary_args_size = 0;
+            return m_content;
+        }
+
+        void endBinary() { m_binary_args_size = (uint32_t) m_content.size(); }
+
+        // 附加字段, 键超过 255 字节时截断
+        void addField(const LogField &field);
+
+        void addFields(std::initializer_list<LogField> fields) {
+            for (auto &field: fields) {
+                addField(field);
+            }
+        }
+
+        [[nodiscard]] bool hasFields() const { return m_fields.size() != 0; }
+
+        // 按添加顺序访问字段, 其中的字符串指向事件内部, 在事件销毁前有效
+        template<class F>
+        void forEachField(F &&f) const {
+            const char *p = m_fields.data();
+            const char *end = p + m_fields.size();
+            while (p < end) {
+                LogField field;
+                field.type = (LogField::Type) *p++;
+                uint8_t key_len = (uint8_t) *p++;
+                field.key = std::string_view(p, key_len);
+                p += key_len;
+                if (field.type == LogField::Type::STRING) {
+                    uint32_t len;
+                    memcpy(&len, p, sizeof(len));
+                    field.str = std::string_view(p + sizeof(len), len);
+                    p += sizeof(len) + len;
+                } else if (field.type == LogField::Type::BOOL) {
+                    field.b = *p++ != 0;
+                } else {
+                    memcpy(&field.u, p, sizeof(field.u));
+                    p += sizeof(field.u);
+                }
+                f(field);
+            }
+        }
+
+        [[nodiscard]] bool isBinary() const { return m_binary_site != 0; }
+
+        [[nodiscard]] uint32_t getBinarySite() const { return m_binary_site; }
+
+        [[nodiscard]] std::string_view getBinaryArgs() const { return {m_content.data(), m_binary_args_size}; }
 
     private:
-        std::string m_file_name;        //文件名
+        void formatBinaryContent() const;
+
+        class ContentStream;
+
+        struct ContentStreamDeleter {
+            void operator()(ContentStream *stream) const;
+        };
+
+        std::string m_file_name_storage;  //仅在传入 std::string 文件名时使用
+        std::string_view m_file_name;   //文件名
         int32_t m_line = 0;             //行号
         uint32_t m_elapse = 0;           //程序启动开始到现在的毫秒数
         uint32_t m_threadId = 0;        //线程号
         uint32_t m_fiberId = 0;         //协程号
         uint64_t m_time = 0;
-        std::string m_thread_name;
-        std::stringstream m_content_stream;
+        uint32_t m_time_usec = 0;       //m_time 这一秒内的微秒数
+        const ThreadInfo *m_thread_info = nullptr;  //产生事件的线程
+        bool m_thread_ref = false;                  //是否持有 m_thread_info 的引用, 析构时释放
+        mutable ContentBuffer m_content;
+        fmt::basic_memory_buffer<char, 128> m_fields;   //编码后的字段: 类型, 键长, 键, 值
+        uint32_t m_binary_site = 0;         //二进制模式的调用点 id, 0 表示普通文本
+        uint32_t m_binary_args_size = 0;
+        mutable std::once_flag m_binary_text_once;
+        mutable std::unique_ptr<ContentBuffer> m_binary_text;     //二进制事件第一次 getContent() 时格式化的文本
+        std::unique_ptr<ContentStream, ContentStreamDeleter> m_content_stream;    //兼容流式写法, 第一次使用时才创建
+        std::string_view m_http_method;     //HTTP 访问日志, 静态字符串
+        std::string m_http_path;
+        uint32_t m_http_status = 0;
+        uint64_t m_http_latency_us = 0;
     public:
         // [[nodiscard]] 为不应该舍弃返回值，若舍弃返回值，编译器会warning
-        [[nodiscard]] const std::string &getFileName() const;
+        [[nodiscard]] std::string_view getFileName() const;
 
         void setFileName(const std::string &mFileName);
 
@@ -98,18 +283,68 @@ namespace sylar {
 
         void setTime(uint64_t mTime);
 
-        [[nodiscard]] std::string getContent() const;
+        [[nodiscard]] uint32_t getTimeUsec() const { return m_time_usec; }
 
-        void setContent(const std::string &content);
+        void setTimeUsec(uint32_t usec) { m_time_usec = usec; }
 
-        [[nodiscard]] std::string getThreadName() const;
+        // 返回的视图在事件内容被修改前有效
+        [[nodiscard]] std::string_view getContent() const;
 
-        void setThreadName(const std::string &thread_name);
+        void setContent(std::string_view content);
 
-        [[nodiscard]] std::stringstream& getContentStream();
+        [[nodiscard]] std::string_view getThreadName() const {
+            return m_thread_info ? std::string_view(m_thread_info->name) : std::string_view();
+        }
+
+        [[nodiscard]] const ThreadInfo *getThreadInfo() const { return m_thread_info; }
+
+        // 不持有引用, info 需要比事件活得久
+        void setThreadInfo(const ThreadInfo *info) { m_thread_info = info; }
+
+        // 慢路径: 写入的内容直接追加到内容缓冲
+        [[nodiscard]] std::ostream &getContentStream();
+
+        // HTTP 访问日志字段, 对应格式项 %M(方法) %U(路径) %S(状态码) %D(耗时, 微秒); method 需要是静态字符串
+        void setHttpAccess(std::string_view method, std::string_view path, uint32_t status, uint64_t latency_us) {
+            m_http_method = method;
+            m_http_path.assign(path);
+            m_http_status = status;
+            m_http_latency_us = latency_us;
+        }
+
+        [[nodiscard]] std::string_view getHttpMethod() const { return m_http_method; }
+
+        [[nodiscard]] std::string_view getHttpPath() const { return m_http_path; }
+
+        [[nodiscard]] uint32_t getHttpStatus() const { return m_http_status; }
+
+        [[nodiscard]] uint64_t getHttpLatencyUs() const { return m_http_latency_us; }
 
     };
 
+    namespace detail {
+        // 预先拆分好的时间格式, 运行时和编译期格式器共用
+        // 在 strftime 的基础上增加 %L(毫秒, 3位) 和 %f(微秒, 6位), 由整数直接转换拼接;
+        // strftime 部分的结果按线程缓存, 只有秒数变化时才重新调用 localtime_r/strftime
+        class DateTimeLayout {
+        public:
+            explicit DateTimeLayout(std::string_view time_format);
+
+            void append(fmt::memory_buffer &buf, const LogEvent &event) const;
+
+        private:
+            std::vector<std::string> m_parts;   //strftime 格式片段, 比 m_subsec_digits 多一个
+            std::vector<int> m_subsec_digits;   //每个片段之后的亚秒位数
+            uint64_t m_id;                      //线程缓存的键
+        };
+
+        template<class T>
+        inline void appendInt(fmt::memory_buffer &buf, T value) {
+            fmt::format_int str(value);
+            buf.append(str.data(), str.data() + str.size());
+        }
+    }
+
 //日志格式
     class LogFormatter {
     public:
@@ -119,13 +354,29 @@ namespace sylar {
 
         LogFormatter(const std::string &pattern);
 
-        std::string format(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event);
+        virtual ~LogFormatter() {}
+
+        std::string format(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent::ptr &event);
 
         std::ostream &
-        format(std::ostream &os, const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event);
+        format(std::ostream &os, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+               const LogEvent::ptr &event);
+
+        // 追加到 out 的块链末尾
+        void format(ByteArray &out, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                    const LogEvent::ptr &event);
+
+        // 追加到 buf 末尾, 其他 format 重载都基于它
+        virtual void format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                            const LogEvent::ptr &event);
 
         void reset(const std::string &pattern);
 
+        const std::string &getPattern() const { return m_pattern; }
+
+        // 模式用到的需要在调用点采集的字段, LogEvent::CaptureField 的组合
+        uint32_t getFields() const { return m_fields; }
+
     public:
         class FormatItem {
         public:
@@ -134,14 +385,24 @@ namespace sylar {
             virtual ~FormatItem() {}
 
             virtual void
-            format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+            format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                   const LogEvent::ptr &event) = 0;
         };
 
         void init();
 
+    protected:
+        // 供编译期解析的子类使用, 不做运行时解析
+        struct NoParse {
+        };
+
+        LogFormatter(const std::string &pattern, NoParse, uint32_t fields = LogEvent::CAPTURE_ALL) :
+                m_pattern(pattern), m_fields(fields) {}
+
     private:
         std::string m_pattern;
         std::vector<FormatItem::ptr> m_items;
+        uint32_t m_fields = LogEvent::CAPTURE_ALL;
     };
 
 //日志输出地
@@ -153,13 +414,139 @@ namespace sylar {
 
         virtual void log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) = 0;
 
-        void setFormatter(LogFormatter::ptr val) { m_formatter = val; }
+        // 已经按本 appender 的格式格式化好的事件
+        struct Formatted {
+            std::string_view text;
+            uint64_t format_ns = 0;     //格式化耗时, 没有被采样时为 0
+        };
+
+        // 能直接写出格式化好的文本时返回 true; logger 把共用同一个格式对象的 appender 分为一组,
+        // 每组每条事件只格式化一次, 然后调用组内各个 appender 的 logFormatted()
+        virtual bool canLogFormatted() const { return false; }
+
+        // 级别已经检查过; 默认忽略 formatted, 调用 log()
+        virtual void logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                  const LogEvent::ptr &event, const Formatted &formatted) {
+            log(logger, level, event);
+        }
+
+        // 把缓冲中的内容写到底层输出, 默认什么都不做
+        virtual void flush() {}
+
+        // 格式可以在运行中替换, 正在写的事件继续使用旧格式
+        virtual void setFormatter(LogFormatter::ptr val);
+
+        LogFormatter::ptr getFormatter() const { return m_formatter.load(); }
+
+        // 写事件的热路径用, 不加锁也不改引用计数; 结果只在当前线程的这次调用内使用
+        AtomicSharedPtr<LogFormatter>::Snapshot readFormatter() const { return m_formatter.read(); }
+
+        void setLevel(LogLevel::Level level) { m_level = level; }
+
+        LogLevel::Level getLevel() const { return m_level; }
+
+        // 自身的运行统计; 没有队列的 appender 队列长度为 0, 不丢弃事件的 dropped 为 0
+        struct Metrics {
+            uint64_t events = 0;            //接收并处理的事件数
+            uint64_t bytes = 0;             //写到输出目标的字节数
+            uint64_t writes = 0;            //写输出目标的次数
+            uint64_t dropped = 0;
+            uint64_t queue_depth = 0;
+            LogHistogram::Snapshot format_ns;   //每条事件的格式化耗时, 按线程每 16 条采样一条
+            LogHistogram::Snapshot write_ns;    //每次写输出目标的耗时
+        };
+
+        virtual Metrics getMetrics() const;
 
-        LogFormatter::ptr getFormatter() { return m_formatter; }
+        // 导出统计时的类型标签
+        virtual const char *getType() const { return "custom"; }
+
+        // 需要 logger 在调用点采集的字段, 默认取自格式对象; 不经过格式对象直接读取事件字段的子类需要覆盖
+        virtual uint32_t getCaptureFields() const {
+            auto formatter = getFormatter();
+            return formatter ? formatter->getFields() : LogEvent::CAPTURE_ALL;
+        }
 
     protected:
-        LogLevel::Level m_level;
-        LogFormatter::ptr m_formatter;
+        // 以下供子类统计使用
+        // 格式化一条事件之前调用, 被采样时返回开始时间, 否则返回 0
+        static uint64_t formatBegin() { return metrics::sampleTiming() ? metrics::nowNs() : 0; }
+
+        // 处理完一条事件, format_begin 不为 0 时记录格式化耗时
+        void countEvent(uint64_t format_begin) {
+            m_counters.add(EVENTS);
+            if (format_begin) {
+                m_format_ns.record(metrics::nowNs() - format_begin);
+            }
+        }
+
+        // 完成一次写出, write_begin 为 0 时不记录耗时
+        void countWrite(uint64_t write_begin, size_t bytes) {
+            m_counters.add(WRITES);
+            m_counters.add(BYTES, bytes);
+            if (write_begin) {
+                m_write_ns.record(metrics::nowNs() - write_begin);
+            }
+        }
+
+        // 处理完一条由 logger 格式化好的事件
+        void countFormatted(const Formatted &formatted) {
+            m_counters.add(EVENTS);
+            if (formatted.format_ns) {
+                m_format_ns.record(formatted.format_ns);
+            }
+        }
+
+        void countDropped(uint64_t n = 1) { m_counters.add(DROPPED, n); }
+
+    protected:
+        LogLevel::Level m_level = LogLevel::Level::DEBUG;
+        AtomicSharedPtr<LogFormatter> m_formatter;
+        std::mutex m_mutex;             //保护子类的输出目标, 同一个 appender 的写入不会交错
+
+    private:
+        enum Counter {
+            EVENTS,
+            BYTES,
+            WRITES,
+            DROPPED,
+            COUNTER_COUNT
+        };
+
+        LogCounters<COUNTER_COUNT> m_counters;
+        LogHistogram m_format_ns;
+        LogHistogram m_write_ns;
+    };
+
+// 日志限流配置, 按 logger 设置
+// 三种手段可以组合, 顺序为采样 -> 合并 -> 令牌桶, 全部在格式化之前完成.
+// 被合并和令牌桶丢弃的条数按调用点累计, 该调用点下一条放行时先输出一条 "last message repeated N times";
+// 采样本身就是有意的丢弃, 不计入.
+    struct LogRateLimit {
+        uint32_t rate_per_sec = 0;      //令牌桶每秒放行的条数, 0 表示不限速
+        uint32_t burst = 0;             //令牌桶容量, 0 时等于 rate_per_sec
+        uint32_t sample_every = 0;      //每 N 条只保留第一条, 0 和 1 表示不采样
+        uint32_t coalesce_ms = 0;       //同一调用点在这段时间内只放行一条, 0 表示不合并
+        LogLevel::Level max_level = LogLevel::Level::ERROR;    //只限制不高于该级别的事件, 默认 FATAL 不受限
+
+        bool enabled() const { return rate_per_sec || sample_every > 1 || coalesce_ms; }
+    };
+
+// 一个调用点的限流状态
+// 只有原子变量, 可以常量初始化为 SYLAR_LOG_* 宏里函数内的 static, 多个线程并发检查不加锁.
+// 同一个调用点写到不同 logger 时共用这份状态, 各自按 logger 的配置检查.
+    class LogSiteLimiter {
+    public:
+        constexpr LogSiteLimiter() = default;
+
+        // 返回 false 表示丢弃; 放行时 suppressed 为之前累计丢弃的条数
+        bool admit(const LogRateLimit &limit, uint64_t &suppressed);
+
+    private:
+        std::atomic<uint64_t> m_count{0};           //采样计数
+        std::atomic<uint64_t> m_next_pass_ms{0};    //合并窗口结束的时间
+        std::atomic<uint64_t> m_tat_us{0};          //令牌桶(GCRA)的理论到达时间
+        std::atomic<uint64_t> m_suppressed{0};
     };
 
     class Logger : public std::enable_shared_from_this<Logger> {
@@ -168,12 +555,31 @@ namespace sylar {
 
         Logger(const std::string &name = "root", LogLevel::Level level = LogLevel::Level::DEBUG,
                const std::string &log_format_pattern = "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n") :
-                m_name(name), m_level(level) {
+                m_name(name), m_level(level), log_formatter(new LogFormatter(log_format_pattern)) {
 
         }
 
+        // 开启限流时按事件的文件名和行号找到调用点状态
         void log(LogLevel::Level level, LogEvent::ptr event);
 
+        // 由 SYLAR_LOG_* 宏调用, 级别已经检查过; 限流检查在采集事件和格式化参数之前
+        template<class... Args>
+        void log(LogLevel::Level level, const std::source_location &location, LogSiteLimiter &site,
+                 fmt::format_string<Args...> fmt, Args &&... args) {
+            if (isLimited(level) && !admit(level, &site, location.file_name(), (int32_t) location.line())) {
+                return;
+            }
+            LogEvent::ptr event = captureEvent(location);
+            event->format(fmt, std::forward<Args>(args)...);
+            dispatch(level, std::move(event));
+        }
+
+        // 由 SYLAR_LOG_FIELDS 宏调用, 固定的消息加上类型化字段
+        void logFields(LogLevel::Level level, const std::source_location &location, LogSiteLimiter &site,
+                       std::string_view message, std::initializer_list<LogField> fields);
+
+        bool isEnabled(LogLevel::Level level) const { return level >= getEffectiveLevel(); }
+
         void debug(LogEvent::ptr event);
 
         void info(LogEvent::ptr event);
@@ -188,19 +594,138 @@ namespace sylar {
 
         void delAppender(LogAppender::ptr appender);
 
-        LogLevel::Level getLevel() const { return m_level; }
+        // 实际生效的级别, 没有设置过级别时继承自父 logger
+        LogLevel::Level getLevel() const { return getEffectiveLevel(); }
 
-        void setLevel(LogLevel::Level level) { m_level = level; }
+        // 运行时可以随时修改, 与正在记录日志的线程没有数据竞争; 没有单独设置级别的子 logger 随之改变
+        void setLevel(LogLevel::Level level);
+
+        // 取消单独设置的级别, 重新继承父 logger 的级别; 没有父 logger 时保持原来的级别
+        void clearLevel();
+
+        // 是否也写到父 logger 的 appender, 默认为 true
+        void setAdditive(bool additive);
+
+        bool isAdditive() const { return m_additive.load(std::memory_order_relaxed); }
 
-        std::string getName() const;
+        // 由 LoggerManager 创建的 logger 才有父 logger, 根 logger 和直接构造的 logger 返回空
+        Logger *getParent() const { return m_parent; }
 
+        const std::string &getName() const;
+
+        // 名字不受并发保护, 只应在 logger 投入使用前设置
         void setName(const std::string &name);
 
+        typedef std::vector<LogAppender::ptr> AppenderList;
+
+        // 当前 appender 列表的只读快照
+        std::shared_ptr<const AppenderList> getAppenders() const { return m_appenders.load(); }
+
+        // 运行时可以随时修改, 各个字段分别原子地生效
+        void setRateLimit(const LogRateLimit &limit);
+
+        LogRateLimit getRateLimit() const;
+
+        bool isLimited(LogLevel::Level level) const {
+            return m_limited.load(std::memory_order_relaxed) &&
+                   level <= m_limit_max_level.load(std::memory_order_relaxed);
+        }
+
+        // 自身的运行统计, 不包括子 logger
+        struct Metrics {
+            uint64_t events[5] = {};        //按级别统计写出的事件数, 下标为级别 - 1
+            uint64_t filtered = 0;          //被级别过滤掉的事件数
+            uint64_t rate_limited = 0;      //被限流丢弃的事件数, 不含采样
+        };
+
+        Metrics getMetrics() const;
+
+        // 由 SYLAR_LOG_* 宏在级别检查不通过时调用
+        void countFiltered() { m_counters.add(FILTERED); }
+
+        // 按生效的 appender 的格式采集事件, 格式中没有用到的时间, 线程和协程字段不采集
+        LogEvent::ptr captureEvent(const std::source_location &location) const {
+            return LogEvent::capture(location, getCaptureFields());
+        }
+
+        // 生效的 appender 需要采集的字段, 与级别一起按配置版本号缓存
+        uint32_t getCaptureFields() const {
+            uint64_t cached = m_capture_fields.load(std::memory_order_relaxed);
+            if ((cached >> 8) == s_generation.load(std::memory_order_acquire)) {
+                return (uint32_t) (cached & 0xff);
+            }
+            return refreshCaptureFields();
+        }
+
+        // %d 的时间使用 CLOCK_REALTIME_COARSE, 省去精确时钟的读取; 子 logger 随之使用
+        void setCoarseClock(bool coarse);
+
+        bool isCoarseClock() const { return m_coarse_clock.load(std::memory_order_relaxed); }
+
+        // 配置变化后使所有 logger 缓存的继承结果失效, 下一次使用时重新计算
+        static void bumpGeneration() { s_generation.fetch_add(1, std::memory_order_release); }
+
     private:
+        friend class LoggerManager;
+
+        // 级别和 appender 的继承结果按全局的配置版本号缓存, 任何 logger 修改级别或 appender 时版本号加一,
+        // 热路径上只比较版本号, 不遍历父 logger
+        struct AppenderCache {
+            uint64_t generation;
+            AppenderList appenders;
+        };
+
+        LogLevel::Level getEffectiveLevel() const {
+            uint64_t cached = m_effective_level.load(std::memory_order_relaxed);
+            if ((cached >> 8) == s_generation.load(std::memory_order_acquire)) {
+                return (LogLevel::Level) (cached & 0xff);
+            }
+            return refreshEffectiveLevel();
+        }
+
+        LogLevel::Level refreshEffectiveLevel() const;
+
+        uint32_t refreshCaptureFields() const;
+
+        // 自己的 appender 加上父 logger 生效的 appender(additive 时), 同一个 appender 只出现一次
+        std::shared_ptr<const AppenderCache> getEffectiveAppenders() const;
+
+        // 写到所有生效的 appender, 不再检查级别和限流
+        void dispatch(LogLevel::Level level, LogEvent::ptr event);
+
+        // 限流检查, site 为空时不限流; 放行时先输出之前被丢弃的条数
+        bool admit(LogLevel::Level level, LogSiteLimiter *site, std::string_view file_name, int32_t line);
+
+    private:
+        static std::atomic<uint64_t> s_generation;
+
+        // 前 5 个按级别计数
+        enum Counter {
+            FILTERED = 5,
+            RATE_LIMITED,
+            COUNTER_COUNT
+        };
+
         std::string m_name;
-        LogLevel::Level m_level;
-        std::unordered_set<LogAppender::ptr> m_appenders;
+        Logger *m_parent = nullptr;     //由 LoggerManager 在发布前设置, 之后不变
+        std::atomic<LogLevel::Level> m_level;           //单独设置的级别
+        std::atomic<bool> m_level_inherited{false};
+        std::atomic<bool> m_additive{true};
+        mutable std::atomic<uint64_t> m_effective_level{0};    //版本号 << 8 | 级别
+        mutable std::atomic<uint64_t> m_capture_fields{0};     //版本号 << 8 | 采集字段
+        std::atomic<bool> m_coarse_clock{false};
+        mutable AtomicSharedPtr<const AppenderCache> m_effective_appenders;
+        std::atomic<bool> m_limited{false};
+        std::atomic<uint32_t> m_limit_rate{0};
+        std::atomic<uint32_t> m_limit_burst{0};
+        std::atomic<uint32_t> m_limit_sample{0};
+        std::atomic<uint32_t> m_limit_coalesce_ms{0};
+        std::atomic<LogLevel::Level> m_limit_max_level{LogLevel::Level::ERROR};
+        // 写时复制: log() 只原子地读取快照, 增删 appender 时在 m_mutex 下复制一份再替换
+        AtomicSharedPtr<const AppenderList> m_appenders{std::make_shared<const AppenderList>()};
         LogFormatter::ptr log_formatter;
+        std::mutex m_mutex;
+        LogCounters<COUNTER_COUNT> m_counters;
     };
 
     class StdoutLogAppender : public LogAppender {
@@ -208,21 +733,190 @@ namespace sylar {
         typedef std::shared_ptr<StdoutLogAppender> ptr;
 
         void log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) override;
+
+        void flush() override;
+
+        bool canLogFormatted() const override { return true; }
+
+        void logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent::ptr &event,
+                          const Formatted &formatted) override;
+
+        const char *getType() const override { return "stdout"; }
+
+    private:
+        void write(std::string_view text, bool timed);
     };
 
+// 文件输出地
+// 事件先追加到用户态缓冲, 达到大小或时间阈值时才用 write(2) 写到 O_APPEND 打开的文件;
+// 写盘和切分文件在单独的 io 锁下进行, 其他线程在此期间继续向新的缓冲追加, 不会被磁盘阻塞
     class FileLogAppender : public LogAppender {
     public:
         typedef std::shared_ptr<FileLogAppender> ptr;
 
+        struct Options {
+            size_t buffer_size = 64 * 1024;         //缓冲达到该大小时写文件
+            uint32_t flush_interval_ms = 1000;      //缓冲中的数据最多停留的时间, 0 表示只按大小写
+            uint64_t max_file_size = 0;             //超过该大小时切分文件, 0 表示不按大小切分
+            uint32_t rotate_interval_s = 0;         //按本地时间对齐的切分周期, 如 3600 或 86400, 0 表示不按时间切分
+            uint32_t fsync_interval_ms = 0;         //距上次 fsync 超过该时间后写文件时 fsync, 0 表示不按时间
+            uint64_t fsync_bytes = 0;               //自上次 fsync 写入超过该字节数时 fsync, 0 表示不按大小
+            bool fsync_on_error = false;            //ERROR/FATAL 事件立即写文件并 fsync
+        };
+
+        explicit FileLogAppender(const std::string &file_name);
+
+        FileLogAppender(const std::string &file_name, const Options &options);
+
+        ~FileLogAppender() override;
+
         void log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) override;
 
+        bool canLogFormatted() const override { return true; }
+
+        void logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent::ptr &event,
+                          const Formatted &formatted) override;
+
+        // 把缓冲写到文件, 按 fsync 策略决定是否 fsync
+        void flush() override;
+
+        // 以追加方式重新打开文件, 用于外部 logrotate 移走文件之后
         bool reopen();
 
+        const Options &getOptions() const { return m_options; }
+
+        // 后台定时器调用, 处理时间阈值
+        void onTimer(uint64_t now_ms);
+
+        const char *getType() const override { return "file"; }
+
+    private:
+        // 追加一条格式化好的事件, 必要时写盘
+        void append(LogLevel::Level level, std::string_view text);
+
+        // force_sync 为 true 时无视策略直接 fsync
+        void writeBuffer(bool force_sync);
+
+        // 在 m_io_mutex 下调用, 写出整条块链, 全部写完返回 0, 否则返回 errno
+        int writeChain(ByteArray &chain);
+
+        // 在 m_io_mutex 下调用, 丢弃 events 条事件, 限频向 stderr 报告
+        void dropEvents(uint64_t events, int error);
+
+        bool openFile();
+
+        void rotate(uint64_t now_s);
+
+        uint64_t nextRotateTime(uint64_t now_s) const;
+
     private:
         std::string m_file_name;
-        std::ofstream m_filestream;
+        Options m_options;
+        // 以下由 LogAppender::m_mutex 保护
+        ByteArray m_buffer;                     //待写入的块链, 写盘时整条交给 writev
+        ByteArray m_spare;                      //写盘后回收的空缓冲, 保留段数组的容量
+        uint64_t m_buffer_since_ms = 0;         //缓冲中最早数据的时间
+        uint64_t m_buffer_events = 0;           //缓冲中的事件数
+        // 以下由 m_io_mutex 保护
+        std::mutex m_io_mutex;
+        ByteArray m_retry;                      //写失败时留下的块链, 下次写盘时先重试
+        uint64_t m_retry_events = 0;
+        uint64_t m_unreported_drops = 0;        //还没报告到 stderr 的丢弃事件数
+        uint64_t m_last_report_ms = 0;
+        int m_fd = -1;
+        uint64_t m_file_size = 0;
+        uint64_t m_next_rotate_s = 0;
+        uint64_t m_unsynced_bytes = 0;
+        uint64_t m_last_sync_ms = 0;
+    };
+
+// 异步日志输出地
+// 调用线程只把事件放进有界无锁队列, 由后台线程批量格式化并写到被包装的 appender
+    class AsyncLogAppender : public LogAppender {
+    public:
+        typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+        // 队列满时的处理策略
+        enum class OverflowPolicy {
+            BLOCK,          //等待后台线程腾出空间
+            DROP_NEWEST,    //丢弃当前事件
+            DROP_OLDEST     //丢弃队列中最旧的事件
+        };
+
+        // capacity 必须是 2 的幂
+        explicit AsyncLogAppender(LogAppender::ptr target, size_t capacity = 8192,
+                                  OverflowPolicy policy = OverflowPolicy::BLOCK, size_t batch_size = 256);
+
+        ~AsyncLogAppender() override;
+
+        void log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) override;
+
+        // 阻塞直到调用前入队的事件都已写出, 并 flush 被包装的 appender
+        void flush() override;
+
+        // 不阻塞的 flush, 调用前入队的事件都已写出并 flush 之后在后台线程中调用 cb
+        void flush(std::function<void()> cb);
+
+        // 停止后台线程, 剩余事件会先写完; 析构时自动调用
+        void stop();
+
+        // 被包装的 appender 没有自己的格式时沿用这里的格式
+        void setFormatter(LogFormatter::ptr val) override;
+
+        LogAppender::ptr getTarget() const { return m_target; }
+
+        OverflowPolicy getOverflowPolicy() const { return m_policy; }
+
+        uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+        // 队列长度为已入队还没有写出的事件数
+        Metrics getMetrics() const override;
+
+        const char *getType() const override { return "async"; }
+
+        // 事件由被包装的 appender 格式化
+        uint32_t getCaptureFields() const override { return m_target->getCaptureFields(); }
+
+    private:
+        struct Item {
+            std::shared_ptr<Logger> logger;
+            LogLevel::Level level = LogLevel::Level::DEBUG;
+            LogEvent::ptr event;
+        };
+
+        void run();
+
+        void wakeFlusher();
+
+        // 执行已经完成的 flush 回调, 需要持有 m_mutex, 回调执行期间会暂时释放
+        void runFlushCallbacks(std::unique_lock<std::mutex> &lock);
+
+    private:
+        LogAppender::ptr m_target;
+        OverflowPolicy m_policy;
+        size_t m_batch_size;
+        RingQueue<Item> m_queue;
+        alignas(64) std::atomic<uint64_t> m_processed{0};     //已写出或被丢弃的已入队事件数
+        alignas(64) std::atomic<uint64_t> m_dropped{0};
+        std::atomic<bool> m_flusher_sleeping{false};
+        std::atomic<uint32_t> m_blocked_producers{0};
+        std::atomic<bool> m_stopped{false};
+        std::atomic<uint32_t> m_pushing{0};                   //正在入队的生产者数
+        // 以下成员由 LogAppender::m_mutex 保护
+        uint64_t m_flush_target = 0;                          //flush 需要等待的入队进度
+        uint64_t m_flush_ticket = 0;
+        uint64_t m_flushed_ticket = 0;
+        std::vector<std::pair<uint64_t, std::function<void()>>> m_flush_callbacks;    //按票号递增
+        bool m_stopping = false;
+        std::condition_variable m_flusher_cond;
+        std::condition_variable m_producer_cond;
+        std::condition_variable m_flush_done_cond;
+        std::thread m_thread;
     };
 
+// logger 按点分的名字组成层级, 例如 net.http.conn 的父 logger 是 net.http, net 的父 logger 是 root;
+// 子 logger 默认继承父 logger 的级别, 事件除了自己的 appender 还会写到父 logger 的 appender.
+// logger 创建后不会被删除, 拿到的指针可以一直保存, 见 SYLAR_LOG_NAME
     class LoggerManager
     {
     public:
@@ -233,12 +927,23 @@ namespace sylar {
             static LoggerManager instance;
             return instance;
         }
+        // 不存在时连同缺少的上级一起创建; 空名字和 "root" 返回根 logger
         Logger::ptr getLogger(const std::string& name="root");
         Logger::ptr getRoot() const {return m_root;}
         void addLogger(const std::string& name);
+        // 按名字设置 logger 的限流, logger 不存在时创建
+        void setRateLimit(const std::string& name, const LogRateLimit& limit);
+        // 所有 logger 和 appender 的统计, Prometheus 文本格式; 被多个 logger 共用的 appender 只导出一次,
+        // AsyncLogAppender 包装的 appender 以 "<序号>/target" 单独导出
+        std::string getMetricsText() const;
     private:
         LoggerManager();
-        std::unordered_map<std::string, Logger::ptr> m_loggers;
+        typedef std::unordered_map<std::string, Logger::ptr> LoggerMap;
+        // 调用方持有 m_mutex, loggers 是正在构造的新表
+        Logger::ptr create(const std::string& name, LoggerMap& loggers);
+        // 写时复制, getLogger 不加锁
+        AtomicSharedPtr<const LoggerMap> m_loggers;
+        std::mutex m_mutex;
         Logger::ptr m_root;
     };
 
@@ -247,4 +952,67 @@ namespace sylar {
 
 
 }
+// 编译期最低日志级别(LogLevel::Level 的数值), 低于它的 SYLAR_LOG_* 语句不生成任何代码
+// 例: -DSYLAR_LOG_MIN_LEVEL=2 去掉所有 DEBUG 日志
+#ifndef SYLAR_LOG_MIN_LEVEL
+#define SYLAR_LOG_MIN_LEVEL 1
+#endif
+
+// 先检查级别再采集事件, 被过滤掉的语句不会分配内存也不会格式化参数;
+// 开启 FlightRecorder 时被过滤掉的语句只格式化到当前线程的飞行记录环里
+// 每个调用点有一份常量初始化的限流状态, logger 没有开启限流时只多读一个原子变量
+// 例: SYLAR_LOG_INFO(logger, "accept {} from {}", fd, addr);
+#define SYLAR_LOG_LEVEL(logger, level, format, ...) \
+    do { \
+        if constexpr ((int) (level) >= SYLAR_LOG_MIN_LEVEL) { \
+            const auto &sylar_log_logger = (logger); \
+            if (sylar_log_logger->isEnabled(level)) { \
+                static sylar::LogSiteLimiter sylar_log_site; \
+                sylar_log_logger->log(level, std::source_location::current(), sylar_log_site, format, ##__VA_ARGS__); \
+            } else { \
+                sylar_log_logger->countFiltered(); \
+                if (sylar::FlightRecorder::isEnabled()) { \
+                    sylar::FlightRecorder::record((int) (level), std::source_location::current(), \
+                                                  sylar_log_logger->getName(), format, ##__VA_ARGS__); \
+                } \
+            } \
+        } \
+    } while (0)
+
+#define SYLAR_LOG_ROOT() sylar::LoggerManager::getInstance().getRoot()
+
+// 按名字取 logger, 每个调用点只查找一次, 之后直接返回缓存的指针; name 应当是常量
+// 例: SYLAR_LOG_INFO(SYLAR_LOG_NAME("net.http"), "listen on {}", port);
+#define SYLAR_LOG_NAME(name) \
+    ([]() -> const sylar::Logger::ptr & { \
+        static const sylar::Logger::ptr sylar_log_named = sylar::LoggerManager::getInstance().getLogger(name); \
+        return sylar_log_named; \
+    }())
+
+// 结构化日志, 字段写成 {键, 值}, 由 JsonLogFormatter / LogfmtLogFormatter 或文本格式中的 %K 输出
+// 例: SYLAR_LOG_FIELDS(logger, sylar::LogLevel::Level::INFO, "request done", {"path", path}, {"status", 200});
+#define SYLAR_LOG_FIELDS(logger, level, message, ...) \
+    do { \
+        if constexpr ((int) (level) >= SYLAR_LOG_MIN_LEVEL) { \
+            const auto &sylar_log_logger = (logger); \
+            if (sylar_log_logger->isEnabled(level)) { \
+                static sylar::LogSiteLimiter sylar_log_site; \
+                sylar_log_logger->logFields(level, std::source_location::current(), sylar_log_site, message, \
+                                            {__VA_ARGS__}); \
+            } else { \
+                sylar_log_logger->countFiltered(); \
+                if (sylar::FlightRecorder::isEnabled()) { \
+                    sylar::FlightRecorder::record((int) (level), std::source_location::current(), \
+                                                  sylar_log_logger->getName(), "{}", message); \
+                } \
+            } \
+        } \
+    } while (0)
+
+#define SYLAR_LOG_DEBUG(logger, format, ...) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::DEBUG, format, ##__VA_ARGS__)
+#define SYLAR_LOG_INFO(logger, format, ...) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::INFO, format, ##__VA_ARGS__)
+#define SYLAR_LOG_WARN(logger, format, ...) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::WARN, format, ##__VA_ARGS__)
+#define SYLAR_LOG_ERROR(logger, format, ...) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::ERROR, format, ##__VA_ARGS__)
+#define SYLAR_LOG_FATAL(logger, format, ...) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::FATAL, format, ##__VA_ARGS__)
+
 #endif //SYLAR_WEB_SERVER_LOG_H
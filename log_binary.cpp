@@ -0,0 +1,283 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fmt/args.h>
+#include "log_binary.h"
+
+namespace sylar {
+
+    namespace binary_log {
+        namespace {
+            template<class T>
+            bool readRaw(std::string_view &in, T &value) {
+                if (in.size() < sizeof(T)) {
+                    return false;
+                }
+                memcpy(&value, in.data(), sizeof(T));
+                in.remove_prefix(sizeof(T));
+                return true;
+            }
+        }
+
+        void formatArgs(std::string_view format, std::string_view args, LogEvent::ContentBuffer &out) {
+            fmt::dynamic_format_arg_store<fmt::format_context> store;
+            while (!args.empty()) {
+                ArgType type;
+                bool ok = readRaw(args, type);
+                switch (type) {
+                    case ArgType::INT64: {
+                        int64_t v = 0;
+                        ok = ok && readRaw(args, v);
+                        store.push_back(v);
+                        break;
+                    }
+                    case ArgType::UINT64: {
+                        uint64_t v = 0;
+                        ok = ok && readRaw(args, v);
+                        store.push_back(v);
+                        break;
+                    }
+                    case ArgType::DOUBLE: {
+                        double v = 0;
+                        ok = ok && readRaw(args, v);
+                        store.push_back(v);
+                        break;
+                    }
+                    case ArgType::BOOL: {
+                        uint8_t v = 0;
+                        ok = ok && readRaw(args, v);
+                        store.push_back(v != 0);
+                        break;
+                    }
+                    case ArgType::CHAR: {
+                        char v = 0;
+                        ok = ok && readRaw(args, v);
+                        store.push_back(v);
+                        break;
+                    }
+                    case ArgType::STRING: {
+                        uint32_t len = 0;
+                        ok = ok && readRaw(args, len) && args.size() >= len;
+                        if (ok) {
+                            store.push_back(std::string(args.substr(0, len)));
+                            args.remove_prefix(len);
+                        }
+                        break;
+                    }
+                    case ArgType::POINTER: {
+                        uint64_t v = 0;
+                        ok = ok && readRaw(args, v);
+                        store.push_back((const void *) (uintptr_t) v);
+                        break;
+                    }
+                    default:
+                        ok = false;
+                        break;
+                }
+                if (!ok) {
+                    fmt::format_to(std::back_inserter(out), "<corrupted binary log args: {}>", format);
+                    return;
+                }
+            }
+            try {
+                fmt::vformat_to(std::back_inserter(out), format, store);
+            } catch (const fmt::format_error &e) {
+                fmt::format_to(std::back_inserter(out), "<bad binary log format \"{}\": {}>", format, e.what());
+            }
+        }
+    }
+
+    BinaryLogRegistry::BinaryLogRegistry() {
+        m_sites.push_back(Site{"{}", "", 0});
+    }
+
+    uint32_t BinaryLogRegistry::registerSite(std::string_view format, const std::source_location &location) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sites.push_back(Site{std::string(format), location.file_name(), location.line()});
+        return (uint32_t) m_sites.size() - 1;
+    }
+
+    bool BinaryLogRegistry::getSite(uint32_t id, Site &site) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (id >= m_sites.size()) {
+            return false;
+        }
+        site = m_sites[id];
+        return true;
+    }
+
+    uint32_t BinaryLogRegistry::size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (uint32_t) m_sites.size();
+    }
+
+    namespace {
+        template<class T>
+        void putRaw(std::string &buf, const T &value) {
+            buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void putString(std::string &buf, std::string_view str) {
+            putRaw(buf, (uint32_t) str.size());
+            buf.append(str.data(), str.size());
+        }
+    }
+
+    BinaryFileLogAppender::BinaryFileLogAppender(const std::string &file_name, size_t buffer_size)
+            : m_file_name(file_name), m_buffer_size(buffer_size) {
+        m_buffer.reserve(m_buffer_size);
+        reopen();
+    }
+
+    BinaryFileLogAppender::~BinaryFileLogAppender() {
+        flushBuffer();
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool BinaryFileLogAppender::reopen() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        flushBuffer();
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+        m_fd = open(m_file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        m_header_written = false;
+        m_sites_written.clear();
+        m_names.clear();
+        return m_fd >= 0;
+    }
+
+    void BinaryFileLogAppender::writeHeader() {
+        m_buffer.push_back('H');
+        m_buffer.append(binary_log::kMagic, sizeof(binary_log::kMagic));
+        putRaw(m_buffer, binary_log::kVersion);
+        auto formatter = getFormatter();
+        putString(m_buffer, formatter ? std::string_view(formatter->getPattern()) : std::string_view());
+        // 文件头带上当前已注册的调用点, 之后新注册的在第一次使用前写入
+        uint32_t count = BinaryLogRegistry::getInstance().size();
+        for (uint32_t i = 1; i < count; i++) {
+            defineSite(i);
+        }
+        m_header_written = true;
+    }
+
+    void BinaryFileLogAppender::defineSite(uint32_t site) {
+        if (site < m_sites_written.size() && m_sites_written[site]) {
+            return;
+        }
+        BinaryLogRegistry::Site info;
+        if (!BinaryLogRegistry::getInstance().getSite(site, info)) {
+            return;
+        }
+        if (m_sites_written.size() <= site) {
+            m_sites_written.resize(site + 1, false);
+        }
+        m_sites_written[site] = true;
+        m_buffer.push_back('S');
+        putRaw(m_buffer, site);
+        putString(m_buffer, info.format);
+        putString(m_buffer, info.file);
+        putRaw(m_buffer, info.line);
+    }
+
+    uint32_t BinaryFileLogAppender::internName(std::string_view name) {
+        // 透明查找, 命中时不构造临时字符串
+        auto it = m_names.find(name);
+        if (it != m_names.end()) {
+            return it->second;
+        }
+        uint32_t id = (uint32_t) m_names.size();
+        m_names.emplace(name, id);
+        m_buffer.push_back('N');
+        putRaw(m_buffer, id);
+        putString(m_buffer, name);
+        return id;
+    }
+
+    void BinaryFileLogAppender::log(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                    LogEvent::ptr event) {
+        if (level < m_level) {
+            return;
+        }
+        uint64_t begin = formatBegin();
+        // 锁外在调用线程的栈上编码事件的定长部分和参数, 锁内只登记调用点和名字并追加到文件缓冲
+        uint32_t site = event->getBinarySite();
+        std::string_view args;
+        LogEvent::ContentBuffer text_args;
+        if (site != binary_log::kTextSite) {
+            args = event->getBinaryArgs();
+        } else {
+            // 普通文本事件: 文件名, 行号和已经格式化好的内容作为参数
+            binary_log::encodeArg(text_args, event->getFileName());
+            binary_log::encodeArg(text_args, (int64_t) event->getLine());
+            binary_log::encodeArg(text_args, event->getContent());
+            args = std::string_view(text_args.data(), text_args.size());
+        }
+        char record[1 + 4 + 1 + 8 + 4 + 4 + 4 + 4];
+        char *p = record;
+        auto put = [&p](const auto &value) {
+            memcpy(p, &value, sizeof(value));
+            p += sizeof(value);
+        };
+        put('E');
+        put(site);
+        put((uint8_t) level);
+        put(event->getTime());
+        put(event->getTimeUsec());
+        put(event->getElapse());
+        put(event->getThreadId());
+        put(event->getFiberId());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_header_written) {
+            writeHeader();
+        }
+        if (site != binary_log::kTextSite) {
+            defineSite(site);
+        }
+        uint32_t logger_name = internName(logger->getName());
+        uint32_t thread_name = internName(event->getThreadName());
+        m_buffer.append(record, sizeof(record));
+        putRaw(m_buffer, logger_name);
+        putRaw(m_buffer, thread_name);
+        putString(m_buffer, args);
+        countEvent(begin);
+
+        if (m_buffer.size() >= m_buffer_size) {
+            flushBuffer();
+        }
+    }
+
+    void BinaryFileLogAppender::flush() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        flushBuffer();
+    }
+
+    void BinaryFileLogAppender::flushBuffer() {
+        if (m_buffer.empty()) {
+            return;
+        }
+        uint64_t write_begin = metrics::nowNs();
+        size_t offset = 0;
+        while (m_fd >= 0 && offset < m_buffer.size()) {
+            ssize_t n = ::write(m_fd, m_buffer.data() + offset, m_buffer.size() - offset);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            offset += (size_t) n;
+        }
+        countWrite(write_begin, offset);
+        m_buffer.clear();
+    }
+
+}
@@ -0,0 +1,206 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_LOG_BINARY_H
+#define SYLAR_WEB_SERVER_LOG_BINARY_H
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <source_location>
+#include "log.h"
+
+namespace sylar {
+
+// 二进制延迟格式化日志
+// 调用点只写入调用点 id 和参数的原始字节, 格式化推迟到读取时(文本 appender 或离线解码工具)
+//
+// 文件由若干块组成, 每块以 1 字节标记开头, 整数均为小端:
+//   'H' 文件头:   magic[8] version:u32 pattern:str
+//   'S' 调用点:   id:u32 format:str file:str line:u32
+//   'N' 名字:     id:u32 name:str
+//   'E' 事件:     site:u32 level:u8 time:u64 usec:u32 elapse:u32 thread:u32 fiber:u32
+//                logger_name:u32 thread_name:u32 args:str
+// str 为 u32 长度加内容. 重新打开文件追加时会再写一个 'H', 解码器遇到后重置调用点和名字表.
+    namespace binary_log {
+        constexpr char kMagic[8] = {'S', 'Y', 'L', 'A', 'R', 'B', 'L', '1'};
+        constexpr uint32_t kVersion = 1;
+
+        // 调用点 0 保留给普通文本事件, 参数为 文件名:str 行号:i64 内容:str
+        constexpr uint32_t kTextSite = 0;
+
+        // 参数类型标记
+        enum class ArgType : uint8_t {
+            INT64 = 1,
+            UINT64 = 2,
+            DOUBLE = 3,
+            BOOL = 4,
+            CHAR = 5,
+            STRING = 6,
+            POINTER = 7
+        };
+
+        template<class T>
+        inline void appendRaw(LogEvent::ContentBuffer &buf, const T &value) {
+            const char *p = reinterpret_cast<const char *>(&value);
+            buf.append(p, p + sizeof(T));
+        }
+
+        inline void appendString(LogEvent::ContentBuffer &buf, std::string_view str) {
+            appendRaw(buf, (uint32_t) str.size());
+            buf.append(str.data(), str.data() + str.size());
+        }
+
+        template<class T>
+        inline void encodeArg(LogEvent::ContentBuffer &buf, const T &value) {
+            typedef std::decay_t<T> U;
+            if constexpr (std::is_same_v<U, bool>) {
+                appendRaw(buf, ArgType::BOOL);
+                appendRaw(buf, (uint8_t) value);
+            } else if constexpr (std::is_same_v<U, char>) {
+                appendRaw(buf, ArgType::CHAR);
+                appendRaw(buf, value);
+            } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+                appendRaw(buf, ArgType::INT64);
+                appendRaw(buf, (int64_t) value);
+            } else if constexpr (std::is_integral_v<U> || std::is_enum_v<U>) {
+                appendRaw(buf, ArgType::UINT64);
+                appendRaw(buf, (uint64_t) value);
+            } else if constexpr (std::is_floating_point_v<U>) {
+                appendRaw(buf, ArgType::DOUBLE);
+                appendRaw(buf, (double) value);
+            } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+                appendRaw(buf, ArgType::STRING);
+                appendString(buf, std::string_view(value));
+            } else if constexpr (std::is_pointer_v<U>) {
+                appendRaw(buf, ArgType::POINTER);
+                appendRaw(buf, (uint64_t) (uintptr_t) value);
+            } else {
+                // 其他类型在调用点格式化成字符串
+                appendRaw(buf, ArgType::STRING);
+                appendString(buf, fmt::format("{}", value));
+            }
+        }
+
+        // 用 format 解码 args 中的参数并格式化追加到 out; 参数损坏或格式不匹配时写入错误提示
+        void formatArgs(std::string_view format, std::string_view args, LogEvent::ContentBuffer &out);
+    }
+
+// 调用点注册表, 进程内全局; id 在调用点第一次执行时分配
+    class BinaryLogRegistry {
+    public:
+        struct Site {
+            std::string format;
+            std::string file;
+            uint32_t line = 0;
+        };
+
+        static BinaryLogRegistry &getInstance() {
+            static BinaryLogRegistry instance;
+            return instance;
+        }
+
+        uint32_t registerSite(std::string_view format, const std::source_location &location);
+
+        // id 不存在时返回 false
+        bool getSite(uint32_t id, Site &site) const;
+
+        // 已注册的调用点数量(含保留的 0 号)
+        uint32_t size() const;
+
+    private:
+        BinaryLogRegistry();
+
+        mutable std::mutex m_mutex;
+        std::deque<Site> m_sites;
+    };
+
+// 二进制日志文件输出地, 与 FileLogAppender 并列使用
+// 只写调用点 id 和原始参数, 由 sylar_log_decode 离线还原成文本; 文件头记录本 appender 的格式模式
+// 事件在调用线程上编码, 所有线程共用一个文件缓冲, 锁内只做调用点/名字登记和一次追加;
+// 没有做每线程的文件缓冲, 那样文件中各线程的事件会按批次乱序, reopen() 后名字表也要按线程重建
+    class BinaryFileLogAppender : public LogAppender {
+    public:
+        typedef std::shared_ptr<BinaryFileLogAppender> ptr;
+
+        explicit BinaryFileLogAppender(const std::string &file_name, size_t buffer_size = 64 * 1024);
+
+        ~BinaryFileLogAppender() override;
+
+        void log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) override;
+
+        void flush() override;
+
+        // 以追加方式重新打开, 下一条事件前会重新写文件头
+        bool reopen();
+
+        const char *getType() const override { return "binary_file"; }
+
+        // 每条记录都直接写时间, 耗时, 线程和协程, 与格式模式无关
+        uint32_t getCaptureFields() const override { return LogEvent::CAPTURE_ALL; }
+
+    private:
+        void writeHeader();
+
+        void defineSite(uint32_t site);
+
+        uint32_t internName(std::string_view name);
+
+        void flushBuffer();
+
+        struct StringHash {
+            typedef void is_transparent;
+
+            size_t operator()(std::string_view str) const { return std::hash<std::string_view>()(str); }
+        };
+
+    private:
+        std::string m_file_name;
+        int m_fd = -1;
+        size_t m_buffer_size;
+        std::string m_buffer;
+        bool m_header_written = false;
+        std::vector<bool> m_sites_written;                      //本文件已经写过定义的调用点
+        std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> m_names;     //本文件的名字表
+    };
+
+// 把参数编码进事件, 不做任何格式化; 格式串在编译期检查
+    template<class... Args>
+    inline void encodeBinaryArgs(LogEvent &event, uint32_t site, fmt::format_string<Args...>, const Args &... args) {
+        LogEvent::ContentBuffer &buf = event.beginBinary(site);
+        (binary_log::encodeArg(buf, args), ...);
+        event.endBinary();
+    }
+
+}
+
+// 二进制模式的日志调用, 例: SYLAR_LOG_BIN(logger, sylar::LogLevel::Level::INFO, "recv {} bytes from {}", n, ip);
+// 写到 BinaryFileLogAppender 时只记录调用点 id 和参数, 写到文本 appender 时在格式化阶段才生成消息
+#define SYLAR_LOG_BIN(logger, level, format, ...) \
+    do { \
+        if constexpr ((int) (level) >= SYLAR_LOG_MIN_LEVEL) { \
+            static const uint32_t sylar_bin_site = \
+                sylar::BinaryLogRegistry::getInstance().registerSite(format, std::source_location::current()); \
+            const auto &sylar_bin_logger = (logger); \
+            if (sylar_bin_logger->isEnabled(level)) { \
+                auto sylar_bin_event = sylar_bin_logger->captureEvent(std::source_location::current()); \
+                sylar::encodeBinaryArgs(*sylar_bin_event, sylar_bin_site, format, ##__VA_ARGS__); \
+                sylar_bin_logger->log(level, sylar_bin_event); \
+            } else { \
+                sylar_bin_logger->countFiltered(); \
+                if (sylar::FlightRecorder::isEnabled()) { \
+                    sylar::FlightRecorder::record((int) (level), std::source_location::current(), \
+                                                  sylar_bin_logger->getName(), format, ##__VA_ARGS__); \
+                } \
+            } \
+        } \
+    } while (0)
+
+#endif //SYLAR_WEB_SERVER_LOG_BINARY_H
@@ -0,0 +1,208 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+// 把 BinaryFileLogAppender 写出的二进制日志还原成文本
+// 用法: sylar_log_decode <binary log file> [pattern]
+// 不指定 pattern 时使用文件头中记录的格式模式
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include "log_binary.h"
+
+namespace {
+
+    class Reader {
+    public:
+        explicit Reader(std::string_view data) : m_data(data) {}
+
+        bool eof() const { return m_data.empty(); }
+
+        size_t remaining() const { return m_data.size(); }
+
+        template<class T>
+        bool read(T &value) {
+            if (m_data.size() < sizeof(T)) {
+                return false;
+            }
+            memcpy(&value, m_data.data(), sizeof(T));
+            m_data.remove_prefix(sizeof(T));
+            return true;
+        }
+
+        bool readString(std::string_view &str) {
+            uint32_t len = 0;
+            if (!read(len) || m_data.size() < len) {
+                return false;
+            }
+            str = m_data.substr(0, len);
+            m_data.remove_prefix(len);
+            return true;
+        }
+
+        bool readBytes(char *out, size_t n) {
+            if (m_data.size() < n) {
+                return false;
+            }
+            memcpy(out, m_data.data(), n);
+            m_data.remove_prefix(n);
+            return true;
+        }
+
+    private:
+        std::string_view m_data;
+    };
+
+    struct Site {
+        std::string format;
+        std::string file;
+        uint32_t line = 0;
+    };
+
+    bool decodeEvent(Reader &reader, const std::unordered_map<uint32_t, Site> &sites,
+                     const std::unordered_map<uint32_t, std::string> &names,
+                     std::unordered_map<uint32_t, ThreadInfo> &threads,
+                     std::unordered_map<std::string, sylar::Logger::ptr> &loggers,
+                     sylar::LogFormatter &formatter, fmt::memory_buffer &out) {
+        uint32_t site_id = 0, usec = 0, elapse = 0, thread_id = 0, fiber_id = 0, logger_name = 0, thread_name = 0;
+        uint8_t level = 0;
+        uint64_t time = 0;
+        std::string_view args;
+        if (!reader.read(site_id) || !reader.read(level) || !reader.read(time) || !reader.read(usec) ||
+            !reader.read(elapse) || !reader.read(thread_id) || !reader.read(fiber_id) ||
+            !reader.read(logger_name) || !reader.read(thread_name) || !reader.readString(args)) {
+            return false;
+        }
+
+        auto name_it = names.find(logger_name);
+        std::string name = name_it == names.end() ? "unknown" : name_it->second;
+        auto &logger = loggers[name];
+        if (!logger) {
+            logger.reset(new sylar::Logger(name));
+        }
+
+        auto event = std::make_shared<sylar::LogEvent>("", 0, elapse, thread_id, fiber_id, time, usec);
+        auto thread_it = names.find(thread_name);
+        if (thread_it != names.end()) {
+            auto &info = threads[thread_name];
+            info.name = thread_it->second;
+            event->setThreadInfo(&info);
+        }
+
+        sylar::LogEvent::ContentBuffer content;
+        if (site_id == sylar::binary_log::kTextSite) {
+            // 文件名, 行号, 内容
+            Reader arg_reader(args);
+            uint8_t type;
+            std::string_view file, text;
+            int64_t line = 0;
+            if (!arg_reader.read(type) || !arg_reader.readString(file) || !arg_reader.read(type) ||
+                !arg_reader.read(line) || !arg_reader.read(type) || !arg_reader.readString(text)) {
+                return false;
+            }
+            event->setFileName(std::string(file));
+            event->setLine((int32_t) line);
+            content.append(text);
+        } else {
+            auto site_it = sites.find(site_id);
+            if (site_it == sites.end()) {
+                fmt::format_to(std::back_inserter(content), "<unknown binary log site {}>", site_id);
+            } else {
+                event->setFileName(site_it->second.file);
+                event->setLine((int32_t) site_it->second.line);
+                sylar::binary_log::formatArgs(site_it->second.format, args, content);
+            }
+        }
+        event->setContent(std::string_view(content.data(), content.size()));
+        formatter.format(out, logger, (sylar::LogLevel::Level) level, event);
+        return true;
+    }
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <binary log file> [pattern]\n", argv[0]);
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string user_pattern = argc > 2 ? argv[2] : "";
+
+    Reader reader(data);
+    std::unordered_map<uint32_t, Site> sites;
+    std::unordered_map<uint32_t, std::string> names;
+    std::unordered_map<uint32_t, ThreadInfo> threads;      //线程名, 供事件引用
+    std::unordered_map<std::string, sylar::Logger::ptr> loggers;
+    sylar::LogFormatter::ptr formatter;
+    fmt::memory_buffer out;
+
+    while (!reader.eof()) {
+        char tag = 0;
+        reader.read(tag);
+        bool ok = true;
+        switch (tag) {
+            case 'H': {
+                char magic[sizeof(sylar::binary_log::kMagic)];
+                uint32_t version = 0;
+                std::string_view pattern;
+                ok = reader.readBytes(magic, sizeof(magic)) &&
+                     memcmp(magic, sylar::binary_log::kMagic, sizeof(magic)) == 0 &&
+                     reader.read(version) && version == sylar::binary_log::kVersion && reader.readString(pattern);
+                if (ok) {
+                    names.clear();
+                    sites.clear();
+                    std::string p = !user_pattern.empty() ? user_pattern : std::string(pattern);
+                    formatter = p.empty() ? std::make_shared<sylar::LogFormatter>()
+                                          : std::make_shared<sylar::LogFormatter>(p);
+                }
+                break;
+            }
+            case 'S': {
+                uint32_t id = 0;
+                std::string_view format, file;
+                Site site;
+                ok = reader.read(id) && reader.readString(format) && reader.readString(file) &&
+                     reader.read(site.line);
+                if (ok) {
+                    site.format = format;
+                    site.file = file;
+                    sites[id] = site;
+                }
+                break;
+            }
+            case 'N': {
+                uint32_t id = 0;
+                std::string_view name;
+                ok = reader.read(id) && reader.readString(name);
+                if (ok) {
+                    names[id] = name;
+                }
+                break;
+            }
+            case 'E':
+                ok = formatter && decodeEvent(reader, sites, names, threads, loggers, *formatter, out);
+                if (out.size() >= 64 * 1024) {
+                    fwrite(out.data(), 1, out.size(), stdout);
+                    out.clear();
+                }
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) {
+            fwrite(out.data(), 1, out.size(), stdout);
+            fprintf(stderr, "corrupted binary log near offset %zu\n", data.size() - reader.remaining());
+            return 2;
+        }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
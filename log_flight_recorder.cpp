@@ -0,0 +1,448 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "log_flight_recorder.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include "utils.h"
+
+namespace sylar {
+
+    namespace {
+        struct Record {
+            std::atomic<uint32_t> seq;      //写入中为奇数, 写完为 2 * 序号 + 2
+            uint8_t level;
+            uint8_t file_len;
+            uint8_t logger_len;
+            uint8_t reserved;
+            uint16_t message_len;
+            uint16_t reserved2;
+            uint32_t line;
+            uint32_t fiber_id;
+            uint64_t time_us;
+            char file[FlightRecorder::kFileSize];
+            char logger[FlightRecorder::kLoggerSize];
+            char message[FlightRecorder::kMessageSize];
+        };
+
+        static_assert(sizeof(Record) == FlightRecorder::kRecordSize, "flight recorder record size changed");
+
+        constexpr size_t kAltStackSize = 64 * 1024;
+        constexpr int kSignals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+        constexpr size_t kSignalCount = sizeof(kSignals) / sizeof(kSignals[0]);
+
+        char s_dump_path[512];
+        struct sigaction s_old_actions[kSignalCount];
+        std::mutex s_enable_mutex;
+        bool s_handlers_installed = false;
+        std::atomic<size_t> s_capacity{256};
+        std::atomic<uint32_t> s_dump_owner{0};
+
+        uint32_t rawThreadId() {
+            return (uint32_t) syscall(SYS_gettid);
+        }
+    }
+
+    struct FlightRecorder::Ring {
+        Ring *next = nullptr;                   //发布到全局链表后不变
+        std::atomic<bool> in_use{true};
+        std::atomic<const ThreadInfo *> thread{nullptr};    //持有引用
+        std::atomic<uint64_t> head{0};          //下一条记录的序号
+        size_t capacity = 0;
+        Record *records = nullptr;
+        char *alt_stack = nullptr;
+    };
+
+    namespace {
+        // 所有环组成的链表, 只增不删, 信号处理函数可以无锁遍历
+        std::atomic<FlightRecorder::Ring *> s_rings{nullptr};
+
+        thread_local FlightRecorder::Ring *t_ring = nullptr;
+
+        // 线程退出时交还环
+        struct RingReleaser {
+            ~RingReleaser() {
+                if (t_ring) {
+                    t_ring->in_use.store(false, std::memory_order_release);
+                    t_ring = nullptr;
+                }
+            }
+        };
+
+        // 信号处理时所在的栈可能已经溢出(例如协程栈), 每个线程准备一个备用栈
+        void installAltStack(FlightRecorder::Ring *ring) {
+            stack_t current;
+            if (sigaltstack(nullptr, &current) == 0 && !(current.ss_flags & SS_DISABLE)) {
+                return;
+            }
+            if (!ring->alt_stack) {
+                ring->alt_stack = new(std::nothrow) char[kAltStackSize];
+                if (!ring->alt_stack) {
+                    return;
+                }
+            }
+            stack_t stack;
+            stack.ss_sp = ring->alt_stack;
+            stack.ss_size = kAltStackSize;
+            stack.ss_flags = 0;
+            sigaltstack(&stack, nullptr);
+        }
+
+        FlightRecorder::Ring *threadRing() {
+            if (t_ring) {
+                return t_ring;
+            }
+            static thread_local RingReleaser releaser;
+            (void) releaser;
+            FlightRecorder::Ring *ring = nullptr;
+            // 优先复用已退出线程的环
+            for (auto *item = s_rings.load(std::memory_order_acquire); item; item = item->next) {
+                bool in_use = false;
+                if (!item->in_use.load(std::memory_order_relaxed) &&
+                    item->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+                    ring = item;
+                    break;
+                }
+            }
+            if (ring) {
+                // 旧记录的序号与新的序号对不上, 转储时会被跳过
+                ring->head.store(0, std::memory_order_relaxed);
+            } else {
+                ring = new(std::nothrow) FlightRecorder::Ring;
+                if (!ring) {
+                    return nullptr;
+                }
+                ring->capacity = std::max<size_t>(s_capacity.load(std::memory_order_relaxed), 1);
+                ring->records = new(std::nothrow) Record[ring->capacity];
+                if (!ring->records) {
+                    delete ring;
+                    return nullptr;
+                }
+                ring->next = s_rings.load(std::memory_order_relaxed);
+                while (!s_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release)) {
+                }
+            }
+            // 环持有线程身份的引用, 线程退出后转储仍能显示它的名字; 环被新线程复用时才释放
+            const ThreadInfo *thread = &getThreadInfo();
+            retainThreadInfo(thread);
+            if (const ThreadInfo *prev = ring->thread.exchange(thread, std::memory_order_acq_rel)) {
+                releaseThreadInfo(prev);
+            }
+            installAltStack(ring);
+            t_ring = ring;
+            return ring;
+        }
+
+        // 截断时保留结尾, 文件名最有用的部分在最后
+        uint8_t copyTail(char *dst, size_t capacity, std::string_view str) {
+            if (str.size() > capacity) {
+                str.remove_prefix(str.size() - capacity);
+            }
+            memcpy(dst, str.data(), str.size());
+            return (uint8_t) str.size();
+        }
+
+        // 以下用于转储, 只使用异步信号安全的操作
+        class DumpWriter {
+        public:
+            explicit DumpWriter(int fd) : m_fd(fd) {}
+
+            ~DumpWriter() { flush(); }
+
+            void append(std::string_view str) {
+                while (!str.empty()) {
+                    if (m_len == sizeof(m_buf)) {
+                        flush();
+                    }
+                    size_t n = std::min(str.size(), sizeof(m_buf) - m_len);
+                    memcpy(m_buf + m_len, str.data(), n);
+                    m_len += n;
+                    str.remove_prefix(n);
+                }
+            }
+
+            void append(const char *str) { append(std::string_view(str, strlen(str))); }
+
+            void appendUint(uint64_t value, int width = 0) {
+                char tmp[24];
+                int n = 0;
+                do {
+                    tmp[n++] = (char) ('0' + value % 10);
+                    value /= 10;
+                } while (value);
+                while (n < width) {
+                    tmp[n++] = '0';
+                }
+                char out[24];
+                for (int i = 0; i < n; i++) {
+                    out[i] = tmp[n - 1 - i];
+                }
+                append(std::string_view(out, n));
+            }
+
+            // UTC 时间, localtime_r 会加锁, 不能在信号处理函数中调用
+            void appendTime(uint64_t time_us) {
+                uint64_t seconds = time_us / 1000000;
+                int64_t days = (int64_t) (seconds / 86400);
+                uint64_t rest = seconds % 86400;
+                // days_from_civil 的逆运算
+                days += 719468;
+                int64_t era = days / 146097;
+                uint64_t doe = (uint64_t) (days - era * 146097);
+                uint64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+                uint64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+                uint64_t mp = (5 * doy + 2) / 153;
+                uint64_t day = doy - (153 * mp + 2) / 5 + 1;
+                uint64_t month = mp < 10 ? mp + 3 : mp - 9;
+                uint64_t year = yoe + (uint64_t) era * 400 + (month <= 2);
+                appendUint(year, 4);
+                append("-");
+                appendUint(month, 2);
+                append("-");
+                appendUint(day, 2);
+                append("T");
+                appendUint(rest / 3600, 2);
+                append(":");
+                appendUint(rest / 60 % 60, 2);
+                append(":");
+                appendUint(rest % 60, 2);
+                append(".");
+                appendUint(time_us % 1000000, 6);
+                append("Z");
+            }
+
+            void flush() {
+                size_t done = 0;
+                while (done < m_len) {
+                    // 直接发起系统调用: 在启用 hook 的协程里 write 会被换成挂起协程的版本, 信号处理函数中不能那样做
+                    ssize_t n = syscall(SYS_write, m_fd, m_buf + done, m_len - done);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        break;
+                    }
+                    done += (size_t) n;
+                }
+                m_len = 0;
+            }
+
+        private:
+            int m_fd;
+            size_t m_len = 0;
+            char m_buf[4096];
+        };
+
+        const char *levelName(uint8_t level) {
+            static const char *const kNames[] = {"UNKNOWN", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+            return level < sizeof(kNames) / sizeof(kNames[0]) ? kNames[level] : kNames[0];
+        }
+
+        void dumpRing(DumpWriter &out, FlightRecorder::Ring *ring) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            if (head == 0) {
+                return;
+            }
+            const ThreadInfo *thread = ring->thread.load(std::memory_order_acquire);
+            out.append("--- thread ");
+            out.appendUint(thread ? thread->tid : 0);
+            if (thread && !thread->name.empty()) {
+                out.append(" ");
+                out.append(std::string_view(thread->name));
+            }
+            if (!ring->in_use.load(std::memory_order_relaxed)) {
+                out.append(" (exited)");
+            }
+            out.append(" ---\n");
+            uint64_t begin = head > ring->capacity ? head - ring->capacity : 0;
+            for (uint64_t i = begin; i < head; i++) {
+                Record &record = ring->records[i % ring->capacity];
+                uint32_t seq = record.seq.load(std::memory_order_acquire);
+                if (seq != (uint32_t) (2 * i + 2)) {
+                    continue;
+                }
+                // 顺序锁: 拷贝前后序号一致才说明没有被同时改写
+                Record copy;
+                memcpy((char *) &copy + sizeof(copy.seq), (const char *) &record + sizeof(record.seq),
+                       sizeof(Record) - sizeof(record.seq));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (record.seq.load(std::memory_order_relaxed) != seq) {
+                    continue;
+                }
+                out.appendTime(copy.time_us);
+                out.append(" ");
+                out.append(levelName(copy.level));
+                out.append(" [");
+                out.append(std::string_view(copy.logger, copy.logger_len));
+                out.append("] fiber=");
+                out.appendUint(copy.fiber_id);
+                out.append(" ");
+                out.append(std::string_view(copy.file, copy.file_len));
+                out.append(":");
+                out.appendUint(copy.line);
+                out.append(" ");
+                out.append(std::string_view(copy.message, copy.message_len));
+                out.append("\n");
+            }
+        }
+
+        const char *signalName(int sig) {
+            switch (sig) {
+                case SIGSEGV:
+                    return "SIGSEGV";
+                case SIGABRT:
+                    return "SIGABRT";
+                case SIGBUS:
+                    return "SIGBUS";
+                case SIGFPE:
+                    return "SIGFPE";
+                case SIGILL:
+                    return "SIGILL";
+                default:
+                    return "signal";
+            }
+        }
+
+        void onCrashSignal(int sig, siginfo_t *, void *) {
+            int saved_errno = errno;
+            FlightRecorder::dump(signalName(sig));
+            // 恢复原来的处理方式后重新发出, 信号在本函数返回后递送
+            for (size_t i = 0; i < kSignalCount; i++) {
+                if (kSignals[i] == sig) {
+                    sigaction(sig, &s_old_actions[i], nullptr);
+                    break;
+                }
+            }
+            raise(sig);
+            errno = saved_errno;
+        }
+    }
+
+    std::atomic<bool> FlightRecorder::s_enabled{false};
+
+    void FlightRecorder::enable(const std::string &dump_path, size_t records_per_thread) {
+        std::lock_guard<std::mutex> lock(s_enable_mutex);
+        size_t len = std::min(dump_path.size(), sizeof(s_dump_path) - 1);
+        memcpy(s_dump_path, dump_path.data(), len);
+        s_dump_path[len] = '\0';
+        s_capacity.store(records_per_thread, std::memory_order_relaxed);
+        if (!s_handlers_installed) {
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_sigaction = &onCrashSignal;
+            action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+            sigemptyset(&action.sa_mask);
+            for (size_t i = 0; i < kSignalCount; i++) {
+                sigaction(kSignals[i], &action, &s_old_actions[i]);
+            }
+            s_handlers_installed = true;
+        }
+        s_enabled.store(true, std::memory_order_release);
+    }
+
+    void FlightRecorder::disable() {
+        s_enabled.store(false, std::memory_order_relaxed);
+    }
+
+    FlightRecorder::Slot FlightRecorder::acquire() {
+        Ring *ring = threadRing();
+        if (!ring) {
+            return {nullptr, 0, nullptr};
+        }
+        // 先推进 head 再写, 同一线程上的信号处理函数即使也写日志也不会拿到同一个槽
+        uint64_t index = ring->head.load(std::memory_order_relaxed);
+        ring->head.store(index + 1, std::memory_order_relaxed);
+        Record &record = ring->records[index % ring->capacity];
+        record.seq.store((uint32_t) (2 * index + 1), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return {ring, index, record.message};
+    }
+
+    void FlightRecorder::commit(const Slot &slot, int level, std::string_view file, uint32_t line,
+                                std::string_view logger, size_t message_len, uint64_t time_us) {
+        Record &record = slot.ring->records[slot.index % slot.ring->capacity];
+        if (!time_us) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            time_us = (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+        }
+        record.level = (uint8_t) level;
+        record.line = line;
+        record.fiber_id = (uint32_t) getFiberId();
+        record.time_us = time_us;
+        record.file_len = copyTail(record.file, kFileSize, file);
+        record.logger_len = (uint8_t) std::min(logger.size(), kLoggerSize);
+        memcpy(record.logger, logger.data(), record.logger_len);
+        record.message_len = (uint16_t) message_len;
+        record.seq.store((uint32_t) (2 * slot.index + 2), std::memory_order_release);
+    }
+
+    void FlightRecorder::record(int level, std::string_view file, uint32_t line, std::string_view logger,
+                                std::string_view message, uint64_t time_us) {
+        Slot slot = acquire();
+        if (!slot.message) {
+            return;
+        }
+        size_t len = std::min(message.size(), kMessageSize);
+        memcpy(slot.message, message.data(), len);
+        commit(slot, level, file, line, logger, len, time_us);
+    }
+
+    void FlightRecorder::dump(const char *reason) {
+        if (!s_dump_path[0]) {
+            return;
+        }
+        int fd = ::open(s_dump_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return;
+        }
+        dumpTo(fd, reason);
+        syscall(SYS_close, fd);
+    }
+
+    void FlightRecorder::dumpTo(int fd, const char *reason) {
+        uint32_t tid = rawThreadId();
+        uint32_t owner = 0;
+        if (!s_dump_owner.compare_exchange_strong(owner, tid, std::memory_order_acquire)) {
+            if (owner == tid) {
+                // 转储过程中本线程又崩溃了
+                return;
+            }
+            // 其他线程正在转储, 等它写完再让进程退出, 最多等 2 秒
+            for (int i = 0; i < 200 && s_dump_owner.load(std::memory_order_acquire) != 0; i++) {
+                struct timespec ts = {0, 10 * 1000 * 1000};
+                syscall(SYS_clock_nanosleep, CLOCK_MONOTONIC, 0, &ts, nullptr);
+            }
+            return;
+        }
+        {
+            DumpWriter out(fd);
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            out.append("=== flight recorder dump: ");
+            out.append(reason ? reason : "manual");
+            out.append(" pid=");
+            out.appendUint((uint64_t) getpid());
+            out.append(" thread=");
+            out.appendUint(tid);
+            out.append(" time=");
+            out.appendTime((uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000);
+            out.append(" ===\n");
+            for (Ring *ring = s_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+                dumpRing(out, ring);
+            }
+            out.append("=== end of flight recorder dump ===\n");
+        }
+        s_dump_owner.store(0, std::memory_order_release);
+    }
+
+}
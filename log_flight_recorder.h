@@ -0,0 +1,85 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_LOG_FLIGHT_RECORDER_H
+#define SYLAR_WEB_SERVER_LOG_FLIGHT_RECORDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <source_location>
+#include <fmt/format.h>
+
+namespace sylar {
+
+// 飞行记录器: 每个线程在预分配的环里保留最近的日志事件, 包括低于 logger 级别而没有输出的事件,
+// 这样线上用 INFO 级别运行, 崩溃时仍能看到之前的 DEBUG 日志.
+// 写入只做格式化/拷贝到定长的槽, 不加锁不分配; 消息超过槽的长度时截断.
+// FATAL 日志或 SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL 时把所有线程的环以文本追加到转储文件,
+// 转储只使用异步信号安全的系统调用, 不经过 appender; 信号处理完后交还给原来的处理函数.
+// 线程退出后它的环留给之后的新线程复用, 内存不会随线程的创建销毁增长.
+    class FlightRecorder {
+    public:
+        static constexpr size_t kRecordSize = 256;
+        static constexpr size_t kFileSize = 40;         //只保留文件路径的最后部分
+        static constexpr size_t kLoggerSize = 24;
+        static constexpr size_t kMessageSize = kRecordSize - 32 - kFileSize - kLoggerSize;
+
+        // 开启记录并安装信号处理函数, 每个线程的环有 records_per_thread 条记录;
+        // 已经创建的环保持原来的大小
+        static void enable(const std::string &dump_path, size_t records_per_thread = 256);
+
+        // 停止记录, 信号处理函数保留, 转储时环中已有的记录仍然输出
+        static void disable();
+
+        static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        // 记录一条已经格式化好的事件, time_us 为 0 时取当前时间
+        static void record(int level, std::string_view file, uint32_t line, std::string_view logger,
+                           std::string_view message, uint64_t time_us = 0);
+
+        // 被级别过滤掉的事件直接格式化到槽里, 不构造 LogEvent
+        template<class... Args>
+        static void record(int level, const std::source_location &location, std::string_view logger,
+                           fmt::format_string<Args...> fmt, Args &&... args) {
+            Slot slot = acquire();
+            if (!slot.message) {
+                return;
+            }
+            auto result = fmt::format_to_n(slot.message, kMessageSize, fmt, std::forward<Args>(args)...);
+            commit(slot, level, location.file_name(), location.line(), logger,
+                   std::min(result.size, kMessageSize), 0);
+        }
+
+        // 把所有线程的环写到 enable() 指定的文件, reason 写在转储的开头; 异步信号安全
+        static void dump(const char *reason);
+
+        // 同上, 写到已经打开的 fd
+        static void dumpTo(int fd, const char *reason);
+
+        // 每个线程的环, 定义在 log_flight_recorder.cpp 中
+        struct Ring;
+
+    private:
+        // 当前线程环中的下一个槽, 环不可用时 message 为空
+        struct Slot {
+            Ring *ring;
+            uint64_t index;
+            char *message;
+        };
+
+        static Slot acquire();
+
+        static void commit(const Slot &slot, int level, std::string_view file, uint32_t line,
+                           std::string_view logger, size_t message_len, uint64_t time_us);
+
+        static std::atomic<bool> s_enabled;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_LOG_FLIGHT_RECORDER_H
@@ -0,0 +1,214 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "log_metrics.h"
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include "log.h"
+
+namespace sylar {
+
+    using namespace std::string_view_literals;
+
+    uint64_t metrics::nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    }
+
+    uint64_t LogHistogram::bucketLimit(size_t index) {
+        if (index < kSubBuckets) {
+            return index + 1;
+        }
+        if (index >= kBuckets - 1) {
+            return UINT64_MAX;
+        }
+        size_t exponent = index / kSubBuckets + 1;
+        uint64_t sub = index % kSubBuckets;
+        return (kSubBuckets + sub + 1) << (exponent - 2);
+    }
+
+    LogHistogram::Snapshot LogHistogram::snapshot() const {
+        Snapshot snapshot;
+        for (auto &shard: m_shards) {
+            snapshot.count += shard.count.load(std::memory_order_relaxed);
+            snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < kBuckets; i++) {
+                snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+            }
+        }
+        return snapshot;
+    }
+
+    uint64_t LogHistogram::Snapshot::percentile(double q) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t target = std::max<uint64_t>((uint64_t) std::ceil(std::clamp(q, 0.0, 1.0) * (double) count), 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += buckets[i];
+            if (seen >= target) {
+                return bucketLimit(i);
+            }
+        }
+        return bucketLimit(kBuckets - 1);
+    }
+
+    uint64_t LogHistogram::Snapshot::countBelow(uint64_t bound) const {
+        uint64_t result = 0;
+        for (size_t i = 0; i < kBuckets && bucketLimit(i) <= bound; i++) {
+            result += buckets[i];
+        }
+        return result;
+    }
+
+    namespace {
+        // 导出的直方图边界: 256ns 到约 1s 之间的 2 的幂
+        constexpr int kFirstBoundExp = 8;
+        constexpr int kLastBoundExp = 30;
+
+        void appendLabelValue(fmt::memory_buffer &buf, std::string_view value) {
+            for (char c: value) {
+                if (c == '\\' || c == '"') {
+                    buf.push_back('\\');
+                    buf.push_back(c);
+                } else if (c == '\n') {
+                    buf.append("\\n"sv);
+                } else {
+                    buf.push_back(c);
+                }
+            }
+        }
+
+        void appendFamily(fmt::memory_buffer &buf, std::string_view name, std::string_view type,
+                          std::string_view help) {
+            fmt::format_to(fmt::appender(buf), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+        }
+
+        struct AppenderEntry {
+            std::string logger;
+            std::string id;
+            const char *type;
+            LogAppender::Metrics metrics;
+        };
+
+        void appendAppenderLabels(fmt::memory_buffer &buf, const AppenderEntry &entry) {
+            buf.append("logger=\""sv);
+            appendLabelValue(buf, entry.logger);
+            buf.append("\",appender=\""sv);
+            appendLabelValue(buf, entry.id);
+            buf.append("\",type=\""sv);
+            appendLabelValue(buf, entry.type);
+            buf.push_back('"');
+        }
+
+        void appendHistogram(fmt::memory_buffer &buf, std::string_view name, const AppenderEntry &entry,
+                             const LogHistogram::Snapshot &snapshot) {
+            for (int exp = kFirstBoundExp; exp <= kLastBoundExp; exp++) {
+                fmt::format_to(fmt::appender(buf), "{}_bucket{{", name);
+                appendAppenderLabels(buf, entry);
+                fmt::format_to(fmt::appender(buf), ",le=\"{}\"}} {}\n", (double) (1ull << exp) / 1e9,
+                               snapshot.countBelow(1ull << exp));
+            }
+            fmt::format_to(fmt::appender(buf), "{}_bucket{{", name);
+            appendAppenderLabels(buf, entry);
+            fmt::format_to(fmt::appender(buf), ",le=\"+Inf\"}} {}\n", snapshot.count);
+            fmt::format_to(fmt::appender(buf), "{}_sum{{", name);
+            appendAppenderLabels(buf, entry);
+            fmt::format_to(fmt::appender(buf), "}} {}\n", (double) snapshot.sum / 1e9);
+            fmt::format_to(fmt::appender(buf), "{}_count{{", name);
+            appendAppenderLabels(buf, entry);
+            fmt::format_to(fmt::appender(buf), "}} {}\n", snapshot.count);
+        }
+    }
+
+    std::string LoggerManager::getMetricsText() const {
+        auto loggers = m_loggers.load();
+        std::vector<std::pair<std::string, Logger::ptr>> sorted(loggers->begin(), loggers->end());
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        std::vector<std::pair<std::string, Logger::Metrics>> logger_metrics;
+        std::vector<AppenderEntry> appenders;
+        std::vector<const LogAppender *> seen;
+        auto addAppender = [&](const std::string &logger, const std::string &id, const LogAppender::ptr &appender) {
+            if (std::find(seen.begin(), seen.end(), appender.get()) != seen.end()) {
+                return false;
+            }
+            seen.push_back(appender.get());
+            appenders.push_back({logger, id, appender->getType(), appender->getMetrics()});
+            return true;
+        };
+        for (auto &item: sorted) {
+            logger_metrics.emplace_back(item.first, item.second->getMetrics());
+            auto list = item.second->getAppenders();
+            for (size_t i = 0; i < list->size(); i++) {
+                auto &appender = (*list)[i];
+                std::string id = std::to_string(i);
+                if (!addAppender(item.first, id, appender)) {
+                    continue;
+                }
+                if (auto async = std::dynamic_pointer_cast<AsyncLogAppender>(appender)) {
+                    addAppender(item.first, id + "/target", async->getTarget());
+                }
+            }
+        }
+
+        fmt::memory_buffer buf;
+        appendFamily(buf, "sylar_log_events_total", "counter", "Log events written by the logger, by level.");
+        for (auto &item: logger_metrics) {
+            for (int level = 1; level <= 5; level++) {
+                buf.append("sylar_log_events_total{logger=\""sv);
+                appendLabelValue(buf, item.first);
+                fmt::format_to(fmt::appender(buf), "\",level=\"{}\"}} {}\n",
+                               LogLevel::toString((LogLevel::Level) level), item.second.events[level - 1]);
+            }
+        }
+        auto loggerCounter = [&](std::string_view name, std::string_view help, auto field) {
+            appendFamily(buf, name, "counter", help);
+            for (auto &item: logger_metrics) {
+                fmt::format_to(fmt::appender(buf), "{}{{logger=\"", name);
+                appendLabelValue(buf, item.first);
+                fmt::format_to(fmt::appender(buf), "\"}} {}\n", item.second.*field);
+            }
+        };
+        loggerCounter("sylar_log_filtered_total", "Log statements skipped by the level check.",
+                      &Logger::Metrics::filtered);
+        loggerCounter("sylar_log_rate_limited_total", "Log events dropped by the rate limiter.",
+                      &Logger::Metrics::rate_limited);
+
+        auto appenderValue = [&](std::string_view name, std::string_view type, std::string_view help, auto field) {
+            appendFamily(buf, name, type, help);
+            for (auto &entry: appenders) {
+                fmt::format_to(fmt::appender(buf), "{}{{", name);
+                appendAppenderLabels(buf, entry);
+                fmt::format_to(fmt::appender(buf), "}} {}\n", entry.metrics.*field);
+            }
+        };
+        appenderValue("sylar_log_appender_events_total", "counter", "Events handled by the appender.",
+                      &LogAppender::Metrics::events);
+        appenderValue("sylar_log_appender_bytes_total", "counter", "Bytes written to the output.",
+                      &LogAppender::Metrics::bytes);
+        appenderValue("sylar_log_appender_writes_total", "counter", "Writes to the output.",
+                      &LogAppender::Metrics::writes);
+        appenderValue("sylar_log_appender_dropped_total", "counter", "Events dropped by the appender.",
+                      &LogAppender::Metrics::dropped);
+        appenderValue("sylar_log_appender_queue_depth", "gauge", "Events queued and not yet written.",
+                      &LogAppender::Metrics::queue_depth);
+
+        appendFamily(buf, "sylar_log_appender_format_seconds", "histogram",
+                     "Time to format one event, sampled 1 in 16 per thread.");
+        for (auto &entry: appenders) {
+            appendHistogram(buf, "sylar_log_appender_format_seconds", entry, entry.metrics.format_ns);
+        }
+        appendFamily(buf, "sylar_log_appender_write_seconds", "histogram", "Time of one write to the output.");
+        for (auto &entry: appenders) {
+            appendHistogram(buf, "sylar_log_appender_write_seconds", entry, entry.metrics.write_ns);
+        }
+        return fmt::to_string(buf);
+    }
+
+}
@@ -0,0 +1,133 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_LOG_METRICS_H
+#define SYLAR_WEB_SERVER_LOG_METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "utils.h"
+
+namespace sylar {
+
+    namespace metrics {
+        constexpr uint32_t kShards = 16;
+
+        inline thread_local uint32_t t_shard = UINT32_MAX;
+
+        // 当前线程的分片: 线程序号小于 kShards 的线程独占一个分片, 其余线程共用 0 号分片
+        // (线程序号从 1 开始, 0 号分片不属于任何线程)
+        inline uint32_t shardIndex() {
+            uint32_t shard = t_shard;
+            if (shard == UINT32_MAX) {
+                uint32_t index = getThreadInfo().index;
+                shard = index < kShards ? index : 0;
+                t_shard = shard;
+            }
+            return shard;
+        }
+
+        // 独占的分片只有本线程写, 用普通的读改写代替带 lock 前缀的原子加
+        inline void add(std::atomic<uint64_t> &counter, uint64_t value, uint32_t shard) {
+            if (shard) {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            } else {
+                counter.fetch_add(value, std::memory_order_relaxed);
+            }
+        }
+
+        // 单调时钟的纳秒数
+        uint64_t nowNs();
+
+        // 每 16 次调用返回一次 true, 按线程计数; 用于耗时直方图的采样
+        inline bool sampleTiming() {
+            static thread_local uint32_t t_count = 0;
+            return (t_count++ & 15) == 0;
+        }
+    }
+
+// 按线程分片的一组计数器, 写入不竞争缓存行, 读取时把各分片相加
+    template<size_t N>
+    class LogCounters {
+    public:
+        void add(size_t index, uint64_t value = 1) {
+            uint32_t shard = metrics::shardIndex();
+            metrics::add(m_shards[shard].values[index], value, shard);
+        }
+
+        uint64_t get(size_t index) const {
+            uint64_t sum = 0;
+            for (auto &shard: m_shards) {
+                sum += shard.values[index].load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> values[N] = {};
+        };
+
+        Shard m_shards[metrics::kShards];
+    };
+
+// HDR 风格的对数直方图: 每个 2 的幂区间再等分为 4 个桶, 相对误差不超过 25%, 覆盖 0 到 2^36 (纳秒约 68 秒),
+// 更大的值计入最后一个桶. 与 LogCounters 一样按线程分片
+    class LogHistogram {
+    public:
+        static constexpr size_t kSubBuckets = 4;
+        static constexpr size_t kMaxExponent = 35;
+        static constexpr size_t kBuckets = kMaxExponent * kSubBuckets;
+
+        struct Snapshot {
+            uint64_t count = 0;
+            uint64_t sum = 0;
+            uint64_t buckets[kBuckets] = {};
+
+            // q 在 [0, 1] 之间, 返回分位数所在桶的上界, 没有样本时返回 0
+            uint64_t percentile(double q) const;
+
+            // 小于 bound 的样本数, bound 应当是桶的边界(例如 2 的幂)
+            uint64_t countBelow(uint64_t bound) const;
+        };
+
+        static size_t bucketOf(uint64_t value) {
+            if (value < kSubBuckets) {
+                return (size_t) value;
+            }
+            size_t exponent = 63 - (size_t) __builtin_clzll(value);
+            if (exponent > kMaxExponent) {
+                return kBuckets - 1;
+            }
+            size_t sub = (size_t) (value >> (exponent - 2)) & (kSubBuckets - 1);
+            return (exponent - 1) * kSubBuckets + sub;
+        }
+
+        // 桶的上界(不含)
+        static uint64_t bucketLimit(size_t index);
+
+        void record(uint64_t value) {
+            uint32_t index = metrics::shardIndex();
+            Shard &shard = m_shards[index];
+            metrics::add(shard.count, 1, index);
+            metrics::add(shard.sum, value, index);
+            metrics::add(shard.buckets[bucketOf(value)], 1, index);
+        }
+
+        Snapshot snapshot() const;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> sum{0};
+            std::atomic<uint64_t> buckets[kBuckets] = {};
+        };
+
+        Shard m_shards[metrics::kShards];
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_LOG_METRICS_H
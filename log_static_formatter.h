@@ -0,0 +1,264 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_LOG_STATIC_FORMATTER_H
+#define SYLAR_WEB_SERVER_LOG_STATIC_FORMATTER_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <stdexcept>
+#include "log.h"
+#include "log_structured.h"
+
+namespace sylar {
+
+// 可以作为模板参数的字符串字面量
+    template<size_t N>
+    struct FixedString {
+        char data[N]{};
+
+        constexpr FixedString(const char (&str)[N]) {
+            for (size_t i = 0; i < N; i++) {
+                data[i] = str[i];
+            }
+        }
+
+        constexpr size_t size() const { return N - 1; }
+
+        constexpr char operator[](size_t i) const { return data[i]; }
+    };
+
+// 编译期解析日志模式, 语法和 LogFormatter::init 一致:
+// %% 输出 %, %x{arg} 带参数, 未知的格式符直接编译失败
+    namespace static_format {
+        enum class Kind {
+            LITERAL,
+            MESSAGE,        //%m
+            LEVEL,          //%p
+            ELAPSE,         //%r
+            LOG_NAME,       //%c
+            THREAD_ID,      //%t
+            NEW_LINE,       //%n
+            DATE_TIME,      //%d
+            FILE_NAME,      //%f
+            LINE,           //%l
+            TAB,            //%T
+            FIBER_ID,       //%F
+            THREAD_NAME,    //%N
+            HTTP_METHOD,    //%M
+            HTTP_PATH,      //%U
+            HTTP_STATUS,    //%S
+            HTTP_LATENCY,   //%D
+            FIELDS          //%K
+        };
+
+        // LITERAL 时 [begin, end) 是模式中的原文, 其余为 {} 中参数的范围
+        struct Token {
+            Kind kind = Kind::LITERAL;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        template<size_t N>
+        struct ParseResult {
+            std::array<Token, N> tokens{};
+            size_t count = 0;
+        };
+
+        constexpr bool isAlpha(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        template<FixedString P>
+        constexpr Kind kindOf(size_t begin, size_t end) {
+            if (end - begin != 1) {
+                throw std::invalid_argument("log pattern format error: unknown specifier");
+            }
+            switch (P[begin]) {
+                case 'm': return Kind::MESSAGE;
+                case 'p': return Kind::LEVEL;
+                case 'r': return Kind::ELAPSE;
+                case 'c': return Kind::LOG_NAME;
+                case 't': return Kind::THREAD_ID;
+                case 'n': return Kind::NEW_LINE;
+                case 'd': return Kind::DATE_TIME;
+                case 'f': return Kind::FILE_NAME;
+                case 'l': return Kind::LINE;
+                case 'T': return Kind::TAB;
+                case 'F': return Kind::FIBER_ID;
+                case 'N': return Kind::THREAD_NAME;
+                case 'M': return Kind::HTTP_METHOD;
+                case 'U': return Kind::HTTP_PATH;
+                case 'S': return Kind::HTTP_STATUS;
+                case 'D': return Kind::HTTP_LATENCY;
+                case 'K': return Kind::FIELDS;
+                default:
+                    throw std::invalid_argument("log pattern format error: unknown specifier");
+            }
+        }
+
+        template<FixedString P>
+        constexpr auto parse() {
+            ParseResult<P.size() + 1> result;
+            auto push = [&result](Kind kind, size_t begin, size_t end) {
+                if (kind == Kind::LITERAL && begin == end) {
+                    return;
+                }
+                result.tokens[result.count++] = Token{kind, begin, end};
+            };
+
+            size_t n = P.size();
+            size_t word_begin = 0;
+            size_t i = 0;
+            while (i < n) {
+                if (P[i] != '%') {
+                    i++;
+                    continue;
+                }
+                if (i + 1 < n && P[i + 1] == '%') {
+                    push(Kind::LITERAL, word_begin, i + 1);
+                    i += 2;
+                    word_begin = i;
+                    continue;
+                }
+                push(Kind::LITERAL, word_begin, i);
+
+                size_t j = i + 1;
+                while (j < n && isAlpha(P[j])) {
+                    j++;
+                }
+                size_t flag_end = j;
+                size_t arg_begin = 0, arg_end = 0;
+                if (j < n && P[j] == '{') {
+                    size_t pos = j + 1;
+                    while (pos < n && P[pos] != '}') {
+                        pos++;
+                    }
+                    if (pos == n) {
+                        throw std::invalid_argument("log pattern format error: can't find }");
+                    }
+                    arg_begin = j + 1;
+                    arg_end = pos;
+                    j = pos + 1;
+                }
+                if (flag_end > i + 1) {
+                    push(kindOf<P>(i + 1, flag_end), arg_begin, arg_end);
+                }
+                i = j;
+                word_begin = j;
+            }
+            push(Kind::LITERAL, word_begin, n);
+            return result;
+        }
+
+        // 模式用到的需要在调用点采集的字段
+        template<size_t N>
+        constexpr uint32_t fieldsOf(const ParseResult<N> &parsed) {
+            uint32_t fields = 0;
+            for (size_t i = 0; i < parsed.count; i++) {
+                switch (parsed.tokens[i].kind) {
+                    case Kind::DATE_TIME: fields |= LogEvent::CAPTURE_TIME; break;
+                    case Kind::ELAPSE: fields |= LogEvent::CAPTURE_ELAPSE; break;
+                    case Kind::THREAD_ID:
+                    case Kind::THREAD_NAME: fields |= LogEvent::CAPTURE_THREAD; break;
+                    case Kind::FIBER_ID: fields |= LogEvent::CAPTURE_FIBER; break;
+                    default: break;
+                }
+            }
+            return fields;
+        }
+
+        // 单个格式项, 全部是静态的非虚函数, 分派在编译期完成
+        template<FixedString P, Token T>
+        struct Item {
+            static void format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                               const LogEvent &event) {
+                if constexpr (T.kind == Kind::LITERAL) {
+                    buf.append(P.data + T.begin, P.data + T.end);
+                } else if constexpr (T.kind == Kind::MESSAGE) {
+                    buf.append(event.getContent());
+                } else if constexpr (T.kind == Kind::LEVEL) {
+                    buf.append(LogLevel::toString(level));
+                } else if constexpr (T.kind == Kind::ELAPSE) {
+                    detail::appendInt(buf, event.getElapse());
+                } else if constexpr (T.kind == Kind::LOG_NAME) {
+                    buf.append(logger->getName());
+                } else if constexpr (T.kind == Kind::THREAD_ID) {
+                    detail::appendInt(buf, event.getThreadId());
+                } else if constexpr (T.kind == Kind::NEW_LINE) {
+                    buf.push_back('\n');
+                } else if constexpr (T.kind == Kind::DATE_TIME) {
+                    static const detail::DateTimeLayout s_layout(std::string_view(P.data + T.begin, T.end - T.begin));
+                    s_layout.append(buf, event);
+                } else if constexpr (T.kind == Kind::FILE_NAME) {
+                    buf.append(event.getFileName());
+                } else if constexpr (T.kind == Kind::LINE) {
+                    detail::appendInt(buf, event.getLine());
+                } else if constexpr (T.kind == Kind::TAB) {
+                    buf.push_back('\t');
+                } else if constexpr (T.kind == Kind::FIBER_ID) {
+                    detail::appendInt(buf, event.getFiberId());
+                } else if constexpr (T.kind == Kind::THREAD_NAME) {
+                    buf.append(event.getThreadName());
+                } else if constexpr (T.kind == Kind::HTTP_METHOD) {
+                    buf.append(event.getHttpMethod());
+                } else if constexpr (T.kind == Kind::HTTP_PATH) {
+                    buf.append(event.getHttpPath());
+                } else if constexpr (T.kind == Kind::HTTP_STATUS) {
+                    detail::appendInt(buf, event.getHttpStatus());
+                } else if constexpr (T.kind == Kind::HTTP_LATENCY) {
+                    detail::appendInt(buf, event.getHttpLatencyUs());
+                } else if constexpr (T.kind == Kind::FIELDS) {
+                    detail::appendLogfmtFields(buf, event);
+                }
+            }
+        };
+    }
+
+// 编译期特化的日志格式
+// 例: LogFormatter::ptr fmt(new StaticLogFormatter<"%d{%Y-%m-%d}%T%t%T[%p]%T%m%n">);
+// 从配置文件读取的模式仍然使用运行时解析的 LogFormatter
+    template<FixedString Pattern>
+    class StaticLogFormatter : public LogFormatter {
+    private:
+        static constexpr auto s_parsed = static_format::parse<Pattern>();
+
+        template<size_t I>
+        using ItemAt = static_format::Item<Pattern, s_parsed.tokens[I]>;
+
+        template<size_t... I>
+        static auto makeItems(std::index_sequence<I...>) -> std::tuple<ItemAt<I>...>;
+
+        template<size_t... I>
+        static void formatItems(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger,
+                                LogLevel::Level level, const LogEvent &event, std::index_sequence<I...>) {
+            (ItemAt<I>::format(buf, logger, level, event), ...);
+        }
+
+    public:
+        typedef std::shared_ptr<StaticLogFormatter> ptr;
+
+        // 解析出的格式项序列
+        typedef decltype(makeItems(std::make_index_sequence<s_parsed.count>{})) Items;
+
+        StaticLogFormatter() : LogFormatter(Pattern.data, NoParse{}, static_format::fieldsOf(s_parsed)) {}
+
+        // 不经过虚函数, 调用方知道具体模式时可以直接使用
+        static void formatTo(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                             const LogEvent &event) {
+            formatItems(buf, logger, level, event, std::make_index_sequence<s_parsed.count>{});
+        }
+
+        using LogFormatter::format;
+
+        void format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                    const LogEvent::ptr &event) override {
+            formatTo(buf, logger, level, *event);
+        }
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_LOG_STATIC_FORMATTER_H
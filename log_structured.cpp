@@ -0,0 +1,329 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "log_structured.h"
+#include <cmath>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace sylar {
+
+    using namespace std::string_view_literals;
+
+    namespace {
+        inline bool isJsonSpecial(unsigned char c) {
+            return c < 0x20 || c == '"' || c == '\\';
+        }
+
+        // logfmt 中还需要加引号的字符
+        inline bool isLogfmtSpecial(unsigned char c) {
+            return isJsonSpecial(c) || c == ' ' || c == '=';
+        }
+
+        template<bool Logfmt>
+        size_t scanScalar(const char *str, size_t i, size_t len) {
+            for (; i < len; i++) {
+                if (Logfmt ? isLogfmtSpecial((unsigned char) str[i]) : isJsonSpecial((unsigned char) str[i])) {
+                    break;
+                }
+            }
+            return i;
+        }
+
+#if defined(__SSE2__)
+        template<bool Logfmt>
+        __attribute__((always_inline)) inline __m128i special16(__m128i x) {
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+            // 无符号比较 x <= 0x1f: min(x, 0x1f) == x
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(0x1f)), x));
+            if constexpr (Logfmt) {
+                m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+                m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('=')));
+            }
+            return m;
+        }
+
+        // 内联到 AVX2 函数中时编译为 VEX 编码, 避免 AVX 与传统 SSE 指令混用的切换开销
+        template<bool Logfmt>
+        __attribute__((always_inline)) inline size_t scanSse2From(const char *str, size_t i, size_t len) {
+            for (; i + 16 <= len; i += 16) {
+                int mask = _mm_movemask_epi8(special16<Logfmt>(_mm_loadu_si128((const __m128i *) (str + i))));
+                if (mask) {
+                    return i + (size_t) __builtin_ctz((unsigned) mask);
+                }
+            }
+            return scanScalar<Logfmt>(str, i, len);
+        }
+
+        template<bool Logfmt>
+        size_t scanSse2(const char *str, size_t len) {
+            return scanSse2From<Logfmt>(str, 0, len);
+        }
+
+        template<bool Logfmt>
+        __attribute__((target("avx2"))) size_t scanAvx2(const char *str, size_t len) {
+            size_t i = 0;
+            for (; i + 32 <= len; i += 32) {
+                __m256i x = _mm256_loadu_si256((const __m256i *) (str + i));
+                __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')),
+                                            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\')));
+                m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(0x1f)), x));
+                if constexpr (Logfmt) {
+                    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+                    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('=')));
+                }
+                unsigned mask = (unsigned) _mm256_movemask_epi8(m);
+                if (mask) {
+                    return i + (size_t) __builtin_ctz(mask);
+                }
+            }
+            // 不足 32 字节的尾部
+            return scanSse2From<Logfmt>(str, i, len);
+        }
+#endif
+
+        typedef size_t (*ScanFunc)(const char *str, size_t len);
+
+        template<bool Logfmt>
+        size_t scanPortable(const char *str, size_t len) {
+            return scanScalar<Logfmt>(str, 0, len);
+        }
+
+        template<bool Logfmt>
+        ScanFunc pickScan() {
+#if defined(__SSE2__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return &scanAvx2<Logfmt>;
+            }
+            return &scanSse2<Logfmt>;
+#else
+            return &scanPortable<Logfmt>;
+#endif
+        }
+
+        // 第一个特殊字符的位置, 实现在第一次调用时按 CPU 选定
+        template<bool Logfmt>
+        size_t scan(const char *str, size_t len) {
+            static const ScanFunc s_scan = pickScan<Logfmt>();
+            return s_scan(str, len);
+        }
+
+        void appendEscapedChar(fmt::memory_buffer &buf, unsigned char c) {
+            switch (c) {
+                case '"':
+                    buf.append("\\\""sv);
+                    return;
+                case '\\':
+                    buf.append("\\\\"sv);
+                    return;
+                case '\n':
+                    buf.append("\\n"sv);
+                    return;
+                case '\r':
+                    buf.append("\\r"sv);
+                    return;
+                case '\t':
+                    buf.append("\\t"sv);
+                    return;
+                case '\b':
+                    buf.append("\\b"sv);
+                    return;
+                case '\f':
+                    buf.append("\\f"sv);
+                    return;
+                default: {
+                    static const char kHex[] = "0123456789abcdef";
+                    char esc[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xf]};
+                    buf.append(esc, esc + sizeof(esc));
+                }
+            }
+        }
+
+        void appendQuoted(fmt::memory_buffer &buf, std::string_view str) {
+            buf.push_back('"');
+            detail::appendJsonEscaped(buf, str);
+            buf.push_back('"');
+        }
+
+        void appendJsonField(fmt::memory_buffer &buf, const LogField &field) {
+            buf.append(",\""sv);
+            detail::appendJsonEscaped(buf, field.key);
+            buf.append("\":"sv);
+            switch (field.type) {
+                case LogField::Type::INT:
+                    detail::appendInt(buf, field.i);
+                    break;
+                case LogField::Type::UINT:
+                    detail::appendInt(buf, field.u);
+                    break;
+                case LogField::Type::DOUBLE:
+                    if (std::isfinite(field.d)) {
+                        fmt::format_to(fmt::appender(buf), "{}", field.d);
+                    } else {
+                        buf.append("null"sv);
+                    }
+                    break;
+                case LogField::Type::BOOL:
+                    buf.append(field.b ? "true"sv : "false"sv);
+                    break;
+                case LogField::Type::STRING:
+                    appendQuoted(buf, field.str);
+                    break;
+            }
+        }
+
+        void appendLogfmtField(fmt::memory_buffer &buf, const LogField &field) {
+            buf.append(field.key);
+            buf.push_back('=');
+            switch (field.type) {
+                case LogField::Type::INT:
+                    detail::appendInt(buf, field.i);
+                    break;
+                case LogField::Type::UINT:
+                    detail::appendInt(buf, field.u);
+                    break;
+                case LogField::Type::DOUBLE:
+                    fmt::format_to(fmt::appender(buf), "{}", field.d);
+                    break;
+                case LogField::Type::BOOL:
+                    buf.append(field.b ? "true"sv : "false"sv);
+                    break;
+                case LogField::Type::STRING:
+                    detail::appendLogfmtValue(buf, field.str);
+                    break;
+            }
+        }
+    }
+
+    namespace detail {
+        size_t findJsonEscape(const char *str, size_t len) {
+            return scan<false>(str, len);
+        }
+
+        size_t findJsonEscapeScalar(const char *str, size_t len) {
+            return scanScalar<false>(str, 0, len);
+        }
+
+        void appendJsonEscaped(fmt::memory_buffer &buf, std::string_view str) {
+            const char *p = str.data();
+            size_t len = str.size();
+            while (len > 0) {
+                size_t n = scan<false>(p, len);
+                buf.append(p, p + n);
+                if (n == len) {
+                    break;
+                }
+                appendEscapedChar(buf, (unsigned char) p[n]);
+                p += n + 1;
+                len -= n + 1;
+            }
+        }
+
+        void appendLogfmtValue(fmt::memory_buffer &buf, std::string_view str) {
+            if (!str.empty() && scan<true>(str.data(), str.size()) == str.size()) {
+                buf.append(str);
+                return;
+            }
+            appendQuoted(buf, str);
+        }
+
+        void appendLogfmtFields(fmt::memory_buffer &buf, const LogEvent &event) {
+            bool first = true;
+            event.forEachField([&buf, &first](const LogField &field) {
+                if (!first) {
+                    buf.push_back(' ');
+                }
+                first = false;
+                appendLogfmtField(buf, field);
+            });
+        }
+    }
+
+    JsonLogFormatter::JsonLogFormatter(const std::string &time_format)
+            : LogFormatter("json", NoParse()), m_time(time_format) {
+    }
+
+    void JsonLogFormatter::format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger,
+                                  LogLevel::Level level, const LogEvent::ptr &event) {
+        buf.append("{\"time\":\""sv);
+        m_time.append(buf, *event);
+        buf.append("\",\"level\":\""sv);
+        buf.append(LogLevel::toString(level));
+        buf.append("\",\"logger\":"sv);
+        appendQuoted(buf, logger->getName());
+        buf.append(",\"thread\":"sv);
+        detail::appendInt(buf, event->getThreadId());
+        buf.append(",\"thread_name\":"sv);
+        appendQuoted(buf, event->getThreadName());
+        buf.append(",\"fiber\":"sv);
+        detail::appendInt(buf, event->getFiberId());
+        buf.append(",\"file\":"sv);
+        appendQuoted(buf, event->getFileName());
+        buf.append(",\"line\":"sv);
+        detail::appendInt(buf, event->getLine());
+        buf.append(",\"msg\":"sv);
+        appendQuoted(buf, event->getContent());
+        if (!event->getHttpMethod().empty()) {
+            buf.append(",\"method\":\""sv);
+            buf.append(event->getHttpMethod());
+            buf.append("\",\"path\":"sv);
+            appendQuoted(buf, event->getHttpPath());
+            buf.append(",\"status\":"sv);
+            detail::appendInt(buf, event->getHttpStatus());
+            buf.append(",\"latency_us\":"sv);
+            detail::appendInt(buf, event->getHttpLatencyUs());
+        }
+        event->forEachField([&buf](const LogField &field) {
+            appendJsonField(buf, field);
+        });
+        buf.append("}\n"sv);
+    }
+
+    LogfmtLogFormatter::LogfmtLogFormatter(const std::string &time_format)
+            : LogFormatter("logfmt", NoParse()), m_time(time_format) {
+    }
+
+    void LogfmtLogFormatter::format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger,
+                                    LogLevel::Level level, const LogEvent::ptr &event) {
+        // 时间格式可能带空格, 先单独格式化再按值的规则输出
+        fmt::memory_buffer time;
+        m_time.append(time, *event);
+        buf.append("time="sv);
+        detail::appendLogfmtValue(buf, std::string_view(time.data(), time.size()));
+        buf.append(" level="sv);
+        buf.append(LogLevel::toString(level));
+        buf.append(" logger="sv);
+        detail::appendLogfmtValue(buf, logger->getName());
+        buf.append(" thread="sv);
+        detail::appendInt(buf, event->getThreadId());
+        buf.append(" thread_name="sv);
+        detail::appendLogfmtValue(buf, event->getThreadName());
+        buf.append(" fiber="sv);
+        detail::appendInt(buf, event->getFiberId());
+        buf.append(" file="sv);
+        detail::appendLogfmtValue(buf, event->getFileName());
+        buf.append(" line="sv);
+        detail::appendInt(buf, event->getLine());
+        buf.append(" msg="sv);
+        detail::appendLogfmtValue(buf, event->getContent());
+        if (!event->getHttpMethod().empty()) {
+            buf.append(" method="sv);
+            buf.append(event->getHttpMethod());
+            buf.append(" path="sv);
+            detail::appendLogfmtValue(buf, event->getHttpPath());
+            buf.append(" status="sv);
+            detail::appendInt(buf, event->getHttpStatus());
+            buf.append(" latency_us="sv);
+            detail::appendInt(buf, event->getHttpLatencyUs());
+        }
+        event->forEachField([&buf](const LogField &field) {
+            buf.push_back(' ');
+            appendLogfmtField(buf, field);
+        });
+        buf.push_back('\n');
+    }
+
+}
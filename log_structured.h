@@ -0,0 +1,67 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_LOG_STRUCTURED_H
+#define SYLAR_WEB_SERVER_LOG_STRUCTURED_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "log.h"
+
+namespace sylar {
+
+    namespace detail {
+        // JSON 字符串内容(不含两侧引号), 转义 " \ 和控制字符, 其他字节(包括 UTF-8)原样输出
+        // 用 SSE2/AVX2 每次检查 16/32 个字节, 只有找到需要转义的字符时才逐个处理
+        void appendJsonEscaped(fmt::memory_buffer &buf, std::string_view str);
+
+        // logfmt 的值: 非空且不含空格, =, ", \ 和控制字符时原样输出, 否则加引号并按 JSON 规则转义
+        void appendLogfmtValue(fmt::memory_buffer &buf, std::string_view str);
+
+        // 事件的附加字段按 logfmt 输出, 以空格分隔, 供文本格式的 %K 使用
+        void appendLogfmtFields(fmt::memory_buffer &buf, const LogEvent &event);
+
+        // 第一个需要 JSON 转义的字符的位置, 没有时返回 len; 按 CPU 支持选择 AVX2, SSE2 或逐字节实现
+        size_t findJsonEscape(const char *str, size_t len);
+
+        // 逐字节的实现, 供不支持 SIMD 的平台和基准对比使用
+        size_t findJsonEscapeScalar(const char *str, size_t len);
+    }
+
+// 每个事件输出一行 JSON
+// 固定字段为 time, level, logger, thread, thread_name, fiber, file, line, msg, HTTP 访问日志另有 method, path,
+// status, latency_us, 之后是调用点附加的字段; 非有限的浮点数输出为 null
+    class JsonLogFormatter : public LogFormatter {
+    public:
+        typedef std::shared_ptr<JsonLogFormatter> ptr;
+
+        // time_format 语法同 %d{...}
+        explicit JsonLogFormatter(const std::string &time_format = "%Y-%m-%dT%H:%M:%S.%L%z");
+
+        void format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                    const LogEvent::ptr &event) override;
+
+    private:
+        detail::DateTimeLayout m_time;
+    };
+
+// 每个事件输出一行 logfmt: key=value 以空格分隔, 字段和 JsonLogFormatter 相同
+// 字段的键应当是不含空格和 = 的标识符, 原样输出
+    class LogfmtLogFormatter : public LogFormatter {
+    public:
+        typedef std::shared_ptr<LogfmtLogFormatter> ptr;
+
+        explicit LogfmtLogFormatter(const std::string &time_format = "%Y-%m-%dT%H:%M:%S.%L%z");
+
+        void format(fmt::memory_buffer &buf, const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                    const LogEvent::ptr &event) override;
+
+    private:
+        detail::DateTimeLayout m_time;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_LOG_STRUCTURED_H
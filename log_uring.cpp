@@ -0,0 +1,634 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "log_uring.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace sylar {
+
+    namespace {
+        // 完成事件的 user_data, 其余取值为缓冲下标
+        constexpr uint64_t kTimerTag = UINT64_MAX;
+        constexpr uint64_t kWakeTag = UINT64_MAX - 1;
+        constexpr uint64_t kCancelTag = UINT64_MAX - 2;
+        // 退回 pwritev 时等待在途写请求完成或取消的最长时间
+        constexpr uint64_t kCancelWaitMs = 1000;
+        // io_uring_enter 连续失败这么多次后退回 pwritev, 期间的退避共约 0.5 秒
+        constexpr uint32_t kMaxEnterFailures = 8;
+
+        uint64_t nowMs() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+            return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        }
+
+        int uringSetup(unsigned entries, io_uring_params *params) {
+            return (int) syscall(__NR_io_uring_setup, entries, params);
+        }
+
+        int uringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+            return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+        }
+
+        int uringRegister(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+            return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+        }
+    }
+
+    // 不依赖 liburing, 直接映射内核的提交队列和完成队列
+    // 提交队列只在 m_mutex 下写入, 完成队列只由后台线程读取
+    struct UringFileLogAppender::Ring {
+        int fd = -1;
+        void *sq_ptr = MAP_FAILED;
+        size_t sq_size = 0;
+        void *cq_ptr = MAP_FAILED;
+        size_t cq_size = 0;
+        io_uring_sqe *sqes = (io_uring_sqe *) MAP_FAILED;
+        size_t sqes_size = 0;
+        unsigned *sq_head = nullptr;
+        unsigned *sq_tail = nullptr;
+        unsigned sq_mask = 0;
+        unsigned *sq_array = nullptr;
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe *cqes = nullptr;
+        uint8_t write_flags = IOSQE_FIXED_FILE;
+        __kernel_timespec timeout{};
+
+        ~Ring() {
+            if (sqes != MAP_FAILED) {
+                munmap(sqes, sqes_size);
+            }
+            if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+                munmap(cq_ptr, cq_size);
+            }
+            if (sq_ptr != MAP_FAILED) {
+                munmap(sq_ptr, sq_size);
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        // 建环并注册缓冲和文件, 任何一步失败返回空
+        static std::unique_ptr<Ring> create(unsigned entries, const std::vector<struct iovec> &buffers, int file) {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            auto ring = std::make_unique<Ring>();
+            ring->fd = uringSetup(entries, &params);
+            if (ring->fd < 0 || file < 0) {
+                return nullptr;
+            }
+            ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) {
+                ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+            }
+            ring->sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                ring->fd, IORING_OFF_SQ_RING);
+            if (ring->sq_ptr == MAP_FAILED) {
+                return nullptr;
+            }
+            ring->cq_ptr = single ? ring->sq_ptr
+                                  : mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                         ring->fd, IORING_OFF_CQ_RING);
+            if (ring->cq_ptr == MAP_FAILED) {
+                return nullptr;
+            }
+            ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            ring->sqes = (io_uring_sqe *) mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+            if (ring->sqes == MAP_FAILED) {
+                return nullptr;
+            }
+            char *sq = (char *) ring->sq_ptr;
+            ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+            ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+            ring->sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+            ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+            char *cq = (char *) ring->cq_ptr;
+            ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+            ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+            ring->cq_mask = *(unsigned *) (cq + params.cq_off.ring_mask);
+            ring->cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+            // 注册后内核不再为每次写请求映射和锁定用户内存, 也不再查找 fd
+            if (uringRegister(ring->fd, IORING_REGISTER_BUFFERS, buffers.data(), (unsigned) buffers.size()) < 0) {
+                return nullptr;
+            }
+            if (uringRegister(ring->fd, IORING_REGISTER_FILES, &file, 1) < 0) {
+                return nullptr;
+            }
+            // 5.6 起支持 IOSQE_ASYNC: 写请求直接交给内核工作线程, 提交的线程连页缓存的拷贝也不做
+            if (params.features & IORING_FEAT_RW_CUR_POS) {
+                ring->write_flags |= IOSQE_ASYNC;
+            }
+            return ring;
+        }
+
+        // 提交队列中还没被内核取走的请求数, 小于队列长度时可以再放一个
+        bool hasSpace() const {
+            return *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) <= sq_mask;
+        }
+
+        // 调用方持有 m_mutex; 在途的请求数不超过队列长度, 总能取到空位
+        io_uring_sqe *nextSqe() {
+            unsigned tail = *sq_tail;
+            io_uring_sqe *sqe = &sqes[tail & sq_mask];
+            memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        void push() {
+            unsigned tail = *sq_tail;
+            sq_array[tail & sq_mask] = tail & sq_mask;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            // 之前因为出错没有被内核取走的请求一并提交
+            unsigned pending = tail + 1 - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+            while (uringEnter(fd, pending, 0, 0) < 0 && errno == EINTR) {
+            }
+        }
+    };
+
+    UringFileLogAppender::UringFileLogAppender(const std::string &file_name)
+            : UringFileLogAppender(file_name, Options()) {}
+
+    UringFileLogAppender::UringFileLogAppender(const std::string &file_name, const Options &options)
+            : m_file_name(file_name), m_options(options) {
+        if (!m_options.buffer_size || !m_options.buffer_count || m_options.buffer_count > UINT16_MAX) {
+            throw std::invalid_argument("uring log appender needs 1 to 65535 non-empty buffers");
+        }
+        // 按页对齐, 注册时整页锁定
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        m_options.buffer_size = (m_options.buffer_size + page - 1) / page * page;
+        m_memory = (char *) std::aligned_alloc(page, m_options.buffer_size * m_options.buffer_count);
+        if (!m_memory) {
+            throw std::bad_alloc();
+        }
+        m_buffers.resize(m_options.buffer_count);
+        std::vector<struct iovec> iovecs(m_options.buffer_count);
+        for (size_t i = 0; i < m_buffers.size(); i++) {
+            m_buffers[i].data = m_memory + i * m_options.buffer_size;
+            iovecs[i] = {m_buffers[i].data, m_options.buffer_size};
+            m_free.push_back((uint32_t) (m_buffers.size() - 1 - i));
+        }
+        openFile();
+        if (m_options.use_uring) {
+            // 每个缓冲最多一个写请求, 另外留给定时器和唤醒请求
+            unsigned entries = 4;
+            while (entries < m_options.buffer_count + 2) {
+                entries <<= 1;
+            }
+            m_ring = Ring::create(entries, iovecs, m_fd);
+        }
+        if (m_ring) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            armTimer();
+            m_uring = true;
+        }
+        m_thread = std::thread(m_ring ? &UringFileLogAppender::runUring : &UringFileLogAppender::runWritev, this);
+    }
+
+    UringFileLogAppender::~UringFileLogAppender() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            sealCurrent();
+            m_stop = true;
+            if (m_ring) {
+                // 取消定时器, 没有定时器时用空操作唤醒完成线程
+                io_uring_sqe *sqe = m_ring->nextSqe();
+                if (m_timer_armed) {
+                    sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+                    sqe->fd = -1;
+                    sqe->addr = kTimerTag;
+                } else {
+                    sqe->opcode = IORING_OP_NOP;
+                }
+                sqe->user_data = kWakeTag;
+                m_ring->push();
+            } else {
+                m_work.notify_all();
+            }
+        }
+        m_thread.join();
+        m_ring.reset();
+        if (!m_memory_stale) {
+            std::free(m_memory);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool UringFileLogAppender::openFile() {
+        // 不用 O_APPEND: 写入按偏移定位, 同时在途的请求不会互相打乱顺序
+        m_fd = open(m_file_name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        m_offset = 0;
+        struct stat st;
+        if (m_fd >= 0 && fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            m_offset = (uint64_t) st.st_size;
+        }
+        return m_fd >= 0;
+    }
+
+    bool UringFileLogAppender::reopen() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        sealCurrent();
+        m_idle.wait(lock, [this]() { return m_in_flight == 0; });
+        int old_fd = m_fd;
+        uint64_t old_offset = m_offset;
+        if (!openFile()) {
+            m_fd = old_fd;
+            m_offset = old_offset;
+            return false;
+        }
+        if (m_ring) {
+            // 替换固定槽位中的文件
+            io_uring_files_update update;
+            memset(&update, 0, sizeof(update));
+            update.fds = (uint64_t) (uintptr_t) &m_fd;
+            if (uringRegister(m_ring->fd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0) {
+                close(m_fd);
+                m_fd = old_fd;
+                m_offset = old_offset;
+                return false;
+            }
+        }
+        if (old_fd >= 0) {
+            close(old_fd);
+        }
+        return true;
+    }
+
+    void UringFileLogAppender::log(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                   LogEvent::ptr event) {
+        if (level < m_level) {
+            return;
+        }
+        fmt::memory_buffer buf;
+        uint64_t begin = formatBegin();
+        readFormatter()->format(buf, logger, level, event);
+        countEvent(begin);
+        append(std::string_view(buf.data(), buf.size()));
+    }
+
+    void UringFileLogAppender::logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level,
+                                            const LogEvent::ptr &event, const Formatted &formatted) {
+        countFormatted(formatted);
+        append(formatted.text);
+    }
+
+    void UringFileLogAppender::append(std::string_view text) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // 放得进一个缓冲的行不拆开, 当前缓冲剩余空间不够时换一个; 超过缓冲大小的行拆到多个缓冲,
+        // 拆分期间其他线程等待, 避免等空闲缓冲时别的行插到中间
+        bool split = text.size() > m_options.buffer_size;
+        for (;;) {
+            if (!m_splitting) {
+                if (m_current >= 0 && (split || m_buffers[m_current].size + text.size() <= m_options.buffer_size)) {
+                    break;
+                }
+                sealCurrent();
+                if (!m_free.empty()) {
+                    takeFree();
+                    break;
+                }
+            }
+            m_idle.wait(lock);
+        }
+        Buffer *buffer = &m_buffers[m_current];
+        buffer->events++;
+        m_queued_events.fetch_add(1, std::memory_order_relaxed);
+        m_splitting = split;
+        for (;;) {
+            size_t n = std::min(text.size(), m_options.buffer_size - buffer->size);
+            memcpy(buffer->data + buffer->size, text.data(), n);
+            buffer->size += n;
+            text.remove_prefix(n);
+            if (buffer->size == m_options.buffer_size) {
+                sealCurrent();
+            }
+            if (text.empty()) {
+                break;
+            }
+            m_idle.wait(lock, [this]() { return !m_free.empty(); });
+            takeFree();
+            buffer = &m_buffers[m_current];
+        }
+        if (split) {
+            m_splitting = false;
+            m_idle.notify_all();
+        }
+    }
+
+    void UringFileLogAppender::takeFree() {
+        m_current = (int32_t) m_free.back();
+        m_free.pop_back();
+        m_current_since_ms = nowMs();
+    }
+
+    void UringFileLogAppender::flush() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        sealCurrent();
+        m_idle.wait(lock, [this]() { return m_in_flight == 0; });
+    }
+
+    LogAppender::Metrics UringFileLogAppender::getMetrics() const {
+        Metrics metrics = LogAppender::getMetrics();
+        metrics.queue_depth = m_queued_events.load(std::memory_order_relaxed);
+        return metrics;
+    }
+
+    void UringFileLogAppender::sealCurrent() {
+        if (m_current < 0 || m_buffers[m_current].size == 0) {
+            return;
+        }
+        uint32_t index = (uint32_t) m_current;
+        m_current = -1;
+        Buffer &buffer = m_buffers[index];
+        buffer.offset = m_offset;
+        buffer.submit_ns = metrics::nowNs();
+        m_offset += buffer.size;
+        m_in_flight++;
+        if (m_ring) {
+            submit(index);
+        } else {
+            m_ready.push_back(index);
+            m_work.notify_one();
+        }
+    }
+
+    void UringFileLogAppender::submit(uint32_t index) {
+        Buffer &buffer = m_buffers[index];
+        io_uring_sqe *sqe = m_ring->nextSqe();
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->flags = m_ring->write_flags;
+        sqe->fd = 0;    //固定文件的槽位
+        sqe->addr = (uint64_t) (uintptr_t) (buffer.data + buffer.done);
+        sqe->len = (uint32_t) (buffer.size - buffer.done);
+        sqe->off = buffer.offset + buffer.done;
+        sqe->buf_index = (uint16_t) index;
+        sqe->user_data = index;
+        m_ring->push();
+    }
+
+    void UringFileLogAppender::release(uint32_t index, bool ok) {
+        Buffer &buffer = m_buffers[index];
+        if (!ok) {
+            countDropped(buffer.events);
+        }
+        m_queued_events.fetch_sub(buffer.events, std::memory_order_relaxed);
+        if (buffer.stale) {
+            // 内核可能还会用旧内存写到旧偏移, 旧内存不再复用
+            m_replaced.emplace_back(new char[m_options.buffer_size]);
+            buffer.data = m_replaced.back().get();
+            buffer.stale = false;
+        }
+        buffer.size = 0;
+        buffer.done = 0;
+        buffer.events = 0;
+        m_free.push_back(index);
+        m_in_flight--;
+        m_idle.notify_all();
+    }
+
+    void UringFileLogAppender::armTimer() {
+        if (!m_options.flush_interval_ms || m_stop) {
+            return;
+        }
+        m_ring->timeout.tv_sec = m_options.flush_interval_ms / 1000;
+        m_ring->timeout.tv_nsec = (long long) (m_options.flush_interval_ms % 1000) * 1000000;
+        io_uring_sqe *sqe = m_ring->nextSqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t) (uintptr_t) &m_ring->timeout;
+        sqe->len = 1;
+        sqe->user_data = kTimerTag;
+        m_ring->push();
+        m_timer_armed = true;
+    }
+
+    void UringFileLogAppender::onComplete(uint64_t user_data, int32_t res) {
+        if (user_data == kWakeTag) {
+            return;
+        }
+        if (user_data == kTimerTag) {
+            m_timer_armed = false;
+            if (m_current >= 0 && nowMs() - m_current_since_ms >= m_options.flush_interval_ms) {
+                sealCurrent();
+            }
+            armTimer();
+            return;
+        }
+        uint32_t index = (uint32_t) user_data;
+        Buffer &buffer = m_buffers[index];
+        // 提交请求的线程退出时内核会取消它还没执行的请求, 由完成线程重新提交; 按偏移写, 重复写入也没有问题
+        if (res == -EINTR || res == -EAGAIN || res == -ECANCELED) {
+            submit(index);
+            return;
+        }
+        if (res <= 0) {
+            release(index, false);
+            return;
+        }
+        // 写了一部分时提交剩下的
+        buffer.done += (size_t) res;
+        if (buffer.done < buffer.size) {
+            submit(index);
+            return;
+        }
+        // 耗时从提交到完成
+        countWrite(buffer.submit_ns, buffer.size);
+        release(index, true);
+    }
+
+    void UringFileLogAppender::runUring() {
+        setThreadName("log_uring");
+        uint32_t failures = 0;
+        for (;;) {
+            if (uringEnter(m_ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                // EAGAIN/EBUSY 是完成队列溢出或内核暂时缺资源, 收割后重试; 其他错误连续出现说明环不可用了
+                if (errno != EAGAIN && errno != EBUSY && ++failures >= kMaxEnterFailures) {
+                    failOver();
+                    runWritev();
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1u << std::min(failures, 7u)));
+            } else {
+                failures = 0;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            unsigned head = *m_ring->cq_head;
+            unsigned tail = __atomic_load_n(m_ring->cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const io_uring_cqe &cqe = m_ring->cqes[head & m_ring->cq_mask];
+                onComplete(cqe.user_data, cqe.res);
+            }
+            __atomic_store_n(m_ring->cq_head, head, __ATOMIC_RELEASE);
+            if (m_stop && m_in_flight == 0 && !m_timer_armed) {
+                return;
+            }
+        }
+    }
+
+    void UringFileLogAppender::failOver() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // 环从此不再接受新请求, 之后交出的缓冲直接进 m_ready
+        std::unique_ptr<Ring> ring = std::move(m_ring);
+        m_uring = false;
+        m_timer_armed = false;
+        std::vector<bool> pending(m_buffers.size(), true);
+        for (uint32_t index: m_free) {
+            pending[index] = false;
+        }
+        if (m_current >= 0) {
+            pending[m_current] = false;
+        }
+        std::vector<uint32_t> taken;
+        for (uint32_t index = 0; index < m_buffers.size(); index++) {
+            if (pending[index]) {
+                taken.push_back(index);
+            }
+        }
+
+        // 关闭环不会等待 io-wq 中已经开始的写, 先取消并收割完成事件, 确认内核不再使用这些缓冲
+        for (uint32_t index: taken) {
+            if (!ring->hasSpace()) {
+                break;
+            }
+            io_uring_sqe *sqe = ring->nextSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = index;
+            sqe->user_data = kCancelTag;
+            ring->push();
+        }
+        uint64_t deadline = nowMs() + kCancelWaitMs;
+        size_t remaining = taken.size();
+        for (;;) {
+            unsigned head = *ring->cq_head;
+            unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                uint64_t user_data = ring->cqes[head & ring->cq_mask].user_data;
+                if (user_data < m_buffers.size() && pending[user_data]) {
+                    pending[user_data] = false;
+                    remaining--;
+                }
+            }
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+            if (!remaining || nowMs() >= deadline) {
+                break;
+            }
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            lock.lock();
+        }
+        ring.reset();
+
+        // 在途的缓冲整块按偏移重写, 已经写出的部分重复写入也没有问题;
+        // 没有收到完成事件的缓冲内容不变, 迟到的写只会写入相同的字节, 写完后不再复用这块内存
+        for (uint32_t index: taken) {
+            m_buffers[index].done = 0;
+            if (pending[index]) {
+                m_buffers[index].stale = true;
+                m_memory_stale = true;
+            }
+            m_ready.push_back(index);
+        }
+        std::sort(m_ready.begin(), m_ready.end(), [this](uint32_t a, uint32_t b) {
+            return m_buffers[a].offset < m_buffers[b].offset;
+        });
+    }
+
+    void UringFileLogAppender::runWritev() {
+        setThreadName("log_writev");
+        std::vector<uint32_t> batch;
+        std::vector<struct iovec> iovecs;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            auto ready = [this]() { return m_stop || !m_ready.empty(); };
+            if (m_options.flush_interval_ms) {
+                m_work.wait_for(lock, std::chrono::milliseconds(m_options.flush_interval_ms), ready);
+                if (m_ready.empty() && m_current >= 0 &&
+                    nowMs() - m_current_since_ms >= m_options.flush_interval_ms) {
+                    sealCurrent();
+                }
+            } else {
+                m_work.wait(lock, ready);
+            }
+            if (m_ready.empty()) {
+                if (m_stop) {
+                    return;
+                }
+                continue;
+            }
+            // 从 io_uring 接手的在途缓冲之间可能有空隙, 每批只取首尾相连的一段
+            size_t n = 1;
+            while (n < m_ready.size() &&
+                   m_buffers[m_ready[n]].offset == m_buffers[m_ready[n - 1]].offset + m_buffers[m_ready[n - 1]].size) {
+                n++;
+            }
+            batch.assign(m_ready.begin(), m_ready.begin() + (ptrdiff_t) n);
+            m_ready.erase(m_ready.begin(), m_ready.begin() + (ptrdiff_t) n);
+            int fd = m_fd;
+            uint64_t offset = m_buffers[batch.front()].offset;
+            lock.unlock();
+
+            // 等待中的缓冲在文件中首尾相连, 一次 pwritev 全部写出
+            iovecs.clear();
+            for (uint32_t index: batch) {
+                iovecs.push_back({m_buffers[index].data, m_buffers[index].size});
+            }
+            uint64_t begin = metrics::nowNs();
+            size_t written = 0;
+            struct iovec *iov = iovecs.data();
+            int count = (int) iovecs.size();
+            while (count > 0 && fd >= 0) {
+                ssize_t n = pwritev(fd, iov, std::min(count, IOV_MAX), (off_t) (offset + written));
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                written += (size_t) n;
+                while (count > 0 && (size_t) n >= iov->iov_len) {
+                    n -= (ssize_t) iov->iov_len;
+                    iov++;
+                    count--;
+                }
+                if (count > 0) {
+                    iov->iov_base = (char *) iov->iov_base + n;
+                    iov->iov_len -= (size_t) n;
+                }
+            }
+
+            // 整批算一次写; 没有写完的缓冲中的事件计为丢弃
+            if (written) {
+                countWrite(begin, written);
+            }
+            lock.lock();
+            size_t end = 0;
+            for (uint32_t index: batch) {
+                end += m_buffers[index].size;
+                release(index, end <= written);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,136 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_LOG_URING_H
+#define SYLAR_WEB_SERVER_LOG_URING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "log.h"
+
+namespace sylar {
+
+// 基于 io_uring 的文件输出地, 用于日志量很大的场景
+// 调用线程只把格式化好的文本拷贝进预先注册的缓冲, 缓冲写满或停留超过 flush_interval_ms 后提交一个
+// IORING_OP_WRITE_FIXED 请求, 文件注册在固定槽位; 后台的完成线程收割完成事件, 把缓冲放回空闲列表.
+// 调用线程不会阻塞在 write(2) 上, 只有所有缓冲都在写时才等待有缓冲空闲.
+// 写入按偏移量定位, 多个请求可以同时在途, 因此文件不应同时被其他进程追加.
+// 内核不支持 io_uring(或被禁用, 注册缓冲失败)时退回到由后台线程 pwritev 的实现, 行为相同;
+// 运行中 io_uring_enter 持续出错时也切换过去, 在途的缓冲交给 pwritev 按偏移重写.
+    class UringFileLogAppender : public LogAppender {
+    public:
+        typedef std::shared_ptr<UringFileLogAppender> ptr;
+
+        struct Options {
+            size_t buffer_size = 256 * 1024;        //每个缓冲的大小
+            size_t buffer_count = 8;                //缓冲个数, 即最多同时在途的写请求数
+            uint32_t flush_interval_ms = 1000;      //缓冲中的数据最多停留的时间, 0 表示只按大小写
+            bool use_uring = true;                  //为 false 时直接使用 pwritev 的实现
+        };
+
+        explicit UringFileLogAppender(const std::string &file_name);
+
+        UringFileLogAppender(const std::string &file_name, const Options &options);
+
+        ~UringFileLogAppender() override;
+
+        void log(const std::shared_ptr<Logger> &logger, LogLevel::Level level, LogEvent::ptr event) override;
+
+        bool canLogFormatted() const override { return true; }
+
+        void logFormatted(const std::shared_ptr<Logger> &logger, LogLevel::Level level, const LogEvent::ptr &event,
+                          const Formatted &formatted) override;
+
+        // 提交当前缓冲, 阻塞直到所有在途的写完成
+        void flush() override;
+
+        // 等待在途的写完成后重新打开文件, 用于外部 logrotate 移走文件之后
+        bool reopen();
+
+        // 是否在使用 io_uring, false 表示退回到了 pwritev
+        bool isUring() const { return m_uring.load(std::memory_order_relaxed); }
+
+        Metrics getMetrics() const override;
+
+        const char *getType() const override { return "uring_file"; }
+
+    private:
+        // io_uring 的环, 定义在 log_uring.cpp 中
+        struct Ring;
+
+        struct Buffer {
+            char *data = nullptr;
+            size_t size = 0;            //已写入的字节数
+            size_t done = 0;            //已经写到文件的字节数
+            uint64_t offset = 0;        //在文件中的偏移
+            uint64_t events = 0;        //从这个缓冲开始的事件数
+            uint64_t submit_ns = 0;
+            bool stale = false;         //退回 pwritev 时内核的写请求可能还在读这块内存, 写完后换新内存
+        };
+
+        void append(std::string_view text);
+
+        // 以下在 m_mutex 下调用
+        // 把当前缓冲交给后台写
+        void sealCurrent();
+
+        // 取一个空闲缓冲作为当前缓冲, 调用前空闲列表不能为空
+        void takeFree();
+
+        // 提交缓冲中还没写完的部分
+        void submit(uint32_t index);
+
+        // 写完或写失败的缓冲放回空闲列表
+        void release(uint32_t index, bool ok);
+
+        void onComplete(uint64_t user_data, int32_t res);
+
+        void armTimer();
+
+        bool openFile();
+
+        // 后台线程
+        void runUring();
+
+        void runWritev();
+
+        // 完成线程调用, 关闭出错的环, 在途的缓冲转交给 pwritev
+        void failOver();
+
+    private:
+        std::string m_file_name;
+        Options m_options;
+        char *m_memory = nullptr;               //所有缓冲的连续内存
+        bool m_memory_stale = false;            //有缓冲被内核遗留的请求引用, m_memory 不再释放
+        std::vector<std::unique_ptr<char[]>> m_replaced;    //替换 stale 缓冲的新内存
+        std::vector<Buffer> m_buffers;
+        std::unique_ptr<Ring> m_ring;
+        std::atomic<bool> m_uring{false};
+        std::atomic<uint64_t> m_queued_events{0};   //还没写到文件的事件数
+        // 以下由 LogAppender::m_mutex 保护
+        int m_fd = -1;
+        uint64_t m_offset = 0;                  //下一个缓冲的文件偏移
+        int32_t m_current = -1;                 //正在写入的缓冲, -1 表示没有
+        uint64_t m_current_since_ms = 0;
+        std::vector<uint32_t> m_free;
+        std::deque<uint32_t> m_ready;           //pwritev 模式下等待写出的缓冲, 按偏移排列
+        uint32_t m_in_flight = 0;               //已经交出还没写完的缓冲数
+        bool m_splitting = false;               //有线程正在把长行拆到多个缓冲
+        bool m_timer_armed = false;
+        bool m_stop = false;
+        std::condition_variable m_idle;         //有缓冲写完
+        std::condition_variable m_work;         //pwritev 模式下有缓冲待写或需要停止
+        std::thread m_thread;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_LOG_URING_H
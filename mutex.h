@@ -0,0 +1,219 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_MUTEX_H
+#define SYLAR_WEB_SERVER_MUTEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sylar {
+
+// 自旋锁, 只用于保护极短的临界区(比如拷贝一个 shared_ptr)
+    class Spinlock {
+    public:
+        void lock() {
+            for (;;) {
+                if (!m_flag.exchange(true, std::memory_order_acquire)) {
+                    return;
+                }
+                int spins = 0;
+                while (m_flag.load(std::memory_order_relaxed)) {
+                    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+                        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                        asm volatile("yield");
+#endif
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        }
+
+        bool try_lock() {
+            return !m_flag.load(std::memory_order_relaxed) && !m_flag.exchange(true, std::memory_order_acquire);
+        }
+
+        void unlock() {
+            m_flag.store(false, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<bool> m_flag{false};
+    };
+
+// 可以并发读写的 shared_ptr
+// 读者在自旋锁内只做一次引用计数加一, 写者替换指针后旧对象在最后一个读者释放时销毁(RCU 风格).
+// libstdc++ 的 std::atomic<std::shared_ptr> 做的是同样的事, 但 ThreadSanitizer 识别不了它内部的锁位
+// 热路径用 read(): 每个线程按版本号缓存一份快照, 版本没变时只读一个原子变量, 不加锁也不改引用计数.
+// 代价是被替换的旧对象要等持有它的线程下次 read() 或线程退出时才释放
+    template<class T>
+    class AtomicSharedPtr {
+    private:
+        struct Entry {
+            uint64_t version = 0;
+            std::shared_ptr<T> ptr;
+            uint32_t pins = 0;          //当前线程上还没析构的快照数, 不为 0 时不能替换
+        };
+
+    public:
+        // read() 的结果, 只能在取得它的线程上使用
+        class Snapshot {
+        public:
+            Snapshot() = default;
+
+            explicit Snapshot(std::shared_ptr<T> ptr) : m_owned(std::move(ptr)), m_ptr(m_owned.get()) {}
+
+            Snapshot(Snapshot &&other) noexcept
+                    : m_entry(other.m_entry), m_owned(std::move(other.m_owned)), m_ptr(other.m_ptr) {
+                other.m_entry = nullptr;
+                other.m_ptr = nullptr;
+            }
+
+            Snapshot &operator=(Snapshot &&other) noexcept {
+                if (this != &other) {
+                    release();
+                    m_entry = other.m_entry;
+                    m_owned = std::move(other.m_owned);
+                    m_ptr = other.m_ptr;
+                    other.m_entry = nullptr;
+                    other.m_ptr = nullptr;
+                }
+                return *this;
+            }
+
+            Snapshot(const Snapshot &) = delete;
+
+            Snapshot &operator=(const Snapshot &) = delete;
+
+            ~Snapshot() { release(); }
+
+            T *get() const { return m_ptr; }
+
+            T *operator->() const { return m_ptr; }
+
+            T &operator*() const { return *m_ptr; }
+
+            explicit operator bool() const { return m_ptr != nullptr; }
+
+        private:
+            friend class AtomicSharedPtr;
+
+            explicit Snapshot(Entry *entry) : m_entry(entry), m_ptr(entry->ptr.get()) {
+                entry->pins++;
+            }
+
+            void release() {
+                if (m_entry) {
+                    m_entry->pins--;
+                    m_entry = nullptr;
+                }
+            }
+
+            Entry *m_entry = nullptr;
+            std::shared_ptr<T> m_owned;     //缓存被外层快照占用时自己持有一份
+            T *m_ptr = nullptr;
+        };
+
+        AtomicSharedPtr() : m_slot(allocSlot()) {}
+
+        explicit AtomicSharedPtr(std::shared_ptr<T> ptr) : m_slot(allocSlot()), m_ptr(std::move(ptr)) {}
+
+        AtomicSharedPtr(const AtomicSharedPtr &) = delete;
+
+        AtomicSharedPtr &operator=(const AtomicSharedPtr &) = delete;
+
+        ~AtomicSharedPtr() { freeSlot(m_slot); }
+
+        std::shared_ptr<T> load() const {
+            std::lock_guard<Spinlock> lock(m_lock);
+            return m_ptr;
+        }
+
+        Snapshot read() const {
+            uint64_t version = m_version.load(std::memory_order_acquire);
+            auto &cache = threadCache();
+            if (cache.size() <= m_slot) {
+                cache.resize(m_slot + 1);
+            }
+            Entry &entry = cache[m_slot];
+            if (entry.version != version) {
+                if (entry.pins) {
+                    // 同一线程的外层还在用旧快照(例如 appender 里又写了日志), 不替换
+                    return Snapshot(load());
+                }
+                // 先读版本再取指针, 两者之间被替换时下一次 read() 会再刷新
+                entry.ptr = load();
+                entry.version = version;
+            }
+            return Snapshot(&entry);
+        }
+
+        void store(std::shared_ptr<T> ptr) {
+            {
+                std::lock_guard<Spinlock> lock(m_lock);
+                m_ptr.swap(ptr);
+                m_version.store(nextVersion(), std::memory_order_release);
+            }
+            // 旧对象在锁外释放
+        }
+
+    private:
+        struct SlotPool {
+            std::mutex mutex;
+            std::vector<uint32_t> free;
+            uint32_t count = 0;
+            std::atomic<uint64_t> version{0};
+        };
+
+        static SlotPool &slotPool() {
+            // 不析构, 静态的 AtomicSharedPtr 析构时还要归还槽位
+            static SlotPool *pool = new SlotPool;
+            return *pool;
+        }
+
+        // 版本号在同一类型的所有实例间唯一, 槽位被新实例复用时线程缓存中的旧快照不会被误认
+        static uint64_t nextVersion() {
+            return slotPool().version.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        static uint32_t allocSlot() {
+            SlotPool &pool = slotPool();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (!pool.free.empty()) {
+                uint32_t slot = pool.free.back();
+                pool.free.pop_back();
+                return slot;
+            }
+            return pool.count++;
+        }
+
+        static void freeSlot(uint32_t slot) {
+            SlotPool &pool = slotPool();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.free.push_back(slot);
+        }
+
+        // deque 在尾部扩展时已有元素的地址不变, 快照可以一直指向其中的元素
+        static std::deque<Entry> &threadCache() {
+            thread_local std::deque<Entry> cache;
+            return cache;
+        }
+
+        uint32_t m_slot;
+        std::atomic<uint64_t> m_version{nextVersion()};
+        mutable Spinlock m_lock;
+        std::shared_ptr<T> m_ptr;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_MUTEX_H
@@ -0,0 +1,237 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_POOL_ALLOCATOR_H
+#define SYLAR_WEB_SERVER_POOL_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace sylar {
+
+// 线程本地的定长内存块池
+// 每个线程有自己的空闲链表, 分配和本线程释放都不需要原子操作;
+// 其他线程释放的块通过无锁栈还给所属线程, 所属线程空闲链表用完时再一次性取回.
+// 这样生产者线程分配, 异步刷盘线程释放的场景下, 稳定状态也不会再调用 operator new.
+    template<size_t BlockSize>
+    class ThreadLocalPool {
+    public:
+        static void *allocate() {
+            Pool *pool = local();
+            if (!pool) {
+                return newBlock(nullptr);
+            }
+            Block *block = pool->free_list;
+            if (!block) {
+                block = pool->takeRemote();
+            }
+            if (!block) {
+                return newBlock(pool);
+            }
+            pool->free_list = block->next;
+            pool->free_count--;
+            return block->data();
+        }
+
+        static void deallocate(void *ptr) {
+            Block *block = Block::fromData(ptr);
+            Pool *owner = block->owner;
+            if (!owner) {
+                ::operator delete(block);
+                return;
+            }
+            if (owner == local()) {
+                if (owner->free_count >= kMaxCached) {
+                    ::operator delete(block);
+                    return;
+                }
+                block->next = owner->free_list;
+                owner->free_list = block;
+                owner->free_count++;
+                return;
+            }
+            owner->pushRemote(block);
+        }
+
+    private:
+        // 每个线程缓存的空闲块按字节数封顶, 块越大缓存的块数越少
+        static constexpr size_t kMaxCachedBytes = 256 * 1024;
+        static constexpr size_t kMaxCached =
+                kMaxCachedBytes / BlockSize < 16 ? 16 : (kMaxCachedBytes / BlockSize > 4096 ? 4096 : kMaxCachedBytes / BlockSize);
+
+        struct Pool;
+
+        struct Block {
+            Pool *owner;
+            Block *next;
+
+            void *data() { return reinterpret_cast<char *>(this) + kHeaderSize; }
+
+            static Block *fromData(void *ptr) {
+                return reinterpret_cast<Block *>(reinterpret_cast<char *>(ptr) - kHeaderSize);
+            }
+        };
+
+        static constexpr size_t kHeaderSize =
+                (sizeof(Block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+        // 远端栈被关闭后的标记值, 之后的远端释放直接归还给系统
+        static Block *closedMark() { return reinterpret_cast<Block *>(uintptr_t(1)); }
+
+        struct Pool {
+            Block *free_list = nullptr;
+            size_t free_count = 0;
+            std::atomic<Block *> remote{nullptr};
+
+            // 远端还回的块都是本线程分配出去的, 数量不超过流水线上同时存在的块, 全部收回马上复用;
+            // 缓存上限只约束本线程释放的块, 超出后本线程释放的块直接归还给系统
+            Block *takeRemote() {
+                Block *head = remote.exchange(nullptr, std::memory_order_acquire);
+                if (!head) {
+                    return nullptr;
+                }
+                Block *last = head;
+                size_t n = 1;
+                while (last->next) {
+                    last = last->next;
+                    n++;
+                }
+                last->next = free_list;
+                free_list = head;
+                free_count += n;
+                return free_list;
+            }
+
+            void pushRemote(Block *block) {
+                Block *head = remote.load(std::memory_order_relaxed);
+                do {
+                    if (head == closedMark()) {
+                        ::operator delete(block);
+                        return;
+                    }
+                    block->next = head;
+                } while (!remote.compare_exchange_weak(head, block, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+            }
+
+            // 线程退出时调用; Pool 本身不释放, 其他线程可能还持有属于它的块, 留给之后的线程复用
+            void close() {
+                Block *head = remote.exchange(closedMark(), std::memory_order_acquire);
+                releaseList(head);
+                releaseList(free_list);
+                free_list = nullptr;
+                free_count = 0;
+            }
+
+            static void releaseList(Block *block) {
+                while (block) {
+                    Block *next = block->next;
+                    ::operator delete(block);
+                    block = next;
+                }
+            }
+        };
+
+        // 已退出线程的 Pool, 新线程优先复用; 不析构, 线程退出可能晚于静态对象析构
+        struct IdlePools {
+            std::mutex mutex;
+            std::vector<Pool *> pools;
+
+            static IdlePools &getInstance() {
+                static IdlePools *instance = new IdlePools;
+                return *instance;
+            }
+        };
+
+        static Pool *acquirePool() {
+            auto &idle = IdlePools::getInstance();
+            {
+                std::lock_guard<std::mutex> lock(idle.mutex);
+                if (!idle.pools.empty()) {
+                    Pool *pool = idle.pools.back();
+                    idle.pools.pop_back();
+                    // 重新打开远端栈, 之后还回来的旧块同样归新线程所有
+                    pool->remote.store(nullptr, std::memory_order_release);
+                    return pool;
+                }
+            }
+            return new Pool;
+        }
+
+        struct LocalHolder {
+            Pool *pool = acquirePool();
+
+            ~LocalHolder() {
+                pool->close();
+                t_closed = true;
+                auto &idle = IdlePools::getInstance();
+                std::lock_guard<std::mutex> lock(idle.mutex);
+                idle.pools.push_back(pool);
+            }
+        };
+
+        static Pool *local() {
+            if (t_closed) {
+                return nullptr;
+            }
+            static thread_local LocalHolder holder;
+            return holder.pool;
+        }
+
+        static void *newBlock(Pool *owner) {
+            auto *block = static_cast<Block *>(::operator new(kHeaderSize + BlockSize));
+            block->owner = owner;
+            block->next = nullptr;
+            return block->data();
+        }
+
+        static inline thread_local bool t_closed = false;
+    };
+
+// 配合 std::allocate_shared 使用的分配器, 单个对象走线程本地池, 数组退回到 operator new
+    template<class T>
+    class PoolAllocator {
+    public:
+        typedef T value_type;
+
+        PoolAllocator() noexcept = default;
+
+        template<class U>
+        PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+        T *allocate(size_t n) {
+            if (n == 1) {
+                return static_cast<T *>(ThreadLocalPool<kBlockSize>::allocate());
+            }
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T *ptr, size_t n) noexcept {
+            if (n == 1) {
+                ThreadLocalPool<kBlockSize>::deallocate(ptr);
+                return;
+            }
+            ::operator delete(ptr);
+        }
+
+        template<class U>
+        bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+
+        template<class U>
+        bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+
+    private:
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+
+        // 按 64 字节取整, 大小相近的类型共用一个池
+        static constexpr size_t kBlockSize = (sizeof(T) + 63) / 64 * 64;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_POOL_ALLOCATOR_H
@@ -0,0 +1,113 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_RING_QUEUE_H
+#define SYLAR_WEB_SERVER_RING_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace sylar {
+
+// 有界无锁环形队列(Vyukov 算法)
+// 每个槽位带一个序号, 生产者/消费者各用一次 CAS 抢占位置, 不需要互斥锁.
+// 日志场景下是多生产者单消费者, 但 drop-oldest 策略需要生产者也能出队, 所以出队同样是线程安全的.
+    template<class T>
+    class RingQueue {
+    public:
+        explicit RingQueue(size_t capacity) {
+            if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+                throw std::invalid_argument("ring queue capacity must be a power of 2");
+            }
+            m_mask = capacity - 1;
+            m_slots.reset(new Slot[capacity]);
+            for (size_t i = 0; i < capacity; i++) {
+                m_slots[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        RingQueue(const RingQueue &) = delete;
+
+        RingQueue &operator=(const RingQueue &) = delete;
+
+        // 队列满时返回 false, value 保持不变
+        bool tryPush(T &value) {
+            size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            Slot *slot;
+            for (;;) {
+                slot = &m_slots[pos & m_mask];
+                size_t seq = slot->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+                if (diff == 0) {
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            slot->value = std::move(value);
+            slot->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 队列空时返回 false
+        bool tryPop(T &value) {
+            size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            Slot *slot;
+            for (;;) {
+                slot = &m_slots[pos & m_mask];
+                size_t seq = slot->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+                if (diff == 0) {
+                    if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            value = std::move(slot->value);
+            slot->value = T();
+            slot->seq.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 近似值, 并发时仅供参考
+        size_t size() const {
+            size_t enq = m_enqueue_pos.load(std::memory_order_acquire);
+            size_t deq = m_dequeue_pos.load(std::memory_order_acquire);
+            return enq > deq ? enq - deq : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return m_mask + 1; }
+
+        // 已经被生产者占用的位置总数, 用于 flush 时确定要等待的进度
+        size_t enqueuePos() const { return m_enqueue_pos.load(std::memory_order_acquire); }
+
+    private:
+        struct Slot {
+            std::atomic<size_t> seq;
+            T value;
+        };
+
+        // 生产者和消费者的游标放在不同的缓存行上, 避免伪共享
+        alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+        alignas(64) std::atomic<size_t> m_dequeue_pos{0};
+        alignas(64) size_t m_mask = 0;
+        std::unique_ptr<Slot[]> m_slots;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_RING_QUEUE_H
@@ -0,0 +1,404 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "scheduler.h"
+#include <ctime>
+#include <stdexcept>
+#include "log.h"
+#include "pool_allocator.h"
+#include "utils.h"
+
+namespace sylar {
+
+    namespace {
+        constexpr size_t kMaxCachedFibers = 64;
+        // 忙碌的工作线程执行这么多个任务, 或经过这么长时间后调用一次 poll()
+        constexpr uint32_t kPollTasks = 64;
+        constexpr uint64_t kPollIntervalMs = 1;
+
+        uint64_t coarseNowMs() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+            return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        }
+
+        thread_local Scheduler *t_scheduler = nullptr;
+        thread_local int t_worker_index = -1;
+        thread_local bool t_reschedule = false;     //当前协程通过 Scheduler::yield 让出, 需要放回队列
+    }
+
+    Scheduler::Scheduler(size_t threads, const std::string &name) : m_name(name) {
+        if (threads == 0) {
+            throw std::invalid_argument("scheduler needs at least one thread");
+        }
+        for (size_t i = 0; i < threads; i++) {
+            m_workers.emplace_back(new Worker);
+            m_workers.back()->rand_state = (uint32_t) i * 2654435761u + 1;
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        stop();
+        // 没有执行的任务(从未 start 的调度器)
+        for (auto &worker: m_workers) {
+            Task *task = worker->inbox.exchange(nullptr);
+            while (task) {
+                Task *next = task->next;
+                deleteTask(task);
+                task = next;
+            }
+        }
+    }
+
+    void Scheduler::start() {
+        if (m_started) {
+            return;
+        }
+        m_started = true;
+        m_stopping = false;
+        for (size_t i = 0; i < m_workers.size(); i++) {
+            m_workers[i]->thread = std::thread(&Scheduler::run, this, i);
+        }
+    }
+
+    void Scheduler::stop() {
+        if (!m_started) {
+            return;
+        }
+        if (t_scheduler == this) {
+            throw std::invalid_argument("scheduler can't be stopped from its own worker thread");
+        }
+        m_stopping.store(true, std::memory_order_release);
+        for (size_t i = 0; i < m_workers.size(); i++) {
+            tickle(i);
+        }
+        for (auto &worker: m_workers) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+        }
+        // 任务可能在提交者唤醒工作线程之前就执行完了, 等提交者返回, 之后才能析构
+        while (m_remote_submits.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        m_started = false;
+    }
+
+    Scheduler::Task *Scheduler::newTask() {
+        PoolAllocator<Task> alloc;
+        return new(alloc.allocate(1)) Task;
+    }
+
+    void Scheduler::deleteTask(Task *task) {
+        task->~Task();
+        PoolAllocator<Task> alloc;
+        alloc.deallocate(task, 1);
+    }
+
+    void Scheduler::schedule(std::function<void()> cb, int thread) {
+        if (!cb) {
+            return;
+        }
+        Task *task = newTask();
+        task->cb = std::move(cb);
+        task->thread = thread;
+        submit(task);
+    }
+
+    void Scheduler::schedule(Fiber::ptr fiber, int thread) {
+        if (!fiber) {
+            return;
+        }
+        Task *task = newTask();
+        task->fiber = std::move(fiber);
+        task->thread = thread;
+        submit(task);
+    }
+
+    void Scheduler::submit(Task *task) {
+        if (task->thread >= (int) m_workers.size()) {
+            int thread = task->thread;
+            deleteTask(task);
+            throw std::invalid_argument("scheduler " + m_name + " has no thread " + std::to_string(thread));
+        }
+        m_task_count.fetch_add(1, std::memory_order_relaxed);
+
+        // 工作线程提交给自己, 不经过收件箱
+        if (t_scheduler == this && (task->thread < 0 || task->thread == t_worker_index)) {
+            Worker &self = *m_workers[t_worker_index];
+            if (task->thread >= 0) {
+                pushLocal(self, task);
+                return;
+            }
+            self.deque.push(task);
+            wakeOne(t_worker_index);
+            return;
+        }
+
+        m_remote_submits.fetch_add(1, std::memory_order_relaxed);
+        size_t target;
+        if (task->thread >= 0) {
+            target = task->thread;
+        } else {
+            // 优先交给正在睡眠的线程
+            size_t n = m_workers.size();
+            size_t start = m_next_worker.fetch_add(1, std::memory_order_relaxed);
+            target = start % n;
+            if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+                for (size_t i = 0; i < n; i++) {
+                    if (m_workers[(start + i) % n]->sleeping.load(std::memory_order_relaxed)) {
+                        target = (start + i) % n;
+                        break;
+                    }
+                }
+            }
+        }
+        Worker &worker = *m_workers[target];
+        Task *head = worker.inbox.load(std::memory_order_relaxed);
+        do {
+            task->next = head;
+        } while (!worker.inbox.compare_exchange_weak(head, task, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed));
+        if (worker.sleeping.load(std::memory_order_seq_cst) && worker.sleeping.exchange(false)) {
+            tickle(target);
+        }
+        m_remote_submits.fetch_sub(1, std::memory_order_release);
+    }
+
+    void Scheduler::drainInbox(Worker &worker) {
+        if (!worker.inbox.load(std::memory_order_relaxed)) {
+            return;
+        }
+        Task *head = worker.inbox.exchange(nullptr, std::memory_order_acquire);
+        // 收件箱是后进先出的, 翻转成提交顺序
+        Task *list = nullptr;
+        while (head) {
+            Task *next = head->next;
+            head->next = list;
+            list = head;
+            head = next;
+        }
+        size_t pushed = 0;
+        while (list) {
+            Task *task = list;
+            list = list->next;
+            if (task->thread >= 0) {
+                pushLocal(worker, task);
+            } else {
+                worker.deque.push(task);
+                pushed++;
+            }
+        }
+        if (pushed > 1) {
+            wakeOne(t_worker_index);
+        }
+    }
+
+    void Scheduler::pushLocal(Worker &worker, Task *task) {
+        task->next = nullptr;
+        if (worker.pinned_tail) {
+            worker.pinned_tail->next = task;
+        } else {
+            worker.pinned_head = task;
+        }
+        worker.pinned_tail = task;
+    }
+
+    Scheduler::Task *Scheduler::nextTask(Worker &worker, size_t index) {
+        drainInbox(worker);
+
+        auto pop_local = [&worker]() -> Task * {
+            Task *task = worker.pinned_head;
+            if (task) {
+                worker.pinned_head = task->next;
+                if (!worker.pinned_head) {
+                    worker.pinned_tail = nullptr;
+                }
+            }
+            return task;
+        };
+
+        // 本线程队列和固定任务/让出的协程轮流执行, 互相不会饿死
+        Task *task = nullptr;
+        bool local_first = (worker.rand_state & 1) != 0;
+        worker.rand_state = worker.rand_state * 1664525u + 1013904223u;
+        if (local_first && (task = pop_local())) {
+            return task;
+        }
+        if (worker.deque.pop(task)) {
+            return task;
+        }
+        if ((task = pop_local())) {
+            return task;
+        }
+
+        size_t n = m_workers.size();
+        if (n == 1) {
+            return nullptr;
+        }
+        size_t start = worker.rand_state >> 8;
+        for (int round = 0; round < 2; round++) {
+            for (size_t i = 0; i < n; i++) {
+                size_t victim = (start + i) % n;
+                if (victim != index && m_workers[victim]->deque.steal(task)) {
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void Scheduler::wakeOne(size_t self) {
+        if (m_sleepers.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        size_t n = m_workers.size();
+        size_t start = self < n ? self + 1 : 0;
+        for (size_t i = 0; i < n; i++) {
+            size_t idx = (start + i) % n;
+            Worker &worker = *m_workers[idx];
+            if (idx != self && worker.sleeping.load(std::memory_order_relaxed) && worker.sleeping.exchange(false)) {
+                tickle(idx);
+                return;
+            }
+        }
+    }
+
+    bool Scheduler::hasWork(size_t index) {
+        Worker &self = *m_workers[index];
+        if (self.pinned_head || self.inbox.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        for (auto &worker: m_workers) {
+            if (!worker->deque.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Scheduler::execute(Worker &worker, Task *task) {
+        Fiber::ptr fiber = std::move(task->fiber);
+        int thread = task->thread;
+        if (!fiber) {
+            if (!worker.fiber_cache.empty()) {
+                fiber = std::move(worker.fiber_cache.back());
+                worker.fiber_cache.pop_back();
+                fiber->reset(std::move(task->cb));
+            } else {
+                fiber = std::make_shared<Fiber>(std::move(task->cb));
+            }
+        }
+        deleteTask(task);
+
+        t_reschedule = false;
+        try {
+            fiber->resume();
+        } catch (std::exception &e) {
+            SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "scheduler {} fiber {} exited with exception: {}",
+                            m_name, fiber->getId(), e.what());
+        } catch (...) {
+            SYLAR_LOG_ERROR(LoggerManager::getInstance().getRoot(), "scheduler {} fiber {} exited with exception",
+                            m_name, fiber->getId());
+        }
+
+        if (t_reschedule) {
+            t_reschedule = false;
+            // 让出的协程放在本线程的先进先出队列, 先让其他任务执行; 固定线程的协程本来就在这个线程上
+            Task *again = newTask();
+            again->fiber = std::move(fiber);
+            again->thread = thread;
+            m_task_count.fetch_add(1, std::memory_order_relaxed);
+            pushLocal(worker, again);
+        } else if (fiber->getState() == Fiber::State::TERM && fiber.use_count() == 1 &&
+                   worker.fiber_cache.size() < kMaxCachedFibers) {
+            worker.fiber_cache.push_back(std::move(fiber));
+        }
+
+        if (m_task_count.fetch_sub(1, std::memory_order_acq_rel) == 1 && isStopRequested()) {
+            for (size_t i = 0; i < m_workers.size(); i++) {
+                tickle(i);
+            }
+        }
+    }
+
+    void Scheduler::run(size_t index) {
+        ::setThreadName(m_name + "_" + std::to_string(index));
+        t_scheduler = this;
+        t_worker_index = (int) index;
+        Worker &worker = *m_workers[index];
+        onWorkerStart(index);
+
+        uint32_t since_poll = 0;
+        uint64_t last_poll_ms = coarseNowMs();
+        for (;;) {
+            Task *task = nextTask(worker, index);
+            if (task) {
+                execute(worker, task);
+                // 队列一直不空时 idle() 不会被调用, 定期处理就绪的 fd 和到期的定时器, 否则它们要等队列清空
+                uint64_t now_ms = coarseNowMs();
+                if (++since_poll >= kPollTasks || now_ms - last_poll_ms >= kPollIntervalMs) {
+                    poll(index);
+                    since_poll = 0;
+                    last_poll_ms = now_ms;
+                }
+                continue;
+            }
+            since_poll = 0;
+            last_poll_ms = coarseNowMs();
+            if (stopping()) {
+                break;
+            }
+
+            // 先登记睡眠再检查一遍, 与提交方的"先入队再检查睡眠标记"配合, 不会丢失唤醒
+            worker.sleeping.store(true, std::memory_order_seq_cst);
+            m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if (!hasWork(index) && !stopping()) {
+                idle(index);
+            }
+            worker.sleeping.store(false, std::memory_order_relaxed);
+            m_sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        worker.fiber_cache.clear();
+        t_scheduler = nullptr;
+        t_worker_index = -1;
+    }
+
+    void Scheduler::tickle(size_t worker) {
+        Worker &w = *m_workers[worker];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.notified = true;
+        w.cond.notify_one();
+    }
+
+    void Scheduler::idle(size_t worker) {
+        Worker &w = *m_workers[worker];
+        std::unique_lock<std::mutex> lock(w.mutex);
+        w.cond.wait(lock, [&w]() { return w.notified; });
+        w.notified = false;
+    }
+
+    bool Scheduler::stopping() {
+        return isStopRequested() && m_task_count.load(std::memory_order_acquire) == 0;
+    }
+
+    Scheduler *Scheduler::getThis() {
+        return t_scheduler;
+    }
+
+    int Scheduler::getWorkerIndex() {
+        return t_worker_index;
+    }
+
+    void Scheduler::yield() {
+        if (!t_scheduler || !Fiber::getThis()) {
+            throw std::invalid_argument("Scheduler::yield called outside of a scheduled fiber");
+        }
+        // 标记之后才切出, 切回工作线程后由 execute 放回队列, 不会出现协程还在执行就被其他线程 resume 的情况
+        t_reschedule = true;
+        Fiber::yield();
+    }
+
+}
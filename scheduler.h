@@ -0,0 +1,135 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_SCHEDULER_H
+#define SYLAR_WEB_SERVER_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fiber.h"
+#include "work_steal_deque.h"
+
+namespace sylar {
+
+// N:M 协程调度器, 在固定数量的工作线程上执行协程
+// 每个工作线程有自己的工作窃取队列, 新任务放进本线程队列的底部, 空闲线程从其他线程队列的顶部窃取;
+// 其他线程提交的任务和固定线程的任务先放进目标线程的无锁收件箱, 由目标线程取出. 整个过程没有全局锁.
+// 工作线程名为 "<name>_<序号>", 日志中的 %N/%t 可以直接对应到 top -H.
+    class Scheduler {
+    public:
+        typedef std::shared_ptr<Scheduler> ptr;
+
+        explicit Scheduler(size_t threads = 1, const std::string &name = "sylar");
+
+        Scheduler(const Scheduler &) = delete;
+
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        virtual ~Scheduler();
+
+        const std::string &getName() const { return m_name; }
+
+        size_t getThreadCount() const { return m_workers.size(); }
+
+        void start();
+
+        // 等所有已提交的任务执行完毕后停止工作线程
+        void stop();
+
+        // thread 为 -1 时可以在任意线程上执行, 否则固定在第 thread 个工作线程上, 也不会被窃取
+        void schedule(std::function<void()> cb, int thread = -1);
+
+        // 恢复一个已经 yield 的协程
+        void schedule(Fiber::ptr fiber, int thread = -1);
+
+        // 当前线程所属的调度器, 不是工作线程时为 nullptr
+        static Scheduler *getThis();
+
+        // 当前工作线程序号, 不是工作线程时为 -1
+        static int getWorkerIndex();
+
+        // 把当前协程放回队列后让出执行权, 固定线程的任务仍回到原来的线程
+        static void yield();
+
+    protected:
+        // 唤醒在 idle() 中睡眠的工作线程
+        virtual void tickle(size_t worker);
+
+        // 工作线程没有任务时调用, 返回后重新查找任务; 默认在条件变量上等待 tickle
+        virtual void idle(size_t worker);
+
+        // 工作线程一直有任务时, 每执行一批任务或经过一段时间调用一次, 不能阻塞; 用于收集 IO 事件和到期定时器
+        virtual void poll(size_t worker) {}
+
+        // 是否可以退出工作线程
+        virtual bool stopping();
+
+        // 工作线程启动后, 开始执行任务之前调用
+        virtual void onWorkerStart(size_t worker) {}
+
+        bool isStopRequested() const { return m_stopping.load(std::memory_order_acquire); }
+
+        // 有线程睡眠时唤醒一个, self 为当前工作线程序号(不会唤醒自己), 不是工作线程时传 -1
+        void wakeOne(size_t self);
+
+    private:
+        struct Task {
+            Fiber::ptr fiber;
+            std::function<void()> cb;
+            int thread = -1;
+            Task *next = nullptr;
+        };
+
+        struct Worker {
+            WorkStealDeque<Task *> deque;
+            std::atomic<Task *> inbox{nullptr};     //其他线程提交的任务, 后进先出的无锁栈
+            Task *pinned_head = nullptr;            //固定在本线程的任务和让出的协程, 先进先出, 只有本线程访问
+            Task *pinned_tail = nullptr;
+            std::atomic<bool> sleeping{false};
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool notified = false;
+            std::vector<Fiber::ptr> fiber_cache;    //执行完毕的协程, 复用栈执行新的回调
+            uint32_t rand_state = 0;
+            std::thread thread;
+        };
+
+        void run(size_t index);
+
+        void submit(Task *task);
+
+        Task *nextTask(Worker &worker, size_t index);
+
+        void drainInbox(Worker &worker);
+
+        static void pushLocal(Worker &worker, Task *task);
+
+        void execute(Worker &worker, Task *task);
+
+        bool hasWork(size_t index);
+
+        static Task *newTask();
+
+        static void deleteTask(Task *task);
+
+    private:
+        std::string m_name;
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::atomic<size_t> m_task_count{0};        //已提交还没执行完的任务, 不包括 yield 后等待外部唤醒的协程
+        std::atomic<size_t> m_sleepers{0};
+        std::atomic<size_t> m_next_worker{0};
+        std::atomic<bool> m_stopping{false};
+        std::atomic<size_t> m_remote_submits{0};    //其他线程正在执行的 submit
+        bool m_started = false;
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_SCHEDULER_H
@@ -0,0 +1,168 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "servlet.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sylar {
+    namespace http {
+
+        namespace {
+            std::string_view contentType(std::string_view path) {
+                size_t dot = path.rfind('.');
+                if (dot == std::string_view::npos || path.find('/', dot) != std::string_view::npos) {
+                    return "application/octet-stream";
+                }
+                std::string_view ext = path.substr(dot + 1);
+                static const std::pair<std::string_view, std::string_view> s_types[] = {
+                        {"html", "text/html; charset=utf-8"},
+                        {"htm",  "text/html; charset=utf-8"},
+                        {"css",  "text/css"},
+                        {"js",   "application/javascript"},
+                        {"json", "application/json"},
+                        {"txt",  "text/plain; charset=utf-8"},
+                        {"xml",  "application/xml"},
+                        {"png",  "image/png"},
+                        {"jpg",  "image/jpeg"},
+                        {"jpeg", "image/jpeg"},
+                        {"gif",  "image/gif"},
+                        {"svg",  "image/svg+xml"},
+                        {"ico",  "image/x-icon"},
+                        {"wasm", "application/wasm"},
+                        {"pdf",  "application/pdf"},
+                };
+                for (auto &item: s_types) {
+                    if (equalsIgnoreCase(item.first, ext)) {
+                        return item.second;
+                    }
+                }
+                return "application/octet-stream";
+            }
+        }
+
+        void NotFoundServlet::handle(const HttpRequest &request, HttpResponse &response) {
+            response.setStatus(HttpStatus::NOT_FOUND);
+            response.addHeader("Content-Type", "text/plain; charset=utf-8");
+            response.setBody("404 Not Found\n");
+        }
+
+        StaticFileServlet::StaticFileServlet(const std::string &prefix, const std::string &root)
+                : Servlet("StaticFileServlet"), m_prefix(prefix), m_root(root) {
+            while (m_root.size() > 1 && m_root.back() == '/') {
+                m_root.pop_back();
+            }
+        }
+
+        void StaticFileServlet::handle(const HttpRequest &request, HttpResponse &response) {
+            if (request.getMethod() != HttpMethod::GET && request.getMethod() != HttpMethod::HEAD) {
+                response.setStatus(HttpStatus::METHOD_NOT_ALLOWED);
+                response.addHeader("Allow", "GET, HEAD");
+                return;
+            }
+            std::string_view path = request.getPath();
+            if (path.substr(0, m_prefix.size()) == m_prefix) {
+                path.remove_prefix(m_prefix.size());
+            }
+            if (path.find("..") != std::string_view::npos) {
+                response.setStatus(HttpStatus::FORBIDDEN);
+                return;
+            }
+
+            std::string file = m_root;
+            if (path.empty() || path.front() != '/') {
+                file.push_back('/');
+            }
+            file.append(path);
+            if (file.back() == '/') {
+                file.append("index.html");
+            }
+
+            int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st{};
+            if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                NotFoundServlet().handle(request, response);
+                return;
+            }
+            response.addHeader("Content-Type", contentType(file));
+            response.setFile(fd, 0, (size_t) st.st_size);
+        }
+
+        ServletDispatch::ServletDispatch() : Servlet("ServletDispatch"), m_default(new NotFoundServlet) {
+        }
+
+        void ServletDispatch::handle(const HttpRequest &request, HttpResponse &response) {
+            getMatched(request.getPath())->handle(request, response);
+        }
+
+        void ServletDispatch::addServlet(const std::string &path, Servlet::ptr servlet) {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_exact[path] = std::move(servlet);
+        }
+
+        void ServletDispatch::addServlet(const std::string &path, FunctionServlet::callback cb) {
+            addServlet(path, std::make_shared<FunctionServlet>(std::move(cb)));
+        }
+
+        void ServletDispatch::addPrefixServlet(const std::string &prefix, Servlet::ptr servlet) {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            auto it = std::find_if(m_prefix.begin(), m_prefix.end(),
+                                   [&prefix](const auto &item) { return item.first == prefix; });
+            if (it != m_prefix.end()) {
+                it->second = std::move(servlet);
+                return;
+            }
+            m_prefix.emplace_back(prefix, std::move(servlet));
+            std::stable_sort(m_prefix.begin(), m_prefix.end(), [](const auto &a, const auto &b) {
+                return a.first.size() > b.first.size();
+            });
+        }
+
+        void ServletDispatch::addPrefixServlet(const std::string &prefix, FunctionServlet::callback cb) {
+            addPrefixServlet(prefix, std::make_shared<FunctionServlet>(std::move(cb)));
+        }
+
+        void ServletDispatch::delServlet(const std::string &path) {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_exact.erase(path);
+        }
+
+        void ServletDispatch::delPrefixServlet(const std::string &prefix) {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_prefix.erase(std::remove_if(m_prefix.begin(), m_prefix.end(),
+                                          [&prefix](const auto &item) { return item.first == prefix; }),
+                           m_prefix.end());
+        }
+
+        Servlet::ptr ServletDispatch::getDefault() const {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            return m_default;
+        }
+
+        void ServletDispatch::setDefault(Servlet::ptr servlet) {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_default = std::move(servlet);
+        }
+
+        Servlet::ptr ServletDispatch::getMatched(std::string_view path) const {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            auto it = m_exact.find(path);
+            if (it != m_exact.end()) {
+                return it->second;
+            }
+            for (auto &item: m_prefix) {
+                if (path.substr(0, item.first.size()) == item.first) {
+                    return item.second;
+                }
+            }
+            return m_default;
+        }
+
+    }
+}
@@ -0,0 +1,118 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_SERVLET_H
+#define SYLAR_WEB_SERVER_SERVLET_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "http.h"
+
+namespace sylar {
+    namespace http {
+
+// 请求处理器
+        class Servlet {
+        public:
+            typedef std::shared_ptr<Servlet> ptr;
+
+            explicit Servlet(const std::string &name) : m_name(name) {}
+
+            virtual ~Servlet() {}
+
+            virtual void handle(const HttpRequest &request, HttpResponse &response) = 0;
+
+            const std::string &getName() const { return m_name; }
+
+        protected:
+            std::string m_name;
+        };
+
+        class FunctionServlet : public Servlet {
+        public:
+            typedef std::shared_ptr<FunctionServlet> ptr;
+            typedef std::function<void(const HttpRequest &request, HttpResponse &response)> callback;
+
+            explicit FunctionServlet(callback cb) : Servlet("FunctionServlet"), m_cb(std::move(cb)) {}
+
+            void handle(const HttpRequest &request, HttpResponse &response) override { m_cb(request, response); }
+
+        private:
+            callback m_cb;
+        };
+
+        class NotFoundServlet : public Servlet {
+        public:
+            NotFoundServlet() : Servlet("NotFoundServlet") {}
+
+            void handle(const HttpRequest &request, HttpResponse &response) override;
+        };
+
+// 静态文件, 把 prefix 之后的路径映射到 root 目录下; 响应体交给服务器用 sendfile 发送
+// 路径中含有 .. 时返回 403, 以 / 结尾时返回目录下的 index.html
+        class StaticFileServlet : public Servlet {
+        public:
+            StaticFileServlet(const std::string &prefix, const std::string &root);
+
+            void handle(const HttpRequest &request, HttpResponse &response) override;
+
+        private:
+            std::string m_prefix;
+            std::string m_root;
+        };
+
+// 按路径分派请求
+// 先查精确匹配, 再按最长前缀匹配, 都没有时交给默认处理器(404); 路由表可以在运行中修改
+        class ServletDispatch : public Servlet {
+        public:
+            typedef std::shared_ptr<ServletDispatch> ptr;
+
+            ServletDispatch();
+
+            void handle(const HttpRequest &request, HttpResponse &response) override;
+
+            void addServlet(const std::string &path, Servlet::ptr servlet);
+
+            void addServlet(const std::string &path, FunctionServlet::callback cb);
+
+            // 按字符串前缀匹配, 目录一般以 / 结尾, 例如 /static/
+            void addPrefixServlet(const std::string &prefix, Servlet::ptr servlet);
+
+            void addPrefixServlet(const std::string &prefix, FunctionServlet::callback cb);
+
+            void delServlet(const std::string &path);
+
+            void delPrefixServlet(const std::string &prefix);
+
+            Servlet::ptr getDefault() const;
+
+            void setDefault(Servlet::ptr servlet);
+
+            // 找不到时返回默认处理器
+            Servlet::ptr getMatched(std::string_view path) const;
+
+        private:
+            // 支持用 string_view 查找, 不构造临时 string
+            struct StringHash {
+                typedef void is_transparent;
+
+                size_t operator()(std::string_view str) const { return std::hash<std::string_view>()(str); }
+            };
+
+            mutable std::shared_mutex m_mutex;
+            std::unordered_map<std::string, Servlet::ptr, StringHash, std::equal_to<>> m_exact;
+            std::vector<std::pair<std::string, Servlet::ptr>> m_prefix;     //按前缀长度从长到短
+            Servlet::ptr m_default;
+        };
+
+    }
+}
+
+#endif //SYLAR_WEB_SERVER_SERVLET_H
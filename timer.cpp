@@ -0,0 +1,238 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#include "timer.h"
+#include "utils.h"
+
+namespace sylar {
+
+    Timer::Timer(Key, uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager)
+            : m_recurring(recurring), m_ms(ms), m_cb(std::move(cb)), m_manager(manager) {
+        m_expire = getElapseMs() + m_ms;
+    }
+
+    bool Timer::cancel() {
+        std::unique_lock<std::mutex> lock(m_manager->m_mutex);
+        if (!m_self) {
+            return false;
+        }
+        TimerManager::unlink(this);
+        m_manager->m_count--;
+        m_cb = nullptr;
+        // 最后一个引用可能就是 m_self, 在解锁之后才释放
+        ptr self = std::move(m_self);
+        lock.unlock();
+        return true;
+    }
+
+    bool Timer::refresh() {
+        return reset(m_ms, true);
+    }
+
+    bool Timer::reset(uint64_t ms, bool from_now) {
+        bool at_front;
+        {
+            std::lock_guard<std::mutex> lock(m_manager->m_mutex);
+            if (!m_self) {
+                return false;
+            }
+            uint64_t start = from_now ? getElapseMs() : m_expire - m_ms;
+            if (ms == m_ms && start + ms == m_expire) {
+                return true;
+            }
+            TimerManager::unlink(this);
+            m_ms = ms;
+            m_expire = start + ms;
+            at_front = m_manager->insert(this);
+        }
+        if (at_front) {
+            m_manager->onTimerInsertedAtFront();
+        }
+        return true;
+    }
+
+    TimerManager::TimerManager() : m_slots(kRootSize + (kLevels - 1) * kLevelSize) {
+        for (auto &head: m_slots) {
+            head.prev = head.next = &head;
+        }
+        m_current = getElapseMs();
+    }
+
+    TimerManager::~TimerManager() {
+        // 打断定时器的自引用
+        std::vector<Timer::ptr> timers;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &head: m_slots) {
+                while (head.next != &head) {
+                    auto *timer = static_cast<Timer *>(head.next);
+                    unlink(timer);
+                    timers.push_back(std::move(timer->m_self));
+                }
+            }
+            m_count = 0;
+        }
+    }
+
+    detail::TimerNode &TimerManager::slot(int level, size_t index) {
+        if (level == 0) {
+            return m_slots[index];
+        }
+        return m_slots[kRootSize + (level - 1) * kLevelSize + index];
+    }
+
+    void TimerManager::unlink(detail::TimerNode *node) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node->next = nullptr;
+    }
+
+    void TimerManager::link(Timer *timer) {
+        // 已经过期的定时器放在下一个要处理的槽位
+        uint64_t expire = timer->m_expire < m_current ? m_current : timer->m_expire;
+        uint64_t delta = expire - m_current;
+        detail::TimerNode *head;
+        if (delta < kRootSize) {
+            head = &slot(0, expire & (kRootSize - 1));
+        } else {
+            int level = 1;
+            while (level < kLevels - 1 && delta >= (1ull << (kRootBits + level * kLevelBits))) {
+                level++;
+            }
+            uint64_t max_delta = 1ull << (kRootBits + (kLevels - 1) * kLevelBits);
+            if (delta >= max_delta) {
+                // 超出时间轮范围, 先放在最远的位置, 下放时会重新计算
+                expire = m_current + max_delta - 1;
+            }
+            head = &slot(level, (expire >> (kRootBits + (level - 1) * kLevelBits)) & (kLevelSize - 1));
+        }
+        timer->prev = head->prev;
+        timer->next = head;
+        head->prev->next = timer;
+        head->prev = timer;
+    }
+
+    bool TimerManager::insert(Timer *timer) {
+        link(timer);
+        if (timer->m_expire < m_reported_deadline) {
+            m_reported_deadline = timer->m_expire;
+            return true;
+        }
+        return false;
+    }
+
+    void TimerManager::cascade(int level, size_t index) {
+        detail::TimerNode &head = slot(level, index);
+        detail::TimerNode *node = head.next;
+        head.prev = head.next = &head;
+        while (node != &head) {
+            detail::TimerNode *next = node->next;
+            link(static_cast<Timer *>(node));
+            node = next;
+        }
+    }
+
+    Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring) {
+        // 定时器随连接频繁创建销毁, 从线程本地内存池分配
+        auto timer = std::allocate_shared<Timer>(PoolAllocator<Timer>(), Timer::Key(), ms, std::move(cb), recurring,
+                                                 this);
+        bool at_front;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            timer->m_self = timer;
+            m_count++;
+            at_front = insert(timer.get());
+        }
+        if (at_front) {
+            onTimerInsertedAtFront();
+        }
+        return timer;
+    }
+
+    Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> cond,
+                                               bool recurring) {
+        return addTimer(ms, [cb = std::move(cb), cond = std::move(cond)]() {
+            if (cond.lock()) {
+                cb();
+            }
+        }, recurring);
+    }
+
+    uint64_t TimerManager::getNextTimeout() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_count == 0) {
+            m_reported_deadline = UINT64_MAX;
+            return UINT64_MAX;
+        }
+        uint64_t now = getElapseMs();
+        // 第 0 层中最近的非空槽位; 跨过 256 的边界之前需要先下放高层槽位
+        uint64_t deadline = (m_current + kRootSize - 1) & ~(uint64_t) (kRootSize - 1);
+        for (uint64_t t = m_current; t < deadline; t++) {
+            detail::TimerNode &head = slot(0, t & (kRootSize - 1));
+            if (head.next != &head) {
+                deadline = t;
+                break;
+            }
+        }
+        m_reported_deadline = deadline;
+        return deadline > now ? deadline - now : 0;
+    }
+
+    void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs) {
+        std::vector<Timer::ptr> finished;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t now = getElapseMs();
+        detail::TimerNode expired;
+        expired.prev = expired.next = &expired;
+        while (m_current <= now && m_count > 0) {
+            size_t index = m_current & (kRootSize - 1);
+            if (index == 0) {
+                for (int level = 1; level < kLevels; level++) {
+                    size_t i = (m_current >> (kRootBits + (level - 1) * kLevelBits)) & (kLevelSize - 1);
+                    cascade(level, i);
+                    if (i != 0) {
+                        break;
+                    }
+                }
+            }
+            detail::TimerNode &head = slot(0, index);
+            if (head.next != &head) {
+                // 整个槽位接到 expired 后面
+                head.next->prev = expired.prev;
+                expired.prev->next = head.next;
+                head.prev->next = &expired;
+                expired.prev = head.prev;
+                head.prev = head.next = &head;
+            }
+            m_current++;
+        }
+        if (m_count == 0 && m_current <= now) {
+            // 没有定时器时直接跳到当前时刻
+            m_current = now + 1;
+        }
+
+        while (expired.next != &expired) {
+            auto *timer = static_cast<Timer *>(expired.next);
+            unlink(timer);
+            if (timer->m_recurring) {
+                cbs.push_back(timer->m_cb);
+                timer->m_expire = now + timer->m_ms;
+                link(timer);
+            } else {
+                cbs.push_back(std::move(timer->m_cb));
+                timer->m_cb = nullptr;
+                m_count--;
+                finished.push_back(std::move(timer->m_self));
+            }
+        }
+        m_reported_deadline = UINT64_MAX;
+        // finished 在 lock 之后析构, 定时器对象在锁外释放
+    }
+
+    bool TimerManager::hasTimer() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_count > 0;
+    }
+
+}
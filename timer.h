@@ -0,0 +1,122 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_TIMER_H
+#define SYLAR_WEB_SERVER_TIMER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "pool_allocator.h"
+
+namespace sylar {
+
+    class TimerManager;
+
+    namespace detail {
+        // 时间轮槽位中的双向循环链表节点
+        struct TimerNode {
+            TimerNode *prev = nullptr;
+            TimerNode *next = nullptr;
+        };
+    }
+
+// 定时器, 由 TimerManager::addTimer 创建
+// 在时间轮中时持有自己的引用, 使用者丢掉 Timer::ptr 不会取消定时器
+    class Timer : public std::enable_shared_from_this<Timer>, private detail::TimerNode {
+        friend class TimerManager;
+
+        // 只有 TimerManager 能构造, 用于配合 std::allocate_shared
+        class Key {
+            friend class TimerManager;
+
+            explicit Key() = default;
+        };
+
+    public:
+        typedef std::shared_ptr<Timer> ptr;
+
+        Timer(Key, uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager);
+
+        // 已经触发(非循环定时器)或者已经取消时返回 false
+        bool cancel();
+
+        // 从现在开始重新计时, 用于连接的读超时这类频繁续期的场景
+        bool refresh();
+
+        // 修改超时时间, from_now 为 false 时从原来的起始时间开始算
+        bool reset(uint64_t ms, bool from_now);
+
+    private:
+        bool m_recurring = false;
+        uint64_t m_ms = 0;              //超时时长
+        uint64_t m_expire = 0;          //到期时间, getElapseMs() 时间基准
+        std::function<void()> m_cb;
+        TimerManager *m_manager = nullptr;
+        ptr m_self;                     //在时间轮中时不为空
+    };
+
+// 分层时间轮定时器管理
+// 精度 1ms, 第 0 层 256 个槽, 之后 4 层各 64 个槽, 覆盖约 49 天, 更远的定时器放在最高层并在到期前重新分配.
+// 添加, 取消, 续期都是 O(1) 的链表操作; 时间推进时高层槽位中的定时器按需下放(cascade).
+// 时间基准为 getElapseMs(), 与日志事件的 m_elapse 一致.
+    class TimerManager {
+        friend class Timer;
+
+    public:
+        TimerManager();
+
+        virtual ~TimerManager();
+
+        Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
+
+        // cond 失效后定时器到期时不执行回调
+        Timer::ptr addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> cond,
+                                     bool recurring = false);
+
+        // 距离下一次需要处理定时器的毫秒数, 没有定时器时返回 UINT64_MAX
+        // 结果可能早于最近的定时器(需要把高层槽位下放时), 但不会晚于它
+        uint64_t getNextTimeout();
+
+        // 推进时间轮, 取出所有到期定时器的回调; 循环定时器重新计时
+        void listExpiredCb(std::vector<std::function<void()>> &cbs);
+
+        bool hasTimer();
+
+    protected:
+        // 新定时器比上次 getNextTimeout() 给出的时刻更早到期, 等待中的线程需要提前醒来
+        virtual void onTimerInsertedAtFront() {}
+
+    private:
+        static constexpr int kLevels = 5;
+        static constexpr int kRootBits = 8;
+        static constexpr int kLevelBits = 6;
+        static constexpr size_t kRootSize = 1 << kRootBits;
+        static constexpr size_t kLevelSize = 1 << kLevelBits;
+
+        // 以下函数都需要持有 m_mutex
+        void link(Timer *timer);
+
+        static void unlink(detail::TimerNode *node);
+
+        // 返回 true 表示需要调用 onTimerInsertedAtFront
+        bool insert(Timer *timer);
+
+        void cascade(int level, size_t index);
+
+        detail::TimerNode &slot(int level, size_t index);
+
+    private:
+        std::mutex m_mutex;
+        std::vector<detail::TimerNode> m_slots;     //kRootSize + (kLevels - 1) * kLevelSize 个链表头
+        uint64_t m_current = 0;                     //下一个要处理的时刻, 早于它的定时器都已经触发
+        size_t m_count = 0;
+        uint64_t m_reported_deadline = UINT64_MAX;  //上次 getNextTimeout 告诉调用者的唤醒时刻
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_TIMER_H
@@ -2,11 +2,186 @@
 // Created by xiaomaotou31 on 2022/2/10.
 //
 #include "utils.h"
-size_t getThreadId()
+#include "fiber.h"
+#include "coroutine.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <pthread.h>
+#include <queue>
+#include <unistd.h>
+
+static const auto s_start_time = std::chrono::steady_clock::now();
+
+namespace {
+    // ThreadInfo 加上引用计数, 回收后挂在空闲链表上复用, 不还给堆
+    struct ThreadBlock : ThreadInfo {
+        mutable std::atomic<uint32_t> refs{1};
+        ThreadBlock *next = nullptr;
+    };
+
+    // 线程登记表, 下标为线程序号; 同时管理空闲的序号和 ThreadInfo
+    struct ThreadRegistry {
+        std::mutex mutex;
+        std::vector<const ThreadInfo *> threads;
+        std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> free_indices;
+        uint32_t next_index = 1;
+        ThreadBlock *free_blocks = nullptr;
+
+        static ThreadRegistry &getInstance() {
+            // 不析构, 线程退出可能晚于静态对象析构
+            static ThreadRegistry *instance = new ThreadRegistry;
+            return *instance;
+        }
+
+        ThreadBlock *allocBlock() {
+            std::lock_guard<std::mutex> lock(mutex);
+            ThreadBlock *block = free_blocks;
+            if (!block) {
+                return new ThreadBlock;
+            }
+            free_blocks = block->next;
+            block->next = nullptr;
+            block->refs.store(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        void freeBlock(ThreadBlock *block) {
+            std::lock_guard<std::mutex> lock(mutex);
+            block->next = free_blocks;
+            free_blocks = block;
+        }
+
+        uint32_t allocIndex(const ThreadInfo *info) {
+            std::lock_guard<std::mutex> lock(mutex);
+            uint32_t index;
+            if (!free_indices.empty()) {
+                index = free_indices.top();
+                free_indices.pop();
+            } else {
+                index = next_index++;
+            }
+            if (threads.size() <= index) {
+                threads.resize(index + 1);
+            }
+            threads[index] = info;
+            return index;
+        }
+
+        void freeIndex(uint32_t index) {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads[index] = nullptr;
+            free_indices.push(index);
+        }
+
+        void set(uint32_t index, const ThreadInfo *info) {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads[index] = info;
+        }
+    };
+
+    thread_local const ThreadInfo *t_thread_info = nullptr;
+    thread_local bool t_thread_exited = false;
+
+    // 线程退出时交还序号和本线程持有的引用; 队列中的日志事件各自持有引用, 用完后才回收
+    struct ThreadInfoHolder {
+        ~ThreadInfoHolder() {
+            if (const ThreadInfo *info = t_thread_info) {
+                ThreadRegistry::getInstance().freeIndex(info->index);
+                t_thread_info = nullptr;
+                t_thread_exited = true;
+                releaseThreadInfo(info);
+            }
+        }
+    };
+
+    const ThreadInfo *initThreadInfo() {
+        auto &registry = ThreadRegistry::getInstance();
+        ThreadBlock *info = registry.allocBlock();
+        info->tid = (uint32_t) ::gettid();
+        char name[16] = {0};
+        info->name = pthread_getname_np(pthread_self(), name, sizeof(name)) == 0 ? name : "";
+        if (t_thread_exited) {
+            // 线程退出过程中(其他 thread_local 析构时)又打日志: 不登记, 序号为 0, 本线程的引用不再释放
+            info->index = 0;
+        } else {
+            static thread_local ThreadInfoHolder holder;
+            info->index = registry.allocIndex(info);
+        }
+        t_thread_info = info;
+        return info;
+    }
+}
+
+const ThreadInfo &getThreadInfo()
+{
+    const ThreadInfo *info = t_thread_info;
+    if (!info) {
+        info = initThreadInfo();
+    }
+    return *info;
+}
+
+void retainThreadInfo(const ThreadInfo *info)
+{
+    static_cast<const ThreadBlock *>(info)->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void releaseThreadInfo(const ThreadInfo *info)
+{
+    auto *block = const_cast<ThreadBlock *>(static_cast<const ThreadBlock *>(info));
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ThreadRegistry::getInstance().freeBlock(block);
+    }
+}
+
+void setThreadName(const std::string &name)
+{
+    const ThreadInfo &old = getThreadInfo();
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    auto &registry = ThreadRegistry::getInstance();
+    ThreadBlock *info = registry.allocBlock();
+    info->tid = old.tid;
+    info->index = old.index;
+    info->name = name;
+    if (info->index) {
+        registry.set(info->index, info);
+    }
+    // 旧对象可能仍被日志事件引用, 由最后一个引用回收
+    t_thread_info = info;
+    releaseThreadInfo(&old);
+}
+
+const std::string &getThreadName()
+{
+    return getThreadInfo().name;
+}
+
+std::vector<ThreadInfo> getThreadInfos()
+{
+    auto &registry = ThreadRegistry::getInstance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<ThreadInfo> infos;
+    for (auto info: registry.threads) {
+        if (info) {
+            infos.push_back(*info);
+        }
+    }
+    return infos;
+}
+
+uint32_t getThreadId()
 {
-    return std::hash<std::thread::id>{}(std::this_thread::get_id());
+    return getThreadInfo().tid;
 }
 size_t getFiberId()
 {
-    return 0; // TODO:get coroutine id
-}
\ No newline at end of file
+    // 在无栈协程 Task 中时返回 Task 的协程号, 它与有栈协程共用一个序列
+    uint64_t id = sylar::detail::getCurrentTaskId();
+    return id ? id : sylar::Fiber::getCurrentId();
+}
+
+uint64_t getElapseMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - s_start_time).count();
+}
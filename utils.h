@@ -10,9 +10,34 @@
 #include <coroutine>
 #include <iostream>
 #include <thread>
+#include <cstdint>
+#include <string>
+#include <vector>
 
-size_t getThreadId();
+// 线程身份, 每个线程第一次使用时填充一次
+// 对象发布后不再修改(改名时换成新对象), 日志事件持有引用即可直接使用, 不必拷贝线程名
+struct ThreadInfo {
+    uint32_t tid = 0;       //内核线程号(gettid), 与 top -H, perf 中看到的一致
+    uint32_t index = 0;     //进程内线程序号, 从 1 开始; 线程退出后回收给新线程, 优先复用小的序号
+    std::string name;       //线程名
+};
+
+// 当前线程的身份, 线程自己持有一个引用, 线程退出或改名时释放
+const ThreadInfo &getThreadInfo();
+// 引用计数, 只对 getThreadInfo() 返回的对象有效; 最后一个引用释放后对象回收给新线程
+void retainThreadInfo(const ThreadInfo *info);
+void releaseThreadInfo(const ThreadInfo *info);
+// 修改当前线程名, 同时调用 pthread_setname_np(内核只保留前 15 个字节)
+void setThreadName(const std::string &name);
+const std::string &getThreadName();
+// 还在运行的已登记线程, 返回拷贝
+std::vector<ThreadInfo> getThreadInfos();
+
+// 内核线程号
+uint32_t getThreadId();
 size_t getFiberId();
+// 程序启动以来的毫秒数, 单调时钟; 日志事件的 m_elapse 和定时器时间轮都以它为准
+uint64_t getElapseMs();
 
 
 #endif //SYLAR_WEB_SERVER_UTILS_H
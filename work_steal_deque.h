@@ -0,0 +1,127 @@
+//
+// Created by xiaomaotou31 on 2026/10/17.
+//
+
+#ifndef SYLAR_WEB_SERVER_WORK_STEAL_DEQUE_H
+#define SYLAR_WEB_SERVER_WORK_STEAL_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sylar {
+
+// 工作窃取双端队列(Chase-Lev 算法, 按 Lê 等人的 C11 内存模型版本实现)
+// 只有所属线程可以 push/pop 底部, 其他线程从顶部 steal; 只有底部只剩一个元素时所属线程才需要和窃取者 CAS 竞争.
+// 容量不够时翻倍, 旧数组可能仍被窃取者读取, 保留到队列析构时才释放.
+// T 必须是可以放进 std::atomic 的平凡类型, 一般是指针
+    template<class T>
+    class WorkStealDeque {
+    public:
+        explicit WorkStealDeque(size_t capacity = 256) {
+            size_t cap = 2;
+            while (cap < capacity) {
+                cap <<= 1;
+            }
+            m_arrays.emplace_back(new Array(cap));
+            m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+        }
+
+        WorkStealDeque(const WorkStealDeque &) = delete;
+
+        WorkStealDeque &operator=(const WorkStealDeque &) = delete;
+
+        // 只能由所属线程调用
+        void push(T value) {
+            int64_t b = m_bottom.load(std::memory_order_relaxed);
+            int64_t t = m_top.load(std::memory_order_acquire);
+            Array *a = m_array.load(std::memory_order_relaxed);
+            if (b - t > (int64_t) a->mask) {
+                a = grow(a, t, b);
+            }
+            a->put(b, value);
+            // seq_cst 而不是 release: 睡眠中的线程先标记自己再检查队列, 生产者先入队再检查睡眠标记, 两边都需要全序
+            m_bottom.store(b + 1, std::memory_order_seq_cst);
+        }
+
+        // 只能由所属线程调用, 后进先出; 队列为空时返回 false
+        bool pop(T &value) {
+            int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+            Array *a = m_array.load(std::memory_order_relaxed);
+            m_bottom.store(b, std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_seq_cst);
+            if (t > b) {
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+            value = a->get(b);
+            if (t == b) {
+                // 最后一个元素, 和窃取者竞争
+                bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                         std::memory_order_relaxed);
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        // 任意线程调用, 先进先出; 队列为空或者竞争失败时返回 false
+        bool steal(T &value) {
+            int64_t t = m_top.load(std::memory_order_seq_cst);
+            int64_t b = m_bottom.load(std::memory_order_seq_cst);
+            if (t >= b) {
+                return false;
+            }
+            Array *a = m_array.load(std::memory_order_acquire);
+            T v = a->get(t);
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return false;
+            }
+            value = v;
+            return true;
+        }
+
+        // 近似值, 只用于判断是否值得窃取或睡眠
+        bool empty() const {
+            return m_bottom.load(std::memory_order_seq_cst) <= m_top.load(std::memory_order_seq_cst);
+        }
+
+        size_t size() const {
+            int64_t n = m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+            return n > 0 ? (size_t) n : 0;
+        }
+
+    private:
+        struct Array {
+            explicit Array(size_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+            T get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+
+            void put(int64_t i, T v) { slots[i & mask].store(v, std::memory_order_relaxed); }
+
+            size_t mask;
+            std::unique_ptr<std::atomic<T>[]> slots;
+        };
+
+        Array *grow(Array *old, int64_t t, int64_t b) {
+            auto *a = new Array((old->mask + 1) * 2);
+            for (int64_t i = t; i < b; i++) {
+                a->put(i, old->get(i));
+            }
+            m_arrays.emplace_back(a);
+            m_array.store(a, std::memory_order_release);
+            return a;
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::atomic<Array *> m_array{nullptr};
+        std::vector<std::unique_ptr<Array>> m_arrays;    //包括已经替换掉的旧数组, 只有所属线程修改
+    };
+
+}
+
+#endif //SYLAR_WEB_SERVER_WORK_STEAL_DEQUE_H